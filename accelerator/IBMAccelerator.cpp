@@ -32,10 +32,158 @@
 
 #include "XACC.hpp"
 #include "IBMAcceleratorBuffer.hpp"
+#include <functional>
 
 namespace xacc {
 namespace quantum {
 
+namespace {
+
+/**
+ * Give a variable a new value for the rest of the enclosing
+ * scope, restoring its old value when the scope is left,
+ * also when an error is thrown.
+ */
+template<typename T>
+class ScopedValue {
+	T& variable;
+	T saved;
+public:
+	ScopedValue(T& var, const T& value) :
+			variable(var), saved(var) {
+		variable = value;
+	}
+	ScopedValue(const ScopedValue&) = delete;
+	ScopedValue& operator=(const ScopedValue&) = delete;
+	~ScopedValue() {
+		variable = saved;
+	}
+};
+
+IBMCircuit singleKernelCircuit(std::shared_ptr<Function> kernel, const int k,
+		const int nMeasures) {
+	IBMCircuit circuit;
+	circuit.function = kernel;
+	circuit.kernels.push_back(k);
+	for (int m = 0; m < nMeasures; m++) {
+		circuit.measureOwners.push_back(
+				std::vector<std::pair<int, int>> { std::make_pair(k, m) });
+	}
+	return circuit;
+}
+
+/**
+ * A kernel split into its state preparation prefix and, per
+ * measured qubit, the single qubit gates that rotate it into
+ * its measurement basis and the measurement itself.
+ */
+struct MeasurementSuffix {
+	std::vector<std::shared_ptr<Instruction>> prefix;
+	std::map<int, std::vector<std::shared_ptr<Instruction>>> basisGates;
+	std::map<int, std::shared_ptr<Instruction>> measures;
+
+	/**
+	 * The qubit read by each measurement, in program order
+	 */
+	std::vector<int> measureOrder;
+};
+
+/**
+ * Split the given kernel at the trailing run of its top level single
+ * qubit gates and measurements. Returns false if the kernel has no
+ * prefix, a qubit measured twice or rotated without being measured.
+ */
+bool splitMeasurementSuffix(std::shared_ptr<Function> kernel,
+		MeasurementSuffix& split) {
+	if (!isFlattenable(kernel)) {
+		return false;
+	}
+
+	std::vector<std::shared_ptr<Instruction>> instructions;
+	for (auto inst : kernel->getInstructions()) {
+		if (inst->isEnabled()) {
+			instructions.push_back(inst);
+		}
+	}
+
+	int start = instructions.size();
+	while (start > 0 && !instructions[start - 1]->isComposite()
+			&& instructions[start - 1]->bits().size() == 1) {
+		start--;
+	}
+	if (start == 0) {
+		return false;
+	}
+	split.prefix.assign(instructions.begin(), instructions.begin() + start);
+
+	for (int i = start; i < instructions.size(); i++) {
+		auto q = instructions[i]->bits()[0];
+		if (split.measures.count(q)) {
+			return false;
+		}
+		if (instructions[i]->name() == "Measure") {
+			split.measures[q] = instructions[i];
+			split.measureOrder.push_back(q);
+		} else {
+			split.basisGates[q].push_back(instructions[i]);
+		}
+	}
+
+	for (auto& kv : split.basisGates) {
+		if (!split.measures.count(kv.first)) {
+			return false;
+		}
+	}
+	return !split.measures.empty();
+}
+
+/**
+ * Return true if the given gates have the same
+ * names, qubits and parameters, in order.
+ */
+bool sameGates(const std::vector<std::shared_ptr<Instruction>>& a,
+		const std::vector<std::shared_ptr<Instruction>>& b) {
+	if (a.size() != b.size()) {
+		return false;
+	}
+	for (int i = 0; i < a.size(); i++) {
+		if (a[i] != b[i]
+				&& (a[i]->name() != b[i]->name() || a[i]->bits() != b[i]->bits()
+						|| a[i]->getParameters() != b[i]->getParameters())) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Return true if the given state preparations are the
+ * same instructions, or flatten to the same gates.
+ */
+bool samePrefix(const std::vector<std::shared_ptr<Instruction>>& a,
+		const std::vector<std::shared_ptr<Instruction>>& b) {
+	if (a == b) {
+		return true;
+	}
+
+	auto flatten = [](const std::vector<std::shared_ptr<Instruction>>& prefix) {
+		std::vector<std::shared_ptr<Instruction>> flat;
+		for (auto inst : prefix) {
+			InstructionIterator it(inst);
+			while (it.hasNext()) {
+				auto nextInst = it.next();
+				if (!nextInst->isComposite() && nextInst->isEnabled()) {
+					flat.push_back(nextInst);
+				}
+			}
+		}
+		return flat;
+	};
+	return sameGates(flatten(a), flatten(b));
+}
+
+}
+
 std::shared_ptr<AcceleratorBuffer> IBMAccelerator::createBuffer(
 			const std::string& varId) {
 	if (!isValidBufferSize(30)) {
@@ -82,27 +230,64 @@ std::vector<std::shared_ptr<IRTransformation>> IBMAccelerator::getIRTransformati
 
 	auto backend = availableBackends[backendName];
 
-	std::vector<std::pair<int,int>> testCouplers;
-	for (auto b : availableBackends) {
-		if (b.first == "ibmqx5") {
-			testCouplers = b.second.couplers;
-			break;
+	if (!backend.topology->isComplete()) {
+		if (!xacc::optionExists("ibm-no-qubit-placement")) {
+			transformations.push_back(
+					std::make_shared<IBMQubitPlacement>(backend.topology,
+							compilationContext));
+		}
+
+		if (!xacc::optionExists("ibm-no-qubit-routing")) {
+			transformations.push_back(
+					std::make_shared<IBMQubitRouter>(backend.topology,
+							compilationContext));
 		}
-	}
 
-	if (!backend.couplers.empty()) {
 		auto transform = std::make_shared<IBMIRTransformation>(
-				testCouplers);
+				backend.topology);
 		transformations.push_back(transform);
+
+		// Clean up the Hadamards and SWAPs left by the mapping,
+		// simulators run the kernels as written
+		if (!xacc::optionExists("ibm-no-gate-cancellation")) {
+			transformations.push_back(std::make_shared<IBMGateCancellation>());
+		}
+	}
+
+	auto policy = xacc::optionExists("ibm-schedule") ?
+			xacc::getOption("ibm-schedule") : "none";
+	if (policy == "asap" || policy == "alap") {
+		transformations.push_back(
+				std::make_shared<IBMInstructionScheduler>(
+						policy == "asap" ?
+								IBMInstructionScheduler::Policy::ASAP :
+								IBMInstructionScheduler::Policy::ALAP));
+	} else if (policy != "none") {
+		xacc::error("Invalid --ibm-schedule " + policy
+				+ ", use asap, alap or none.");
+	}
+
+	// Record the statistics of every kernel before and after each pass
+	for (auto& t : transformations) {
+		t = std::make_shared<IBMPassInstrumentation>(t, compilationContext);
 	}
 
-        transformations.clear();
 	return transformations;
 }
 
 void IBMAccelerator::initialize() {
 	std::string jsonStr = "", apiKey = "";
 	auto options = RuntimeOptions::instance();
+
+	if (xacc::optionExists("ibm-compress-payloads")
+			&& !std::dynamic_pointer_cast<IBMCompressedClient>(restClient)) {
+		std::size_t threshold = 1024;
+		if (xacc::optionExists("ibm-compression-threshold")) {
+			threshold = std::stoul(xacc::getOption("ibm-compression-threshold"));
+		}
+		restClient = std::make_shared<IBMCompressedClient>(restClient, threshold);
+	}
+
 	searchAPIKey(apiKey, url);
 	std::string tokenParam = "apiToken=" + apiKey;
 
@@ -145,6 +330,11 @@ void IBMAccelerator::initialize() {
 			}
 		}
 
+		// Built once here and shared by every
+		// transformation and connectivity query
+		backend.topology = std::make_shared<IBMBackendTopology>(
+				backend.couplers, backend.nQubits);
+
 		availableBackends.insert(std::make_pair(backend.name, backend));
 	}
 
@@ -199,31 +389,234 @@ const std::string IBMAccelerator::processInput(
 	if (xacc::optionExists("ibm-shots")) {
 		shots = xacc::getOption("ibm-shots");
 	}
+	if (allocatedShots > 0) {
+		shots = std::to_string(allocatedShots);
+	}
+	jobShots = std::stoi(shots);
 
-	int kernelCounter = 0;
+	jobDurations = IBMGateDurations::forBackend(backendName);
+	if (xacc::optionExists("ibm-gate-durations")) {
+		jobDurations.parse(xacc::getOption("ibm-gate-durations"));
+	}
+
+	// Find the GateFunctions (e.g. a common state preparation
+	// routine) that are called by more than one kernel in this
+	// batch. These are lowered to OpenQasm once and reused.
+	std::map<std::shared_ptr<Instruction>, int> compositeCounts;
 	for (auto kernel : functions) {
-		// Create the Instruction Visitor that is going
-		// to map our IR to Quil.
-		auto visitor = std::make_shared<OpenQasmVisitor>(buffer->size());
+		for (auto inst : kernel->getInstructions()) {
+			if (isSharablePrefix(inst)) {
+				compositeCounts[inst]++;
+			}
+		}
+	}
+
+	std::map<std::pair<std::shared_ptr<Instruction>, std::vector<int>>,
+			std::string> prefixQasm;
+	nReusedPrefixes = 0;
+
+	bool fuseGates = !xacc::optionExists("ibm-no-gate-fusion");
+	double fusionTolerance = 1e-10;
+	if (xacc::optionExists("ibm-fusion-tolerance")) {
+		fusionTolerance = std::stod(xacc::getOption("ibm-fusion-tolerance"));
+	}
+
+	bool pruneLightCones = !xacc::optionExists("ibm-no-light-cone-pruning");
+	int nPruned = 0;
+
+	std::vector<std::shared_ptr<Function>> kernels;
+	for (int k = 0; k < functions.size(); k++) {
+		auto kernel = functions[k];
 
-		// Our QIR is really a tree structure
-		// so create a pre-order tree traversal
-		// InstructionIterator to walk it
+		// Drop the gates that cannot affect any measured qubit,
+		// qubits that become idle are then compacted away below
+		if (pruneLightCones) {
+			kernel = lightConeKernel(kernel, nPruned);
+		}
+
+		// Measurements of routed kernels read physical qubits,
+		// record the logical qubits of the buffer they stand for.
+		auto& measured = measurementSupports[k];
 		InstructionIterator it(kernel);
-		measurementSupports.insert(std::make_pair(kernelCounter, std::vector<int>{}));
 		while (it.hasNext()) {
-			// Get the next node in the tree
 			auto nextInst = it.next();
-			if (nextInst->isEnabled()) {
-				nextInst->accept(visitor);
-				if (nextInst->name() == "Measure") {
-					auto qbitIdx = nextInst->bits()[0];
-					measurementSupports[kernelCounter].push_back(qbitIdx);
+			if (nextInst->isEnabled() && nextInst->name() == "Measure") {
+				measured.push_back(nextInst->bits()[0]);
+			}
+		}
+		physicalSupports[k] = measured;
+		auto logical = compilationContext->getMeasuredQubits(functions[k]);
+		if (!logical.empty()) {
+			if (logical.size() != measured.size()) {
+				xacc::error(kernel->name() + " measures "
+						+ std::to_string(measured.size())
+						+ " qubits, but its recorded layout has "
+						+ std::to_string(logical.size()) + " measurements.");
+			}
+			measured = logical;
+		}
+
+		kernelNames[k] = kernel->name();
+		kernelStatistics[k] = computeStatistics(kernel);
+		kernelPassStatistics[k] = compilationContext->getPassStatistics(
+				functions[k]);
+		kernels.push_back(kernel);
+	}
+
+	std::vector<IBMCircuit> circuits;
+	if (!groupMeasurements || xacc::optionExists("ibm-no-measurement-grouping")) {
+		for (int k = 0; k < kernels.size(); k++) {
+			circuits.push_back(singleKernelCircuit(kernels[k], k,
+					measurementSupports[k].size()));
+		}
+	} else {
+		circuits = groupCommutingKernels(functions, kernels);
+		if (pruneLightCones) {
+			int nMergedPruned = 0;
+			for (auto& circuit : circuits) {
+				if (circuit.kernels.size() > 1) {
+					circuit.function = lightConeKernel(circuit.function,
+							nMergedPruned);
+				}
+			}
+		}
+	}
+	auto nGroupedCircuits = circuits.size();
+
+	circuits = packKernels(circuits);
+
+	bool deduplicate = groupMeasurements
+			&& !xacc::optionExists("ibm-no-circuit-deduplication");
+	std::map<std::string, int> submittedCircuits;
+
+	for (int circuitIdx = 0; circuitIdx < circuits.size(); circuitIdx++) {
+		auto kernel = circuits[circuitIdx].function;
+		auto& measureOwners = circuits[circuitIdx].measureOwners;
+
+		// On simulators only declare the qubits this kernel
+		// touches, renumbered densely, so that the remote simulator
+		// does not allocate a statevector for the whole buffer.
+		// Physical backends need every physical qubit in use.
+		std::vector<int> qubitMap;
+		int nQubits = buffer->size();
+		auto active = getActiveQubits(kernel);
+		if (chosenBackend.isSimulator
+				&& !xacc::optionExists("ibm-no-qubit-compaction")) {
+			if (!active.empty()) {
+				qubitMap.assign(*active.rbegin() + 1, -1);
+				int denseIdx = 0;
+				for (auto q : active) {
+					qubitMap[q] = denseIdx++;
+				}
+				nQubits = active.size();
+			}
+		} else if (!active.empty()) {
+			nQubits = std::max(nQubits, *active.rbegin() + 1);
+		}
+
+		// Create the Instruction Visitor that is going
+		// to map our IR to Quil.
+		auto visitor = std::make_shared<OpenQasmVisitor>(nQubits, false, qubitMap);
+		if (fuseGates) {
+			visitor->enableGateFusion(fusionTolerance);
+		}
+
+		std::vector<int> measured;
+		for (auto inst : kernel->getInstructions()) {
+
+			auto count = compositeCounts.find(inst);
+			if (count != compositeCounts.end() && count->second > 1) {
+				auto key = std::make_pair(inst, qubitMap);
+				auto cached = prefixQasm.find(key);
+				if (cached == prefixQasm.end()) {
+					auto prefixVisitor = std::make_shared<OpenQasmVisitor>(
+							nQubits, true, qubitMap);
+					if (fuseGates) {
+						prefixVisitor->enableGateFusion(fusionTolerance);
+					}
+					InstructionIterator it(inst);
+					while (it.hasNext()) {
+						auto nextInst = it.next();
+						if (nextInst->isEnabled()) {
+							nextInst->accept(prefixVisitor);
+						}
+					}
+					cached = prefixQasm.insert(
+							std::make_pair(key,
+									prefixVisitor->getOpenQasmString())).first;
+				} else {
+					nReusedPrefixes++;
+				}
+				visitor->appendOpenQasm(cached->second);
+				continue;
+			}
+
+			// Our QIR is really a tree structure
+			// so create a pre-order tree traversal
+			// InstructionIterator to walk it
+			InstructionIterator it(inst);
+			while (it.hasNext()) {
+				// Get the next node in the tree
+				auto nextInst = it.next();
+				if (nextInst->isEnabled()) {
+					nextInst->accept(visitor);
+					if (nextInst->name() == "Measure") {
+						measured.push_back(nextInst->bits()[0]);
+					}
 				}
 			}
 		}
 
 		auto qasmStr = visitor->getOpenQasmString();
+		auto circuitTime = jobDurations.circuitTime(qasmStr);
+		if (xacc::optionExists("ibm-compact-openqasm")) {
+			OpenQasmCompactor compactor(nQubits);
+			qasmStr = compactor.compact(qasmStr);
+		}
+
+		// Record which classical bit of the result bit strings
+		// holds each measured qubit of each kernel. Physical backends
+		// and merged cregs index results by qubit, otherwise the
+		// simulator reports one creg per measurement, in measurement order.
+		bool resultsByQubit = !chosenBackend.isSimulator
+				|| boost::contains(qasmStr, "creg c[");
+		for (int m = 0; m < measured.size() && m < measureOwners.size(); m++) {
+			auto emitted = qubitMap.empty() ? measured[m] : qubitMap[measured[m]];
+			for (auto owner : measureOwners[m]) {
+				kernelReadouts[owner.first].push_back(
+						std::make_pair(resultsByQubit ? emitted : m,
+								measurementSupports[owner.first][owner.second]));
+				physicalSupports[owner.first][owner.second] = measured[m];
+			}
+		}
+
+		// Identical circuits, eg the same kernel requested twice, are
+		// submitted once and their histogram is read by every kernel
+		std::stringstream key;
+		key << qasmStr;
+		for (auto q : measured) {
+			key << " " << (qubitMap.empty() ? q : qubitMap[q]);
+		}
+		int submittedIdx = circuitQasmBytes.size();
+		if (deduplicate) {
+			auto existing = submittedCircuits.find(key.str());
+			if (existing != submittedCircuits.end()) {
+				submittedIdx = existing->second;
+				nDuplicateCircuits++;
+			} else {
+				submittedCircuits.insert(std::make_pair(key.str(), submittedIdx));
+			}
+		}
+		for (auto k : circuits[circuitIdx].kernels) {
+			kernelCircuits[k] = submittedIdx;
+		}
+		if (submittedIdx < circuitQasmBytes.size()) {
+			continue;
+		}
+
+		circuitQasmBytes[submittedIdx] = qasmStr.size();
+		circuitTimes[submittedIdx] = circuitTime;
+
 		boost::replace_all(qasmStr, "\n", "\\n");
 
 		jsonStr += "{\"qasm\": \"" + qasmStr + "\"},";
@@ -236,8 +629,66 @@ const std::string IBMAccelerator::processInput(
 			out << qasmStr;
 			out.close();
 		}
+	}
+
+	if (nGroupedCircuits < kernels.size()) {
+		xacc::info("Grouped " + std::to_string(kernels.size())
+				+ " kernels into " + std::to_string(nGroupedCircuits)
+				+ " circuits with qubit-wise commuting measurements.");
+	}
+
+	if (circuits.size() < nGroupedCircuits) {
+		xacc::info("Packed " + std::to_string(nGroupedCircuits)
+				+ " circuits into " + std::to_string(circuits.size())
+				+ " circuits.");
+	}
+
+	if (nDuplicateCircuits > 0) {
+		xacc::info("Submitted " + std::to_string(circuitQasmBytes.size())
+				+ " circuits, suppressed " + std::to_string(nDuplicateCircuits)
+				+ " duplicates.");
+	}
+
+	// One report per batch, the effect of each pass is summed
+	// over the kernels it ran on, depths are the deepest kernel's
+	std::vector<IBMPassStatistics> passTotals;
+	for (auto& kv : kernelPassStatistics) {
+		for (auto& p : kv.second) {
+			auto total = std::find_if(passTotals.begin(), passTotals.end(),
+					[&](const IBMPassStatistics& t) {return t.pass == p.pass;});
+			if (total == passTotals.end()) {
+				IBMPassStatistics empty;
+				empty.pass = p.pass;
+				total = passTotals.insert(passTotals.end(), empty);
+			}
+			for (auto side : { std::make_pair(&total->before, &p.before),
+					std::make_pair(&total->after, &p.after) }) {
+				side.first->nGates += side.second->nGates;
+				side.first->nTwoQubitGates += side.second->nTwoQubitGates;
+				side.first->depth = std::max(side.first->depth, side.second->depth);
+			}
+		}
+	}
+
+	std::stringstream stats;
+	for (auto& kv : kernelStatistics) {
+		stats << "\n  " << kernelNames[kv.first] << ": " << kv.second.toString();
+	}
+	for (auto& p : passTotals) {
+		stats << "\n  " << p.pass << ": " << p.before.toString() << " -> "
+				<< p.after.toString();
+	}
+	xacc::info("IBM circuit statistics:" + stats.str());
+
+	if (nPruned > 0) {
+		xacc::info("Pruned " + std::to_string(nPruned)
+				+ " gates outside the light cone of the measured qubits.");
+	}
 
-		kernelCounter++;
+	if (nReusedPrefixes > 0) {
+		xacc::info("Reused " + std::to_string(nReusedPrefixes)
+				+ " lowered OpenQasm prefixes across " + std::to_string(functions.size())
+				+ " kernels.");
 	}
 
 	jsonStr = jsonStr.substr(0, jsonStr.size()-1) + "]";
@@ -255,71 +706,59 @@ std::vector<std::shared_ptr<AcceleratorBuffer>> IBMAccelerator::processResponse(
 		std::shared_ptr<AcceleratorBuffer> buffer,
 		const std::string& response) {
 
-	if (boost::contains(response, "error")) {
-		xacc::error( response );
-	}
-	Document d;
-	d.Parse(response);
-	std::string jobId = std::string(d["id"].GetString());
-
-	std::string getPath = "/api/Jobs/"+jobId + "?access_token="+currentApiToken;
-
-	std::string getResponse = handleExceptionRestClientGet(url, getPath);
-
-	// Loop until the job is complete,
-	// get the JSON response
-	std::string msg;
-	bool jobCompleted = false;
-	while (!jobCompleted) {
+	return processResults(buffer, waitForJob(response));
+}
 
-		getResponse = handleExceptionRestClientGet(url, getPath);
+std::vector<std::shared_ptr<AcceleratorBuffer>> IBMAccelerator::processResults(
+		std::shared_ptr<AcceleratorBuffer> buffer, const std::string& results) {
+	Document d;
+	d.Parse(results);
 
-		// Search the result for the status : COMPLETED indicator
-		if (boost::contains(getResponse, "COMPLETED")) {
-			jobCompleted = true;
-		}
+	auto qasmsArray = d["qasms"].GetArray();
 
-		Document d;
-		d.Parse(getResponse);
-		if (d.HasMember("infoQueue")) {
-			auto info = d["infoQueue"].GetObject();
-//			std::cout << "\r                                                 ";
-			std::cout << "\r" << "Job Response: " << d["status"].GetString()
-					<< ", queue: " << d["infoQueue"]["status"].GetString();
-			if (info.HasMember("position")) {
-				std::cout << " position " << d["infoQueue"]["position"].GetInt()
-						<< std::flush;
+	// The readout calibration kernels end the job,
+	// preparing every qubit in 0 and then in 1
+	int nKernels = kernelCircuits.size() - nCalibrationKernels;
+	if (nCalibrationKernels > 0) {
+		// These kernels measure physical qubits, which
+		// may lie beyond the width of the buffer
+		std::set<int> qubits(physicalSupports[nKernels].begin(),
+				physicalSupports[nKernels].end());
+		auto nBits = std::max(buffer->size(),
+				qubits.empty() ? 0 : *qubits.rbegin() + 1);
+		auto calibration = std::make_shared<IBMReadoutCalibration>(qubits);
+		for (int i = nKernels; i < kernelCircuits.size(); i++) {
+			const Value& counts =
+					qasmsArray[kernelCircuits[i]]["result"]["data"]["counts"];
+			for (Value::ConstMemberIterator itr = counts.MemberBegin();
+					itr != counts.MemberEnd(); ++itr) {
+				calibration->addShots(i > nKernels,
+						decodeOutcome(itr->name.GetString(), kernelReadouts[i],
+								nBits), itr->value.GetInt());
 			}
-		} else {
-//			std::cout << "\r                                                 ";
-			std::cout << "\r" << "Job Response: " << d["status"].GetString()
-					<< std::flush;
 		}
-		std::this_thread::sleep_for(std::chrono::milliseconds(100));
-//		std::cout << "GetResponse: " << getResponse << "\n";
+		calibration->timestamp = std::time(nullptr);
+
+		auto backend = xacc::optionExists("ibm-backend") ?
+				xacc::getOption("ibm-backend") : "ibmqx_qasm_simulator";
+		readoutCalibrations[backend] = calibration;
+		for (auto q : qubits) {
+			xacc::info("Qubit " + std::to_string(q) + " assignment errors p01 = "
+					+ std::to_string(calibration->flipProbability(q, 0)) + ", p10 = "
+					+ std::to_string(calibration->flipProbability(q, 1)) + ".");
+		}
 	}
 
-	std::cout << std::endl;
-
-	xacc::info(getResponse);
-	d.Parse(getResponse);
-
-	auto qasmsArray = d["qasms"].GetArray();
-	if (qasmsArray.Size() == 1) {
-		const Value& counts = qasmsArray[0]["result"]["data"]["counts"];
+	if (nKernels == 1) {
+		const Value& counts =
+				qasmsArray[kernelCircuits[0]]["result"]["data"]["counts"];
 		for (Value::ConstMemberIterator itr = counts.MemberBegin();
 				itr != counts.MemberEnd(); ++itr) {
 
-			// NOTE THESE BITS ARE LEFT MOST IS MOST SIGNIFICANT,
-			// LEFT MOST IS (N-1)th Qubit, RIGHT MOST IS 0th qubit
 			std::string bitStr = itr->name.GetString();
 			int nOccurrences = itr->value.GetInt();
-			if (chosenBackend.isSimulator) {
-				boost::replace_all(bitStr, " ", "");
-			} else {
-				bitStr = bitStr.substr(bitStr.length()-buffer->size(), bitStr.length());
-			}
-			boost::dynamic_bitset<> outcome(bitStr);
+			auto outcome = decodeOutcome(bitStr, kernelReadouts[0],
+					buffer->size());
 			std::stringstream xx;
 			xx << outcome << " " << nOccurrences << " times";
 			xacc::info("IBM Measurement outcome: " + xx.str() +".");
@@ -328,14 +767,18 @@ std::vector<std::shared_ptr<AcceleratorBuffer>> IBMAccelerator::processResponse(
 			}
 		}
 
-		measurementSupports.clear();
+		attachStatistics(buffer, 0);
+		attachReadoutCalibration(buffer, 0);
+		clearJobState();
 		// Return empty list since data is stored on the given buffer.
 		return std::vector<std::shared_ptr<AcceleratorBuffer>>{};
 	} else {
 
 		std::vector<std::shared_ptr<AcceleratorBuffer>> buffers;
 
-		for (SizeType i = 0; i < qasmsArray.Size(); i++) {
+		// Kernels packed into one circuit each
+		// read their own qubits of its counts
+		for (int i = 0; i < nKernels; i++) {
 
 			xacc::info("--------------------------");
 			xacc::info("Kernel " + std::to_string(i));
@@ -345,46 +788,30 @@ std::vector<std::shared_ptr<AcceleratorBuffer>> IBMAccelerator::processResponse(
 			}
 			xacc::info("Measured Qubits: " + sss.str());
 
-			auto tmpBuffer = createBuffer(buffer->name() + std::to_string(i),
+			auto bufferId = jobKernelIds.empty() ? i : jobKernelIds[i];
+			auto tmpBuffer = createBuffer(buffer->name() + std::to_string(bufferId),
 					buffer->size());
 
-			const Value& counts = qasmsArray[i]["result"]["data"]["counts"];
+			const Value& counts =
+					qasmsArray[kernelCircuits[i]]["result"]["data"]["counts"];
 			for (Value::ConstMemberIterator itr = counts.MemberBegin();
 					itr != counts.MemberEnd(); ++itr) {
 
-				// NOTE THESE BITS ARE LEFT MOST IS MOST SIGNIFICANT,
-				// LEFT MOST IS (N-1)th Qubit, RIGHT MOST IS 0th qubit
 				std::string bitStr = itr->name.GetString();
 				int nOccurrences = itr->value.GetInt();
 
-				if (chosenBackend.isSimulator) {
-					boost::replace_all(bitStr, " ", "");
-				}
-
 				xacc::info("IBM Results: " + std::string(bitStr) + ":" + std::to_string(nOccurrences));
 
-				if (!chosenBackend.isSimulator) {
-					if (buffer->size() < bitStr.length()) {
-						bitStr = bitStr.substr(bitStr.length() - buffer->size(),
-								bitStr.length());
-					}
-
-					// Turn off measure results that didn't have
-					// a requested measurement gate, otherwise our
-					// expectation values will be skewed.
-					auto supportedQbits = measurementSupports[i];
-					int counter = 0;
-					for (int i = bitStr.length()-1; i >= 0; i--) {
-						if (std::find(supportedQbits.begin(), supportedQbits.end(), counter) == supportedQbits.end()) {
-							bitStr[i] = '0';
-						}
-						counter++;
-					}
-				}
+				// Turn off measure results that didn't have
+				// a requested measurement gate, otherwise our
+				// expectation values will be skewed.
+				auto outcome = decodeOutcome(bitStr, kernelReadouts[i],
+						buffer->size());
 
-				xacc::info("Our Results: " + std::string(bitStr) + ":" + std::to_string(itr->value.GetInt()));
+				std::stringstream xx;
+				xx << outcome;
+				xacc::info("Our Results: " + xx.str() + ":" + std::to_string(nOccurrences));
 
-				boost::dynamic_bitset<> outcome(bitStr);
 				for (int i = 0; i < nOccurrences; i++) {
 					tmpBuffer->appendMeasurement(outcome);
 				}
@@ -392,44 +819,1210 @@ std::vector<std::shared_ptr<AcceleratorBuffer>> IBMAccelerator::processResponse(
 
 			xacc::info("--------------------------");
 
+			attachStatistics(tmpBuffer, i);
+			attachReadoutCalibration(tmpBuffer, i);
 			buffers.push_back(tmpBuffer);
 		}
 
-		measurementSupports.clear();
+		clearJobState();
 		return buffers;
 	}
 }
 
 
-std::shared_ptr<AcceleratorGraph> IBMAccelerator::getAcceleratorConnectivity() {
-	std::string backendName = "ibmqx_qasm_simulator";
+std::vector<std::shared_ptr<AcceleratorBuffer>> IBMAccelerator::submitJob(
+		std::shared_ptr<AcceleratorBuffer> buffer,
+		const std::vector<std::shared_ptr<Function>> functions) {
+	if (!xacc::optionExists("ibm-correct-assignment-errors")) {
+		return postJob(buffer, functions);
+	}
 
-	if (xacc::optionExists("ibm-backend")) {
-		backendName = xacc::getOption("ibm-backend");
+	// Calibrate when the backend has no calibration of these
+	// qubits, or it is older than --ibm-assignment-error-ttl
+	std::set<int> qubits;
+	for (auto f : functions) {
+		auto active = getActiveQubits(f);
+		qubits.insert(active.begin(), active.end());
+	}
+	double ttlMinutes = 60.0;
+	if (xacc::optionExists("ibm-assignment-error-ttl")) {
+		ttlMinutes = std::stod(xacc::getOption("ibm-assignment-error-ttl"));
+	}
+	auto backend = xacc::optionExists("ibm-backend") ?
+			xacc::getOption("ibm-backend") : "ibmqx_qasm_simulator";
+	auto calibration = readoutCalibrations.find(backend);
+	if (qubits.empty() || (calibration != readoutCalibrations.end()
+			&& std::includes(calibration->second->qubits.begin(),
+					calibration->second->qubits.end(), qubits.begin(),
+					qubits.end())
+			&& std::difftime(std::time(nullptr), calibration->second->timestamp)
+					< ttlMinutes * 60.0)) {
+		return postJob(buffer, functions);
 	}
 
-	if (!availableBackends.count(backendName)) {
-		xacc::error(backendName + " is not available.");
+	if (xacc::optionExists("ibm-assignment-error-shots")) {
+		computeMeasurementAccuracy(buffer, qubits);
+		return postJob(buffer, functions);
 	}
 
-	auto backend = availableBackends[backendName];
-	auto graph = std::make_shared<AcceleratorGraph>(backend.nQubits);
+	auto jobFunctions = functions;
+	auto kernels = readoutCalibrationKernels(qubits);
+	jobFunctions.insert(jobFunctions.end(), kernels.begin(), kernels.end());
+	nCalibrationKernels = kernels.size();
+	return postJob(buffer, jobFunctions);
+}
 
-	if (!backend.couplers.empty()) {
-		for (auto es : backend.couplers) {
-			graph->addEdge(es.first, es.second);
-		}
-	} else {
-		for (int i = 0; i < backend.nQubits; i++) {
-			for (int j = 0; j < backend.nQubits; j++) {
-				if (i < j) {
-					graph->addEdge(i, j);
-				}
+void IBMAccelerator::computeMeasurementAccuracy(
+		std::shared_ptr<AcceleratorBuffer> buffer, const std::set<int>& qubits) {
+	auto kernels = readoutCalibrationKernels(qubits);
+	nCalibrationKernels = kernels.size();
+	ScopedValue<int> shots(allocatedShots,
+			std::stoi(xacc::getOption("ibm-assignment-error-shots")));
+	postJob(buffer, kernels);
+}
+
+std::vector<std::shared_ptr<Function>> IBMAccelerator::readoutCalibrationKernels(
+		const std::set<int>& qubits) {
+	auto provider = xacc::getService<IRProvider>("gate");
+	std::vector<std::shared_ptr<Function>> kernels;
+	for (int prepared = 0; prepared < 2; prepared++) {
+		auto kernel = std::make_shared<GateFunction>(
+				"readout_calibration" + std::to_string(prepared));
+		for (auto q : qubits) {
+			if (prepared) {
+				kernel->addInstruction(provider->createInstruction("X",
+						std::vector<int> { q }, std::vector<InstructionParameter> { }));
 			}
+			kernel->addInstruction(provider->createInstruction("Measure",
+					std::vector<int> { q },
+					std::vector<InstructionParameter> { InstructionParameter(q) }));
+		}
+		kernels.push_back(kernel);
+	}
+	return kernels;
+}
+
+void IBMAccelerator::attachReadoutCalibration(
+		std::shared_ptr<AcceleratorBuffer> buffer, const int kernelIdx) {
+	auto ibmBuffer = std::dynamic_pointer_cast<IBMAcceleratorBuffer>(buffer);
+	if (!ibmBuffer || !xacc::optionExists("ibm-correct-assignment-errors")) {
+		return;
+	}
+
+	auto backend = xacc::optionExists("ibm-backend") ?
+			xacc::getOption("ibm-backend") : "ibmqx_qasm_simulator";
+	// The calibration is of the physical qubits each
+	// logical qubit of the buffer was measured on
+	auto calibration = readoutCalibrations.find(backend);
+	if (calibration != readoutCalibrations.end()) {
+		ibmBuffer->setReadoutCalibration(calibration->second,
+				measurementSupports[kernelIdx], physicalSupports[kernelIdx]);
+	}
+}
+
+std::vector<std::shared_ptr<AcceleratorBuffer>> IBMAccelerator::postJob(
+		std::shared_ptr<AcceleratorBuffer> buffer,
+		const std::vector<std::shared_ptr<Function>> functions) {
+	auto payload = processInput(buffer, functions);
+	std::map<std::string, std::string> headers;
+	auto cache = getResultCache();
+	if (!cache) {
+		return processResponse(buffer,
+				handleExceptionRestClientPost(remoteUrl, postPath, payload,
+						headers));
+	}
+
+	// Key each circuit by backend, shots and its payload entry
+	Document job;
+	job.Parse(payload);
+	auto keyPrefix = std::string(job["backend"]["name"].GetString()) + "\n"
+			+ std::to_string(job["shots"].GetInt()) + "\n";
+	auto& qasms = job["qasms"];
+	bool bypass = xacc::optionExists("ibm-result-cache-bypass");
+	std::vector<std::string> keys;
+	std::vector<std::string> counts(qasms.Size());
+	std::vector<int> misses;
+	for (SizeType c = 0; c < qasms.Size(); c++) {
+		StringBuffer entry;
+		Writer<StringBuffer> writer(entry);
+		qasms[c].Accept(writer);
+		keys.push_back(keyPrefix + entry.GetString());
+		if (bypass || !cache->get(keys[c], counts[c])) {
+			misses.push_back(c);
+		}
+	}
+
+	// Submit only the circuits that missed, and cache their counts
+	if (!misses.empty()) {
+		Document missJob;
+		missJob.CopyFrom(job, missJob.GetAllocator());
+		auto& missQasms = missJob["qasms"];
+		missQasms.Clear();
+		for (auto c : misses) {
+			Value qasm(qasms[c], missJob.GetAllocator());
+			missQasms.PushBack(qasm, missJob.GetAllocator());
+		}
+		StringBuffer missPayload;
+		Writer<StringBuffer> writer(missPayload);
+		missJob.Accept(writer);
+
+		Document d;
+		d.Parse(waitForJob(handleExceptionRestClientPost(remoteUrl, postPath,
+				missPayload.GetString(), headers)));
+		auto qasmsArray = d["qasms"].GetArray();
+		for (int j = 0; j < misses.size(); j++) {
+			StringBuffer missCounts;
+			Writer<StringBuffer> countsWriter(missCounts);
+			qasmsArray[j]["result"]["data"]["counts"].Accept(countsWriter);
+			counts[misses[j]] = missCounts.GetString();
+			cache->put(keys[misses[j]], counts[misses[j]]);
 		}
 	}
 
-	return graph;
+	xacc::info("IBM result cache " + cache->getDirectory() + ": "
+			+ std::to_string(qasms.Size() - misses.size()) + " of "
+			+ std::to_string(qasms.Size()) + " circuits cached, hit rate "
+			+ std::to_string(cache->getHitRate()) + ".");
+
+	std::string results = "{\"qasms\": [";
+	for (auto& c : counts) {
+		results += "{\"result\": {\"data\": {\"counts\": " + c + "}}},";
+	}
+	results = results.substr(0, results.size() - 1) + "]}";
+	return processResults(buffer, results);
+}
+
+std::vector<std::shared_ptr<Function>> IBMAccelerator::loadPrecompiledKernels(
+		const std::string& source) {
+	if (!xacc::optionExists("ibm-kernel-file")) {
+		return std::vector<std::shared_ptr<Function>> { };
+	}
+
+	IBMKernelFile file(xacc::getOption("ibm-kernel-file"));
+	if (!file.load(kernelFileHash(source))) {
+		return std::vector<std::shared_ptr<Function>> { };
+	}
+
+	// Mapped kernels measure physical qubits, hand the logical
+	// qubit of each measurement back to the result decoding
+	auto kernels = file.getKernels();
+	for (int k = 0; k < kernels.size(); k++) {
+		compilationContext->recordMeasuredQubits(kernels[k],
+				file.getMeasuredQubits(k));
+	}
+	return kernels;
+}
+
+void IBMAccelerator::savePrecompiledKernels(const std::string& source,
+		std::vector<std::shared_ptr<Function>> kernels) {
+	if (!xacc::optionExists("ibm-kernel-file")) {
+		return;
+	}
+
+	std::vector<std::vector<int>> measured;
+	for (auto kernel : kernels) {
+		measured.push_back(compilationContext->getMeasuredQubits(kernel));
+	}
+
+	IBMKernelFile file(xacc::getOption("ibm-kernel-file"));
+	file.save(kernelFileHash(source), kernels, measured);
+}
+
+std::uint64_t IBMAccelerator::kernelFileHash(const std::string& source) {
+	std::stringstream key;
+	key << (xacc::optionExists("ibm-backend") ?
+			xacc::getOption("ibm-backend") : "ibmqx_qasm_simulator") << "\n";
+	key << "version " << IBMKernelFile::formatVersion() << "\n";
+	for (auto option : { "ibm-no-qubit-placement", "ibm-no-qubit-routing",
+			"ibm-no-gate-cancellation" }) {
+		key << option << " " << xacc::optionExists(option) << "\n";
+	}
+	key << "ibm-schedule " << (xacc::optionExists("ibm-schedule") ?
+			xacc::getOption("ibm-schedule") : "none") << "\n";
+	return IBMKernelFile::hash(key.str() + source);
+}
+
+std::shared_ptr<IBMResultCache> IBMAccelerator::getResultCache() {
+	bool simulator = !xacc::optionExists("ibm-backend")
+			|| chosenBackend.isSimulator;
+	if (!xacc::optionExists("ibm-result-cache") || !simulator) {
+		return nullptr;
+	}
+
+	auto directory = xacc::getOption("ibm-result-cache");
+	if (!resultCache || resultCache->getDirectory() != directory) {
+		std::uintmax_t maxMegabytes = 64;
+		if (xacc::optionExists("ibm-result-cache-size")) {
+			maxMegabytes = std::stoul(xacc::getOption("ibm-result-cache-size"));
+		}
+		std::time_t maxHours = 7 * 24;
+		if (xacc::optionExists("ibm-result-cache-age")) {
+			maxHours = std::stol(xacc::getOption("ibm-result-cache-age"));
+		}
+		resultCache = std::make_shared<IBMResultCache>(directory,
+				maxMegabytes * 1024 * 1024, maxHours * 3600);
+	}
+	return resultCache;
+}
+
+std::string IBMAccelerator::waitForJob(const std::string& response) {
+	if (boost::contains(response, "error")) {
+		xacc::error( response );
+	}
+	Document d;
+	d.Parse(response);
+	std::string jobId = std::string(d["id"].GetString());
+
+	std::string getPath = "/api/Jobs/"+jobId + "?access_token="+currentApiToken;
+
+	std::string getResponse = handleExceptionRestClientGet(url, getPath);
+
+	// Loop until the job is complete,
+	// get the JSON response
+	std::string msg;
+	bool jobCompleted = false;
+	while (!jobCompleted) {
+
+		getResponse = handleExceptionRestClientGet(url, getPath);
+
+		// Search the result for the status : COMPLETED indicator
+		if (boost::contains(getResponse, "COMPLETED")) {
+			jobCompleted = true;
+		}
+
+		Document d;
+		d.Parse(getResponse);
+		if (d.HasMember("infoQueue")) {
+			auto info = d["infoQueue"].GetObject();
+//			std::cout << "\r                                                 ";
+			std::cout << "\r" << "Job Response: " << d["status"].GetString()
+					<< ", queue: " << d["infoQueue"]["status"].GetString();
+			if (info.HasMember("position")) {
+				std::cout << " position " << d["infoQueue"]["position"].GetInt()
+						<< std::flush;
+			}
+		} else {
+//			std::cout << "\r                                                 ";
+			std::cout << "\r" << "Job Response: " << d["status"].GetString()
+					<< std::flush;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+//		std::cout << "GetResponse: " << getResponse << "\n";
+	}
+
+	std::cout << std::endl;
+
+	xacc::info(getResponse);
+	return getResponse;
+}
+
+int IBMAccelerator::appendCounts(std::shared_ptr<AcceleratorBuffer> buffer,
+		const Value& counts, const std::vector<std::pair<int, int>>& readout) {
+	int nShots = 0;
+	for (Value::ConstMemberIterator itr = counts.MemberBegin();
+			itr != counts.MemberEnd(); ++itr) {
+		auto outcome = decodeOutcome(itr->name.GetString(), readout,
+				buffer->size());
+		int nOccurrences = itr->value.GetInt();
+		for (int i = 0; i < nOccurrences; i++) {
+			buffer->appendMeasurement(outcome);
+		}
+		nShots += nOccurrences;
+	}
+	return nShots;
+}
+
+std::vector<std::shared_ptr<AcceleratorBuffer>> IBMAccelerator::executeAdaptive(
+		std::shared_ptr<AcceleratorBuffer> buffer,
+		const std::vector<std::shared_ptr<Function>> functions) {
+	// Chunks are posted directly, so no calibration would be
+	// run or attached to the buffers
+	if (xacc::optionExists("ibm-correct-assignment-errors")) {
+		xacc::error("IBMAccelerator: --ibm-correct-assignment-errors "
+				"can not be used with --ibm-target-error.");
+	}
+
+	auto targetError = std::stod(xacc::getOption("ibm-target-error"));
+	int chunkShots = 256;
+	if (xacc::optionExists("ibm-chunk-shots")) {
+		chunkShots = std::stoi(xacc::getOption("ibm-chunk-shots"));
+	}
+	int maxShots = 8192;
+	if (xacc::optionExists("ibm-max-shots")) {
+		maxShots = std::stoi(xacc::getOption("ibm-max-shots"));
+	}
+
+	// Compile every kernel once, each chunk resubmits the
+	// circuits of the kernels that have not converged yet
+	Document payload;
+	{
+		ScopedValue<int> shots(allocatedShots, chunkShots);
+		payload.Parse(processInput(buffer, functions));
+	}
+
+	auto readouts = kernelReadouts;
+	auto circuitOf = kernelCircuits;
+	std::vector<std::shared_ptr<AcceleratorBuffer>> buffers;
+	for (int k = 0; k < functions.size(); k++) {
+		auto bufferId = jobKernelIds.empty() ? k : jobKernelIds[k];
+		auto kernelBuffer = functions.size() == 1 ?
+				buffer :
+				createBuffer(buffer->name() + std::to_string(bufferId),
+						buffer->size());
+		attachStatistics(kernelBuffer, k);
+		buffers.push_back(kernelBuffer);
+	}
+	clearJobState();
+
+	std::vector<int> issued(functions.size(), 0);
+	std::vector<int> received(functions.size(), 0);
+	std::vector<double> errors(functions.size(), 1.0);
+	std::vector<bool> converged(functions.size(), false);
+
+	// Post a chunk of the circuits still needed, returning false
+	// if every kernel has converged or used up its shots
+	std::deque<std::pair<std::string, std::vector<int>>> inFlight;
+	auto submit = [&]() {
+		std::set<int> circuits;
+		for (int k = 0; k < functions.size(); k++) {
+			if (!converged[k] && issued[k] < maxShots) {
+				circuits.insert(circuitOf[k]);
+			}
+		}
+		if (circuits.empty()) {
+			return false;
+		}
+
+		Document job;
+		job.CopyFrom(payload, job.GetAllocator());
+		auto& qasms = job["qasms"];
+		qasms.Clear();
+		for (auto c : circuits) {
+			Value qasm(payload["qasms"][c], job.GetAllocator());
+			qasms.PushBack(qasm, job.GetAllocator());
+		}
+		StringBuffer jobStr;
+		Writer<StringBuffer> writer(jobStr);
+		job.Accept(writer);
+
+		std::map<std::string, std::string> headers;
+		auto response = handleExceptionRestClientPost(remoteUrl, postPath,
+				jobStr.GetString(), headers);
+		for (int k = 0; k < functions.size(); k++) {
+			if (circuits.count(circuitOf[k])) {
+				issued[k] += chunkShots;
+			}
+		}
+		inFlight.push_back(std::make_pair(response,
+				std::vector<int>(circuits.begin(), circuits.end())));
+		return true;
+	};
+
+	// Keep one chunk queued behind the one we wait on
+	int nChunks = 0;
+	while (true) {
+		while (inFlight.size() < 2 && submit()) {
+			nChunks++;
+		}
+		if (inFlight.empty()) {
+			break;
+		}
+
+		auto job = inFlight.front();
+		inFlight.pop_front();
+		Document d;
+		d.Parse(waitForJob(job.first));
+		auto qasmsArray = d["qasms"].GetArray();
+		for (int j = 0; j < job.second.size(); j++) {
+			for (int k = 0; k < functions.size(); k++) {
+				if (circuitOf[k] != job.second[j]) {
+					continue;
+				}
+				received[k] += appendCounts(buffers[k],
+						qasmsArray[j]["result"]["data"]["counts"], readouts[k]);
+				if (received[k] > 0) {
+					auto expectation = buffers[k]->getExpectationValueZ();
+					errors[k] = std::sqrt(
+							IBMShotAllocation::variance(expectation, received[k])
+									/ received[k]);
+					converged[k] = converged[k] || errors[k] <= targetError;
+				}
+			}
+		}
+	}
+
+	std::stringstream ss;
+	for (int k = 0; k < functions.size(); k++) {
+		ss << "\n  " << functions[k]->name() << ": " << received[k]
+				<< " shots, standard error " << errors[k]
+				<< (converged[k] ? "" : ", stopped at --ibm-max-shots");
+	}
+	xacc::info("IBM adaptive sampling in " + std::to_string(nChunks)
+			+ " chunks:" + ss.str());
+
+	if (functions.size() == 1) {
+		return std::vector<std::shared_ptr<AcceleratorBuffer>> { };
+	}
+	return buffers;
+}
+
+std::vector<IBMCircuit> IBMAccelerator::groupCommutingKernels(
+		const std::vector<std::shared_ptr<Function>> functions,
+		std::vector<std::shared_ptr<Function>> kernels) {
+
+	std::vector<MeasurementSuffix> splits(functions.size());
+	std::vector<bool> groupable(functions.size(), false);
+	for (int k = 0; k < functions.size(); k++) {
+		groupable[k] = splitMeasurementSuffix(functions[k], splits[k])
+				&& splits[k].measureOrder.size() == measurementSupports[k].size();
+	}
+
+	// Greedily put each kernel in the first group with the same
+	// prefix that rotates every shared qubit into the same basis
+	std::vector<std::vector<int>> groups;
+	std::vector<std::map<int, std::vector<std::shared_ptr<Instruction>>>> groupBases;
+	std::vector<int> kernelGroup(functions.size(), -1);
+	for (int k = 0; k < functions.size(); k++) {
+		if (!groupable[k]) {
+			continue;
+		}
+
+		for (int g = 0; g < groups.size() && kernelGroup[k] < 0; g++) {
+			if (!samePrefix(splits[groups[g][0]].prefix, splits[k].prefix)) {
+				continue;
+			}
+			bool commute = true;
+			for (auto& kv : splits[k].measures) {
+				auto basis = groupBases[g].find(kv.first);
+				if (basis != groupBases[g].end()
+						&& !sameGates(basis->second,
+								splits[k].basisGates[kv.first])) {
+					commute = false;
+					break;
+				}
+			}
+			if (commute) {
+				kernelGroup[k] = g;
+			}
+		}
+
+		if (kernelGroup[k] < 0) {
+			kernelGroup[k] = groups.size();
+			groups.push_back(std::vector<int> { });
+			groupBases.push_back(
+					std::map<int, std::vector<std::shared_ptr<Instruction>>> { });
+		}
+		groups[kernelGroup[k]].push_back(k);
+		for (auto& kv : splits[k].measures) {
+			groupBases[kernelGroup[k]][kv.first] = splits[k].basisGates[kv.first];
+		}
+	}
+
+	std::vector<IBMCircuit> circuits;
+	for (int k = 0; k < functions.size(); k++) {
+		auto g = kernelGroup[k];
+		if (g < 0 || groups[g].size() == 1) {
+			circuits.push_back(singleKernelCircuit(kernels[k], k,
+					measurementSupports[k].size()));
+			continue;
+		}
+		if (groups[g][0] != k) {
+			continue;
+		}
+
+		// The shared prefix, then each qubit's basis
+		// change and a single measurement read by
+		// every kernel of the group that measures it
+		IBMCircuit circuit;
+		circuit.function = emptyCopy(functions[k]);
+		circuit.kernels = groups[g];
+		for (auto inst : splits[k].prefix) {
+			circuit.function->addInstruction(inst);
+		}
+		for (auto& kv : groupBases[g]) {
+			for (auto inst : kv.second) {
+				circuit.function->addInstruction(inst);
+			}
+
+			std::shared_ptr<Instruction> measure;
+			std::vector<std::pair<int, int>> owners;
+			for (auto member : groups[g]) {
+				auto& order = splits[member].measureOrder;
+				auto position = std::find(order.begin(), order.end(), kv.first);
+				if (position != order.end()) {
+					owners.push_back(
+							std::make_pair(member, position - order.begin()));
+					if (!measure) {
+						measure = splits[member].measures[kv.first];
+					}
+				}
+			}
+			circuit.function->addInstruction(measure);
+			circuit.measureOwners.push_back(owners);
+		}
+		circuits.push_back(circuit);
+	}
+
+	return circuits;
+}
+
+std::vector<IBMCircuit> IBMAccelerator::packKernels(
+		std::vector<IBMCircuit> kernels) {
+
+	if (!xacc::optionExists("ibm-pack-kernels") || chosenBackend.isSimulator
+			|| !chosenBackend.topology || chosenBackend.topology->isComplete()) {
+		return kernels;
+	}
+
+	// First fit: move each kernel onto qubits left free by the
+	// kernels already in a circuit, keeping every two qubit gate
+	// on a coupler of the same direction. A kernel that fits
+	// nowhere starts a new circuit where it already is.
+	// Readout calibration kernels stay on the qubits they calibrate
+	int firstCalibration = measurementSupports.size() - nCalibrationKernels;
+	auto provider = xacc::getService<IRProvider>("gate");
+	std::vector<IBMCircuit> circuits;
+	std::vector<std::set<int>> usedQubits;
+	std::vector<bool> flattened;
+	for (auto& kernel : kernels) {
+		bool calibrating = std::any_of(kernel.kernels.begin(),
+				kernel.kernels.end(), [&](int k) {return k >= firstCalibration;});
+		if (calibrating || !isFlattenable(kernel.function)) {
+			circuits.push_back(kernel);
+			usedQubits.push_back(std::set<int> { });
+			flattened.push_back(false);
+			continue;
+		}
+
+		auto instructions = flattenKernel(kernel.function);
+		std::set<int> qubits;
+		std::set<std::pair<int, int>> edges;
+		for (auto inst : instructions) {
+			auto bits = inst->bits();
+			qubits.insert(bits.begin(), bits.end());
+			if (bits.size() == 2) {
+				edges.insert(std::make_pair(bits[0], bits[1]));
+			}
+		}
+
+		bool packed = false;
+		for (int c = 0; c < circuits.size() && !packed; c++) {
+			if (usedQubits[c].empty()) {
+				continue;
+			}
+			auto embedding = IBMQubitPlacement::findEmbedding(qubits, edges,
+					*chosenBackend.topology, true, usedQubits[c]);
+			if (embedding.empty()) {
+				continue;
+			}
+
+			// Flatten the circuit's first kernel before appending
+			auto& circuit = circuits[c];
+			if (!flattened[c]) {
+				auto first = emptyCopy(circuit.function);
+				for (auto inst : flattenKernel(circuit.function)) {
+					first->addInstruction(inst);
+				}
+				circuit.function = first;
+				flattened[c] = true;
+			}
+
+			for (auto inst : instructions) {
+				std::vector<int> bits;
+				for (auto b : inst->bits()) {
+					bits.push_back(embedding[b]);
+				}
+				circuit.function->addInstruction(
+						remapInstruction(provider, inst, bits));
+			}
+			for (auto& kv : embedding) {
+				usedQubits[c].insert(kv.second);
+			}
+			circuit.kernels.insert(circuit.kernels.end(),
+					kernel.kernels.begin(), kernel.kernels.end());
+			circuit.measureOwners.insert(circuit.measureOwners.end(),
+					kernel.measureOwners.begin(), kernel.measureOwners.end());
+			packed = true;
+		}
+
+		if (!packed) {
+			circuits.push_back(kernel);
+			usedQubits.push_back(qubits);
+			flattened.push_back(false);
+		}
+	}
+
+	return circuits;
+}
+
+std::vector<std::shared_ptr<AcceleratorBuffer>> IBMAccelerator::execute(
+		std::shared_ptr<AcceleratorBuffer> buffer,
+		const std::vector<std::shared_ptr<Function>> functions) {
+	if (!xacc::optionExists("ibm-dry-run")) {
+		if (xacc::optionExists("ibm-target-error")) {
+			return executeAdaptive(buffer, functions);
+		}
+		if (xacc::optionExists("ibm-shot-budget") && functions.size() > 1) {
+			return executeAllocated(buffer, functions);
+		}
+		return submitJob(buffer, functions);
+	}
+
+	processInput(buffer, functions);
+	dryRunReport = createDryRunReport();
+	xacc::info(dryRunReport.toString());
+
+	std::vector<std::shared_ptr<AcceleratorBuffer>> buffers;
+	for (int i = 0; i < functions.size(); i++) {
+		auto bufferId = jobKernelIds.empty() ? i : jobKernelIds[i];
+		auto tmpBuffer = createBuffer(buffer->name() + std::to_string(bufferId),
+				buffer->size());
+		attachStatistics(tmpBuffer, i);
+		buffers.push_back(tmpBuffer);
+	}
+	clearJobState();
+	return buffers;
+}
+
+void IBMAccelerator::execute(std::shared_ptr<AcceleratorBuffer> buffer,
+		const std::shared_ptr<Function> function) {
+	if (!xacc::optionExists("ibm-dry-run")) {
+		if (xacc::optionExists("ibm-target-error")) {
+			executeAdaptive(buffer,
+					std::vector<std::shared_ptr<Function>> { function });
+			return;
+		}
+		submitJob(buffer, std::vector<std::shared_ptr<Function>> { function });
+		return;
+	}
+
+	processInput(buffer, std::vector<std::shared_ptr<Function>> { function });
+	dryRunReport = createDryRunReport();
+	xacc::info(dryRunReport.toString());
+	attachStatistics(buffer, 0);
+	clearJobState();
+}
+
+std::vector<std::vector<std::shared_ptr<AcceleratorBuffer>>> IBMAccelerator::executeSweep(
+		std::shared_ptr<AcceleratorBuffer> buffer,
+		const std::vector<std::shared_ptr<Function>> kernels,
+		const std::vector<std::vector<double>>& parameterSets) {
+	std::vector<std::vector<std::shared_ptr<AcceleratorBuffer>>> results(
+			parameterSets.size());
+	if (kernels.empty()) {
+		return results;
+	}
+
+	int rowsPerJob = parameterSets.size();
+	if (xacc::optionExists("ibm-max-circuits-per-job")) {
+		auto maxCircuits = std::stoi(xacc::getOption("ibm-max-circuits-per-job"));
+		rowsPerJob = std::max(1, maxCircuits / (int) kernels.size());
+	}
+
+	auto provider = xacc::getService<IRProvider>("gate");
+	int nJobs = 0;
+	for (int first = 0; first < parameterSets.size(); first += rowsPerJob) {
+		int last = std::min((int) parameterSets.size(), first + rowsPerJob);
+
+		// Kernels of the same row share their bound state preparation
+		std::vector<std::shared_ptr<Function>> functions;
+		for (int row = first; row < last; row++) {
+			std::map<std::map<std::string, double>, BoundInstructions> bound;
+			for (int k = 0; k < kernels.size(); k++) {
+				functions.push_back(
+						bindKernel(provider, kernels[k], parameterSets[row], bound));
+				compilationContext->inherit(kernels[k], functions.back());
+				jobKernelIds.push_back(row * kernels.size() + k);
+			}
+		}
+
+		// Dispatch like any other execution, so dry runs, adaptive
+		// sampling and shot budgets apply to the bound kernels
+		std::vector<std::shared_ptr<AcceleratorBuffer>> jobBuffers;
+		if (functions.size() == 1) {
+			auto tmpBuffer = createBuffer(
+					buffer->name() + std::to_string(jobKernelIds[0]),
+					buffer->size());
+			jobKernelIds.clear();
+			execute(tmpBuffer, functions[0]);
+			jobBuffers.push_back(tmpBuffer);
+		} else {
+			jobBuffers = execute(buffer, functions);
+		}
+		jobKernelIds.clear();
+
+		for (int i = 0; i < jobBuffers.size(); i++) {
+			results[first + i / kernels.size()].push_back(jobBuffers[i]);
+		}
+		nJobs++;
+	}
+
+	xacc::info("Swept " + std::to_string(parameterSets.size())
+			+ " parameter sets of " + std::to_string(kernels.size())
+			+ " kernels in " + std::to_string(nJobs) + " jobs.");
+	return results;
+}
+
+IBMGradient IBMAccelerator::executeGradient(
+		std::shared_ptr<AcceleratorBuffer> buffer,
+		std::shared_ptr<Function> kernel, const std::vector<double>& parameters) {
+	auto provider = xacc::getService<IRProvider>("gate");
+	auto pi = 3.141592653589793;
+
+	auto params = kernel->getParameters();
+	if (params.size() != parameters.size()) {
+		xacc::error(kernel->name() + " has " + std::to_string(params.size())
+				+ " parameters, but " + std::to_string(parameters.size())
+				+ " values were given for its gradient.");
+	}
+
+	std::map<std::string, int> parameterIdx;
+	for (int i = 0; i < params.size(); i++) {
+		if (params[i].which() == 3) {
+			parameterIdx[boost::get<std::string>(params[i])] = i;
+		}
+	}
+
+	// Find every occurrence of a rotation whose angle is a parameter,
+	// by the path of child indices leading to it, so a rotation in
+	// a composite called twice is shifted once per call
+	std::vector<std::shared_ptr<Instruction>> rotations;
+	std::vector<std::vector<int>> rotationPaths;
+	std::vector<int> rotationParams;
+	std::vector<bool> rotationNegated;
+	std::vector<int> rotationGates;
+	std::map<int, int> nGates;
+	std::vector<int> path;
+	std::function<void(std::shared_ptr<Function>)> findRotations =
+			[&](std::shared_ptr<Function> function) {
+		bool conditional = static_cast<bool>(
+				std::dynamic_pointer_cast<ConditionalFunction>(function));
+		auto instructions = function->getInstructions();
+		for (int i = 0; i < instructions.size(); i++) {
+			auto inst = instructions[i];
+			if (!inst->isEnabled() && !conditional) {
+				continue;
+			}
+			path.push_back(i);
+			if (inst->isComposite()) {
+				findRotations(std::dynamic_pointer_cast<Function>(inst));
+			} else if (inst->isEnabled()) {
+				auto name = inst->name();
+				auto instParams = inst->getParameters();
+				for (auto& p : instParams) {
+					if (p.which() != 3) {
+						continue;
+					}
+					auto angle = boost::get<std::string>(p);
+					bool negated = !angle.empty() && angle[0] == '-';
+					auto param = parameterIdx.find(negated ? angle.substr(1) : angle);
+					if (param == parameterIdx.end()) {
+						// Any other expression of a parameter, eg 2*theta,
+						// would silently drop out of the gradient
+						for (auto& kv : parameterIdx) {
+							if (mentionsVariable(angle, kv.first)) {
+								xacc::error("The parameter shift gradient only "
+										"supports angles theta or -theta, but "
+										+ name + " in " + kernel->name()
+										+ " has angle " + angle + ".");
+							}
+						}
+						continue;
+					}
+					if ((name != "Rx" && name != "Ry" && name != "Rz")
+							|| instParams.size() != 1) {
+						xacc::error("The parameter shift gradient only supports "
+								"Rx, Ry and Rz, but " + name + " in "
+								+ kernel->name() + " depends on " + param->first + ".");
+					}
+					rotations.push_back(inst);
+					rotationPaths.push_back(path);
+					rotationParams.push_back(param->second);
+					rotationNegated.push_back(negated);
+					rotationGates.push_back(nGates[param->second]++);
+				}
+			}
+			path.pop_back();
+		}
+	};
+	findRotations(kernel);
+
+	// The unshifted kernel, then each rotation shifted up and down
+	std::vector<std::shared_ptr<Function>> functions;
+	std::map<std::map<std::string, double>, BoundInstructions> bound;
+	functions.push_back(bindKernel(provider, kernel, parameters, bound));
+
+	std::map<std::string, double> named;
+	for (auto& kv : parameterIdx) {
+		named[kv.first] = parameters[kv.second];
+	}
+
+	IBMGradient result;
+	result.gradient.assign(parameters.size(), 0.0);
+	for (int r = 0; r < rotations.size(); r++) {
+		for (auto shift : { pi / 2.0, -pi / 2.0 }) {
+			auto value = parameters[rotationParams[r]];
+			InstructionParameter angle(
+					(rotationNegated[r] ? -value : value) + shift);
+			auto rotation = provider->createInstruction(
+					rotations[r]->name(), rotations[r]->bits(),
+					std::vector<InstructionParameter> { angle });
+
+			// Copy the composites on the path to the rotation, and
+			// share the rest with the unshifted kernel
+			functions.push_back(std::dynamic_pointer_cast<Function>(
+					bindPath(provider, kernel, rotationPaths[r], 0, rotation, named,
+							bound[named])));
+
+			IBMGradient::Term term;
+			term.parameter = rotationParams[r];
+			term.gate = rotationGates[r];
+			term.shift = shift;
+			term.expectation = 0.0;
+			result.terms.push_back(term);
+		}
+	}
+
+	for (auto f : functions) {
+		compilationContext->inherit(kernel, f);
+	}
+
+	std::vector<std::shared_ptr<AcceleratorBuffer>> buffers;
+	if (functions.size() == 1) {
+		execute(buffer, functions[0]);
+		buffers.push_back(buffer);
+	} else {
+		buffers = execute(buffer, functions);
+	}
+
+	// A dry run only reports the circuits it would submit
+	if (xacc::optionExists("ibm-dry-run")) {
+		return result;
+	}
+
+	// d<Z>/dtheta = (<Z>(theta + pi/2) - <Z>(theta - pi/2)) / 2 for
+	// each rotation, summed over the rotations of each parameter
+	result.expectation = buffers[0]->getExpectationValueZ();
+	for (int t = 0; t < result.terms.size(); t++) {
+		auto& term = result.terms[t];
+		term.expectation = buffers[t + 1]->getExpectationValueZ();
+		auto sign = rotationNegated[t / 2] ? -1.0 : 1.0;
+		result.gradient[term.parameter] += sign * (term.shift > 0 ? 0.5 : -0.5)
+				* term.expectation;
+	}
+
+	xacc::info("Parameter shift gradient of " + kernel->name() + " from "
+			+ std::to_string(functions.size()) + " circuits in one job.");
+	return result;
+}
+
+std::shared_ptr<IBMClassicalShadow> IBMAccelerator::executeShadow(
+		std::shared_ptr<AcceleratorBuffer> buffer,
+		std::shared_ptr<Function> kernel, const int nCircuits,
+		const int shotsPerCircuit, const unsigned int seed) {
+	InstructionIterator it(kernel);
+	while (it.hasNext()) {
+		if (it.next()->name() == "Measure") {
+			xacc::error("Classical shadows need a state preparation kernel, "
+					+ kernel->name() + " already has measurements.");
+		}
+	}
+
+	// Snapshots are packed in 64 bit words, check the
+	// width of the buffer before anything is submitted
+	auto nQubits = buffer->size();
+	auto shadow = std::make_shared<IBMClassicalShadow>(nQubits);
+
+	// Measure the physical qubit each logical qubit was placed on
+	auto layout = compilationContext->getLayout(kernel);
+	std::vector<int> physical;
+	int nBits = nQubits;
+	for (int q = 0; q < nQubits; q++) {
+		physical.push_back(q < layout.size() && layout[q] >= 0 ? layout[q] : q);
+		nBits = std::max(nBits, physical[q] + 1);
+	}
+
+	// Every circuit calls the same kernel, so
+	// its OpenQasm is lowered once for all of them
+	auto provider = xacc::getService<IRProvider>("gate");
+	auto pi = 3.141592653589793;
+	auto bases = IBMClassicalShadow::randomBases(nQubits, nCircuits, seed);
+	std::vector<std::shared_ptr<Function>> functions;
+	for (int c = 0; c < nCircuits; c++) {
+		auto circuit = std::make_shared<GateFunction>(
+				kernel->name() + "_shadow" + std::to_string(c));
+		circuit->addInstruction(kernel);
+		for (int q = 0; q < nQubits; q++) {
+			auto p = physical[q];
+			if (bases[c][q] == 'x') {
+				circuit->addInstruction(provider->createInstruction("H",
+						std::vector<int> { p }, std::vector<InstructionParameter> { }));
+			} else if (bases[c][q] == 'y') {
+				circuit->addInstruction(provider->createInstruction("Rx",
+						std::vector<int> { p },
+						std::vector<InstructionParameter> { InstructionParameter(pi / 2.0) }));
+			}
+			circuit->addInstruction(provider->createInstruction("Measure",
+					std::vector<int> { p },
+					std::vector<InstructionParameter> { InstructionParameter(q) }));
+		}
+		functions.push_back(circuit);
+	}
+
+	// Circuits that happen to share a basis must
+	// still give independent snapshots
+	std::string payload;
+	{
+		ScopedValue<int> shots(allocatedShots, shotsPerCircuit);
+		ScopedValue<bool> grouping(groupMeasurements, false);
+		payload = processInput(buffer, functions);
+	}
+
+	auto readouts = kernelReadouts;
+	auto circuitOf = kernelCircuits;
+	clearJobState();
+
+	std::map<std::string, std::string> headers;
+	auto response = handleExceptionRestClientPost(remoteUrl, postPath, payload,
+			headers);
+	Document d;
+	d.Parse(waitForJob(response));
+	auto qasmsArray = d["qasms"].GetArray();
+
+	for (int c = 0; c < nCircuits; c++) {
+		const Value& counts = qasmsArray[circuitOf[c]]["result"]["data"]["counts"];
+		for (Value::ConstMemberIterator itr = counts.MemberBegin();
+				itr != counts.MemberEnd(); ++itr) {
+			auto outcome = decodeOutcome(itr->name.GetString(), readouts[c], nBits);
+			boost::dynamic_bitset<> logical(nQubits);
+			for (int q = 0; q < nQubits; q++) {
+				logical[q] = outcome[physical[q]];
+			}
+			shadow->addSnapshots(bases[c], logical, itr->value.GetInt());
+		}
+	}
+
+	xacc::info("Classical shadow of " + kernel->name() + ": "
+			+ std::to_string(shadow->size()) + " snapshots from "
+			+ std::to_string(nCircuits) + " circuits.");
+	return shadow;
+}
+
+std::vector<int> IBMAccelerator::allocateShots(
+		const std::vector<std::shared_ptr<Function>> functions) {
+	auto budget = std::stoi(xacc::getOption("ibm-shot-budget"));
+	int minShots = 1;
+	if (xacc::optionExists("ibm-min-shots")) {
+		minShots = std::stoi(xacc::getOption("ibm-min-shots"));
+	}
+
+	std::vector<double> weights(functions.size(), 1.0);
+	if (xacc::optionExists("ibm-shot-weights")) {
+		weights = IBMShotAllocation::parseList(
+				xacc::getOption("ibm-shot-weights"));
+		if (weights.size() != functions.size()) {
+			xacc::error("--ibm-shot-weights needs one weight per kernel, got "
+					+ std::to_string(weights.size()) + " for "
+					+ std::to_string(functions.size()) + " kernels.");
+		}
+	}
+
+	std::vector<double> stddevs(functions.size(), 1.0);
+	if (xacc::optionExists("ibm-shot-variances")) {
+		auto variances = IBMShotAllocation::parseList(
+				xacc::getOption("ibm-shot-variances"));
+		if (variances.size() != functions.size()) {
+			xacc::error("--ibm-shot-variances needs one variance per kernel, got "
+					+ std::to_string(variances.size()) + " for "
+					+ std::to_string(functions.size()) + " kernels.");
+		}
+		for (int k = 0; k < functions.size(); k++) {
+			stddevs[k] = std::sqrt(std::max(variances[k], 0.0));
+		}
+	} else {
+		for (int k = 0; k < functions.size(); k++) {
+			auto last = lastExpectations.find(functions[k]->name());
+			if (last != lastExpectations.end()) {
+				stddevs[k] = std::sqrt(IBMShotAllocation::variance(
+						last->second.first, last->second.second));
+			}
+		}
+	}
+
+	return IBMShotAllocation::allocateLevels(weights, stddevs, budget, minShots);
+}
+
+std::vector<std::shared_ptr<AcceleratorBuffer>> IBMAccelerator::executeAllocated(
+		std::shared_ptr<AcceleratorBuffer> buffer,
+		const std::vector<std::shared_ptr<Function>> functions) {
+	auto shots = allocateShots(functions);
+
+	// IBM jobs take one shot count, so kernels
+	// sharing a shot count share a job
+	std::map<int, std::vector<int>> jobs;
+	std::stringstream ss;
+	for (int k = 0; k < functions.size(); k++) {
+		jobs[shots[k]].push_back(k);
+		ss << "\n  " << functions[k]->name() << ": " << shots[k];
+	}
+	xacc::info("IBM shot allocation:" + ss.str());
+
+	// Buffers are named by the caller's kernel ids, eg those of a sweep
+	auto kernelIds = jobKernelIds;
+	auto bufferId = [&](const int k) {
+		return kernelIds.empty() ? k : kernelIds[k];
+	};
+
+	std::vector<std::shared_ptr<AcceleratorBuffer>> buffers(functions.size());
+	for (auto& job : jobs) {
+		ScopedValue<int> jobShots(allocatedShots, job.first);
+		if (job.second.size() == 1) {
+			auto k = job.second[0];
+			auto tmpBuffer = createBuffer(buffer->name() + std::to_string(bufferId(k)),
+					buffer->size());
+			submitJob(tmpBuffer,
+					std::vector<std::shared_ptr<Function>> { functions[k] });
+			buffers[k] = tmpBuffer;
+			continue;
+		}
+
+		std::vector<std::shared_ptr<Function>> jobFunctions;
+		jobKernelIds.clear();
+		for (auto k : job.second) {
+			jobFunctions.push_back(functions[k]);
+			jobKernelIds.push_back(bufferId(k));
+		}
+		auto jobBuffers = submitJob(buffer, jobFunctions);
+		for (int i = 0; i < jobBuffers.size(); i++) {
+			buffers[job.second[i]] = jobBuffers[i];
+		}
+	}
+	jobKernelIds = kernelIds;
+
+	for (int k = 0; k < functions.size(); k++) {
+		lastExpectations[functions[k]->name()] = std::make_pair(
+				buffers[k]->getExpectationValueZ(), shots[k]);
+	}
+	return buffers;
+}
+
+IBMDryRunReport IBMAccelerator::createDryRunReport() {
+	IBMDryRunReport report;
+	report.backend = xacc::optionExists("ibm-backend") ?
+			xacc::getOption("ibm-backend") : "ibmqx_qasm_simulator";
+	report.shots = jobShots;
+	report.nCircuits = circuitQasmBytes.size();
+	report.nDuplicates = nDuplicateCircuits;
+
+	for (auto& kv : kernelCircuits) {
+		IBMDryRunReport::Kernel kernel;
+		kernel.name = kernelNames[kv.first];
+		kernel.statistics = kernelStatistics[kv.first];
+		kernel.measuredQubits = measurementSupports[kv.first];
+		kernel.qasmBytes = circuitQasmBytes[kv.second];
+		kernel.circuitTime = circuitTimes[kv.second];
+		report.kernels.push_back(kernel);
+	}
+
+	for (auto& kv : circuitQasmBytes) {
+		report.totalQasmBytes += kv.second;
+		report.deviceTime += jobShots
+				* (circuitTimes[kv.first] + jobDurations.repetition);
+	}
+
+	return report;
+}
+
+void IBMAccelerator::clearJobState() {
+	measurementSupports.clear();
+	physicalSupports.clear();
+	kernelReadouts.clear();
+	kernelNames.clear();
+	kernelPassStatistics.clear();
+	kernelStatistics.clear();
+	kernelCircuits.clear();
+	circuitQasmBytes.clear();
+	circuitTimes.clear();
+	nDuplicateCircuits = 0;
+	nCalibrationKernels = 0;
+}
+
+void IBMAccelerator::attachStatistics(std::shared_ptr<AcceleratorBuffer> buffer,
+		const int kernelIdx) {
+	auto ibmBuffer = std::dynamic_pointer_cast<IBMAcceleratorBuffer>(buffer);
+	if (ibmBuffer && kernelStatistics.count(kernelIdx)) {
+		ibmBuffer->setCircuitStatistics(kernelStatistics[kernelIdx],
+				kernelPassStatistics[kernelIdx]);
+	}
+}
+
+std::set<int> IBMAccelerator::getActiveQubits(std::shared_ptr<Function> kernel) {
+	std::set<int> active;
+	InstructionIterator it(kernel);
+	while (it.hasNext()) {
+		auto nextInst = it.next();
+		if (!nextInst->isEnabled()) {
+			continue;
+		}
+		if (auto cond = std::dynamic_pointer_cast<ConditionalFunction>(nextInst)) {
+			active.insert(cond->getConditionalQubit());
+		} else if (!nextInst->isComposite()) {
+			for (auto b : nextInst->bits()) {
+				active.insert(b);
+			}
+		}
+	}
+	return active;
+}
+
+boost::dynamic_bitset<> IBMAccelerator::decodeOutcome(std::string bitStr,
+		const std::vector<std::pair<int, int>>& readout, const int nBits) {
+
+	// NOTE THESE BITS ARE LEFT MOST IS MOST SIGNIFICANT,
+	// LEFT MOST IS (N-1)th classical bit, RIGHT MOST IS 0th
+	boost::replace_all(bitStr, " ", "");
+
+	boost::dynamic_bitset<> outcome(nBits);
+	for (auto& r : readout) {
+		if (r.first < bitStr.length() && r.second < nBits
+				&& bitStr[bitStr.length() - 1 - r.first] == '1') {
+			outcome[r.second] = 1;
+		}
+	}
+	return outcome;
+}
+
+bool IBMAccelerator::isSharablePrefix(std::shared_ptr<Instruction> inst) {
+	if (!std::dynamic_pointer_cast<GateFunction>(inst)) {
+		return false;
+	}
+
+	// Measurements and conditionals depend on the classical
+	// registers declared by the kernel's own visitor, so
+	// any composite containing them is lowered in place.
+	InstructionIterator it(inst);
+	while (it.hasNext()) {
+		auto nextInst = it.next();
+		if (nextInst->name() == "Measure"
+				|| std::dynamic_pointer_cast<ConditionalFunction>(nextInst)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+std::shared_ptr<AcceleratorGraph> IBMAccelerator::getAcceleratorConnectivity() {
+	std::string backendName = "ibmqx_qasm_simulator";
+
+	if (xacc::optionExists("ibm-backend")) {
+		backendName = xacc::getOption("ibm-backend");
+	}
+
+	if (!availableBackends.count(backendName)) {
+		xacc::error(backendName + " is not available.");
+	}
+
+	return availableBackends[backendName].topology->getGraph();
 }
 
 void IBMAccelerator::searchAPIKey(std::string& key, std::string& url) {
@@ -36,12 +36,30 @@
 #include "RuntimeOptions.hpp"
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
+#include <sstream>
+#include <set>
+#include <deque>
 #include "OpenQasmVisitor.hpp"
+#include "OpenQasmCompactor.hpp"
 #include "IBMIRTransformation.hpp"
+#include "IBMQubitPlacement.hpp"
+#include "IBMGateCancellation.hpp"
+#include "IBMInstructionScheduler.hpp"
+#include "IBMPassInstrumentation.hpp"
+#include "IBMQubitRouter.hpp"
+#include "IBMCompressedClient.hpp"
+#include "IBMBackendTopology.hpp"
+#include "IBMGateDurations.hpp"
+#include "IBMShotAllocation.hpp"
+#include "IBMClassicalShadow.hpp"
+#include "IBMResultCache.hpp"
+#include "IBMReadoutCalibration.hpp"
+#include "IBMKernelFile.hpp"
 
 #define RAPIDJSON_HAS_STDSTRING 1
 
 #include "rapidjson/prettywriter.h"
+#include "rapidjson/stringbuffer.h"
 #include "rapidjson/document.h"
 
 using namespace rapidjson;
@@ -60,10 +78,119 @@ namespace quantum {
 struct IBMBackend {
 	std::string name;
 	std::string description;
-	int nQubits;
+	int nQubits = 0;
 	std::vector<std::pair<int,int>> couplers;
 	bool status = true;
 	bool isSimulator = true;
+	std::shared_ptr<IBMBackendTopology> topology;
+};
+
+/**
+ * What a batch of kernels would cost to run, compiled
+ * but not submitted with --ibm-dry-run.
+ */
+struct IBMDryRunReport {
+
+	struct Kernel {
+		std::string name;
+		IBMCircuitStatistics statistics;
+		std::vector<int> measuredQubits;
+
+		/**
+		 * Size of the OpenQasm of the circuit holding this kernel
+		 */
+		std::size_t qasmBytes;
+
+		/**
+		 * Estimated duration of one shot of the circuit
+		 * holding this kernel, in nanoseconds
+		 */
+		double circuitTime;
+	};
+
+	std::string backend;
+	int shots = 0;
+	int nCircuits = 0;
+
+	/**
+	 * Circuits identical to one already in the job, not submitted
+	 */
+	int nDuplicates = 0;
+
+	std::vector<Kernel> kernels;
+	std::size_t totalQasmBytes = 0;
+
+	/**
+	 * Estimated device time of the whole job, in nanoseconds
+	 */
+	double deviceTime = 0.0;
+
+	std::string toString() const {
+		std::stringstream ss;
+		ss << "IBM dry run on " << backend << ", " << kernels.size()
+				<< " kernels in " << nCircuits << " circuits, " << shots
+				<< " shots";
+		if (nDuplicates > 0) {
+			ss << ", " << nDuplicates << " duplicate circuits suppressed";
+		}
+		ss << "\n";
+		for (auto& k : kernels) {
+			ss << "  " << k.name << ": " << k.qasmBytes << " qasm bytes, "
+					<< k.statistics.toString() << ", measures ";
+			for (auto q : k.measuredQubits) {
+				ss << q << " ";
+			}
+			ss << "~" << k.circuitTime << " ns per shot\n";
+		}
+		ss << "  total: " << totalQasmBytes << " qasm bytes, ~"
+				<< deviceTime / 1e9 << " s of device time\n";
+		return ss.str();
+	}
+};
+
+/**
+ * The parameter shift gradient of a kernel's Z expectation value,
+ * with the expectation value of every circuit it was computed from.
+ */
+struct IBMGradient {
+
+	/**
+	 * A copy of the kernel with one rotation angle shifted by
+	 * +-pi/2, the rotation being the gate-th of the parameter
+	 */
+	struct Term {
+		int parameter;
+		int gate;
+		double shift;
+		double expectation;
+	};
+
+	/**
+	 * Expectation value of the unshifted kernel
+	 */
+	double expectation = 0.0;
+
+	std::vector<double> gradient;
+	std::vector<Term> terms;
+};
+
+/**
+ * A circuit submitted to IBM, serving one or more kernels.
+ */
+struct IBMCircuit {
+	std::shared_ptr<Function> function;
+
+	/**
+	 * The indices of the kernels this circuit serves
+	 */
+	std::vector<int> kernels;
+
+	/**
+	 * For each measurement of the circuit, in program order, the
+	 * kernels it is read by and the position of the measurement
+	 * among each of those kernels' measurements
+	 */
+	std::vector<std::vector<std::pair<int, int>>> measureOwners;
 };
 
 /**
@@ -101,15 +228,103 @@ public:
 	 */
 	virtual std::shared_ptr<AcceleratorBuffer> createBuffer(
 				const std::string& varId);
-//
-//	virtual std::vector<std::shared_ptr<AcceleratorBuffer>> execute(
-//			std::shared_ptr<AcceleratorBuffer> buffer,
-//			const std::vector<std::shared_ptr<Function>> functions);
-//
-//	virtual void execute(std::shared_ptr<AcceleratorBuffer> buffer,
-//				const std::shared_ptr<Function> function) {
-//		RemoteAccelerator::Exe
-//	}
+
+	/**
+	 * Execute the given kernels. With --ibm-dry-run they are
+	 * compiled but not submitted, and one buffer per kernel is
+	 * returned with its circuit statistics and no measurements.
+	 * With --ibm-shot-budget each kernel gets its own share of
+	 * the shots, with --ibm-target-error it is sampled until its
+	 * expectation value is precise enough.
+	 */
+	virtual std::vector<std::shared_ptr<AcceleratorBuffer>> execute(
+			std::shared_ptr<AcceleratorBuffer> buffer,
+			const std::vector<std::shared_ptr<Function>> functions);
+
+	/**
+	 * Execute the given kernel, or only compile it with --ibm-dry-run.
+	 * With --ibm-target-error it is sampled until its expectation
+	 * value is precise enough.
+	 */
+	virtual void execute(std::shared_ptr<AcceleratorBuffer> buffer,
+			const std::shared_ptr<Function> function);
+
+	/**
+	 * Execute every given kernel for each row of the given parameter
+	 * sets, binding the kernel parameters in order to the row values,
+	 * and return the buffer of each kernel for each row. All bound
+	 * kernels are submitted in one job, or in as few jobs as
+	 * --ibm-max-circuits-per-job allows. Each job is executed as
+	 * execute would, honoring --ibm-dry-run, --ibm-target-error
+	 * and --ibm-shot-budget.
+	 */
+	std::vector<std::vector<std::shared_ptr<AcceleratorBuffer>>> executeSweep(
+			std::shared_ptr<AcceleratorBuffer> buffer,
+			const std::vector<std::shared_ptr<Function>> kernels,
+			const std::vector<std::vector<double>>& parameterSets);
+
+	/**
+	 * Return the gradient of the Z expectation value of the given
+	 * kernel with its parameters bound to the given values. Every
+	 * Rx, Ry or Rz whose angle is a kernel parameter, or its
+	 * negation, is shifted by +-pi/2 in a copy of the kernel, once
+	 * per call of the composite it is in, and all copies are
+	 * submitted in one job with the unshifted kernel. Other gates
+	 * may not depend on the kernel parameters. With --ibm-dry-run
+	 * nothing is submitted and the gradient is left at zero.
+	 */
+	IBMGradient executeGradient(std::shared_ptr<AcceleratorBuffer> buffer,
+			std::shared_ptr<Function> kernel, const std::vector<double>& parameters);
+
+	/**
+	 * Run nCircuits copies of the given state preparation kernel,
+	 * each followed by a measurement of every buffer qubit in a
+	 * random X, Y or Z basis, in one job, and return the classical
+	 * shadow of the prepared state. Any number of Pauli expectation
+	 * values can then be estimated from it.
+	 */
+	std::shared_ptr<IBMClassicalShadow> executeShadow(
+			std::shared_ptr<AcceleratorBuffer> buffer,
+			std::shared_ptr<Function> kernel, const int nCircuits,
+			const int shotsPerCircuit = 1, const unsigned int seed = 0);
+
+	/**
+	 * Return the result cache used with --ibm-result-cache on
+	 * simulator backends, or null if results are not cached.
+	 */
+	std::shared_ptr<IBMResultCache> getResultCache();
+
+	/**
+	 * Return the kernels compiled from the given source for the
+	 * current backend and saved to --ibm-kernel-file, or no kernels
+	 * if there is no such file or it holds another source. The
+	 * kernels can be executed without compiling the source again.
+	 */
+	std::vector<std::shared_ptr<Function>> loadPrecompiledKernels(
+			const std::string& source);
+
+	/**
+	 * Save the given kernels, compiled from the given source with
+	 * the IRTransformations of this Accelerator, to --ibm-kernel-file.
+	 */
+	void savePrecompiledKernels(const std::string& source,
+			std::vector<std::shared_ptr<Function>> kernels);
+
+	/**
+	 * Return the report of the last --ibm-dry-run execution.
+	 */
+	const IBMDryRunReport& getDryRunReport() {
+		return dryRunReport;
+	}
+
+	/**
+	 * Return the number of kernels of the last job that reused
+	 * the OpenQasm of a GateFunction lowered for another kernel.
+	 */
+	int getNumberOfReusedPrefixes() {
+		return nReusedPrefixes;
+	}
+
 	/**
 	 * Initialize this Accelerator. This method is called
 	 * by the XACC framework after an Accelerator has been
@@ -162,12 +377,85 @@ public:
 				value<std::string>(),
 				"Provide the backend name.")
 				("ibm-shots", value<std::string>(), "Provide the number of shots to execute.")
+				("ibm-shot-budget", value<std::string>(), "Split this total number of shots "
+						"across the kernels of a batch to minimize the variance of their "
+						"weighted sum. Shot counts are rounded to powers of two times "
+						"--ibm-min-shots, and one job runs per distinct shot count.")
+				("ibm-shot-weights", value<std::string>(), "Comma separated weight of each "
+						"kernel for --ibm-shot-budget, eg Hamiltonian term coefficients. Default is 1.")
+				("ibm-shot-variances", value<std::string>(), "Comma separated variance of one "
+						"shot of each kernel for --ibm-shot-budget. Default is estimated from the "
+						"previous execution of each kernel, or 1.")
+				("ibm-min-shots", value<std::string>(), "Fewest shots given to any kernel "
+						"by --ibm-shot-budget. Default is 1.")
+				("ibm-max-circuits-per-job", value<std::string>(), "Most kernels submitted in "
+						"one job by a parameter sweep. Default is no limit.")
+				("ibm-target-error", value<std::string>(), "Submit kernels in chunks of shots "
+						"until the standard error of each expectation value is below this value. "
+						"Can not be used with --ibm-correct-assignment-errors.")
+				("ibm-chunk-shots", value<std::string>(), "Shots per chunk with --ibm-target-error. "
+						"Default is 256.")
+				("ibm-max-shots", value<std::string>(), "Most shots given to a kernel with "
+						"--ibm-target-error. Default is 8192.")
 				("ibm-list-backends", "List the available backends at the IBM Quantum Experience URL.")
 				("ibm-api-url", "")("ibm-write-openqasm", "")
+				("ibm-compress-payloads", "Gzip encode large job POST bodies and accept "
+						"gzip or deflate encoded responses.")
+				("ibm-compression-threshold", value<std::string>(), "Smallest POST body, in bytes, "
+						"that is compressed with --ibm-compress-payloads. Default is 1024.")
+				("ibm-no-qubit-placement", "Keep logical qubit i on physical qubit i "
+						"instead of choosing a layout from the backend couplers.")
+				("ibm-no-gate-fusion", "Emit every single qubit gate on its own "
+						"instead of fusing runs of them into one u1, u2 or u3.")
+				("ibm-fusion-tolerance", value<std::string>(), "Angle tolerance below which "
+						"fused rotations are treated as the identity, u1 or u2. Default is 1e-10.")
+				("ibm-schedule", value<std::string>(), "Reorder commuting gates to layer "
+						"instructions asap or alap, or none. Default is none.")
+				("ibm-no-gate-cancellation", "Do not cancel adjacent inverse gates "
+						"or merge rotations after mapping to the backend.")
+				("ibm-no-qubit-routing", "Do not insert SWAPs for two qubit gates "
+						"on uncoupled qubits.")
+				("ibm-no-light-cone-pruning", "Submit every gate, including those "
+						"that cannot affect any measured qubit.")
+				("ibm-dry-run", "Compile and report the size and estimated device "
+						"time of each kernel, without submitting the job.")
+				("ibm-gate-durations", value<std::string>(), "Override the backend gate "
+						"durations used by --ibm-dry-run, as u=ns,cx=ns,measure=ns,repetition=ns.")
+				("ibm-pack-kernels", "On physical backends, run narrow kernels side by "
+						"side on disjoint qubits of one circuit.")
+				("ibm-result-cache", value<std::string>(), "Cache simulator results in this "
+						"directory, keyed by circuit, shots and backend, and serve repeated "
+						"circuits from it without submitting them.")
+				("ibm-result-cache-size", value<std::string>(), "Most megabytes kept by "
+						"--ibm-result-cache. Default is 64.")
+				("ibm-result-cache-age", value<std::string>(), "Hours a --ibm-result-cache "
+						"entry is kept. Default is 168.")
+				("ibm-result-cache-bypass", "Submit every circuit, refreshing "
+						"--ibm-result-cache with the new results.")
+				("ibm-kernel-file", value<std::string>(), "Save kernels compiled for the "
+						"backend to this file, and load them from it instead of compiling "
+						"the same source again for the same backend and passes.")
+				("ibm-no-circuit-deduplication", "Submit every circuit, even those identical "
+						"to another circuit of the same job.")
+				("ibm-no-measurement-grouping", "Submit one circuit per kernel, even for "
+						"kernels that share a state preparation and measure in "
+						"qubit-wise commuting bases.")
+				("ibm-no-qubit-compaction", "Declare every buffer qubit on simulator backends, "
+						"instead of only the qubits a kernel touches.")
+				("ibm-compact-openqasm", "Emit register broadcasts and a single merged "
+						"creg, and drop id gates, to shrink the OpenQasm payload.")
 				("ibm-correct-assignment-errors", "Indicate that we should run kernels first that compute "
 						"assignment error, and then correct for "
 						"that in computing expectation values.")
-						("ibm-assignment-error-shots", value<std::string>(), "");
+				("ibm-assignment-error-shots", value<std::string>(), "Run the assignment error "
+						"kernels as their own job of this many shots, instead of "
+						"with the first job.")
+				("ibm-readout-mitigation-distance", value<std::string>(), "Correct assignment "
+						"errors, keeping their correlations, over the observed outcomes and "
+						"those within this Hamming distance of each other. Used with distance "
+						"2 for more than 16 measured qubits.")
+				("ibm-assignment-error-ttl", value<std::string>(), "Minutes the assignment errors "
+						"of a backend are reused before they are measured again. Default is 60.");
 		return desc;
 	}
 
@@ -239,9 +527,65 @@ public:
 
 private:
 
-	void computeMeasurementAccuracy(std::shared_ptr<AcceleratorBuffer> buffer);
+	/**
+	 * Measure the assignment errors of the given qubits of the
+	 * current backend in a job of --ibm-assignment-error-shots.
+	 */
+	void computeMeasurementAccuracy(std::shared_ptr<AcceleratorBuffer> buffer,
+			const std::set<int>& qubits);
+
+	/**
+	 * Return the kernels preparing every given qubit in 0, and
+	 * in 1, and measuring them, in that order.
+	 */
+	std::vector<std::shared_ptr<Function>> readoutCalibrationKernels(
+			const std::set<int>& qubits);
 
-	bool computedMeasurementAccuracy = false;
+	/**
+	 * Correct the expectation value of the given buffer for the
+	 * assignment errors of the current backend on the physical
+	 * qubits measured by the given kernel of the current job.
+	 */
+	void attachReadoutCalibration(std::shared_ptr<AcceleratorBuffer> buffer,
+			const int kernelIdx);
+
+	/**
+	 * Compile the given kernels, post them and decode their
+	 * results, serving cached circuits from the result cache.
+	 */
+	std::vector<std::shared_ptr<AcceleratorBuffer>> postJob(
+			std::shared_ptr<AcceleratorBuffer> buffer,
+			const std::vector<std::shared_ptr<Function>> functions);
+
+	/**
+	 * Assignment errors of each backend, and the number of
+	 * readout calibration kernels ending the current job.
+	 */
+	std::map<std::string, std::shared_ptr<IBMReadoutCalibration>> readoutCalibrations;
+	int nCalibrationKernels = 0;
+
+	/**
+	 * Return true if the given kernel instruction is a
+	 * GateFunction whose lowered OpenQasm can be shared
+	 * by every kernel that calls it, ie it contains no
+	 * measurements or conditional branches.
+	 */
+	bool isSharablePrefix(std::shared_ptr<Instruction> inst);
+
+	/**
+	 * Return the qubits acted on by the enabled
+	 * instructions of the given kernel.
+	 */
+	std::set<int> getActiveQubits(std::shared_ptr<Function> kernel);
+
+	/**
+	 * Map a result bit string returned by IBM to a measurement
+	 * over the nBits buffer qubits, using the given readout pairs
+	 * of (classical bit, buffer qubit). Classical bit 0 is the
+	 * right most character of the bit string.
+	 */
+	boost::dynamic_bitset<> decodeOutcome(std::string bitStr,
+			const std::vector<std::pair<int, int>>& readout, const int nBits);
 
 	/**
 	 * Private utility to search for the IBM
@@ -273,10 +617,193 @@ private:
 	 */
 	std::map<std::string, IBMBackend> availableBackends;
 
+	/**
+	 * For each kernel in the current job, the buffer qubit read by
+	 * each of its measurements, and the physical qubit it was read on.
+	 */
 	std::map<int, std::vector<int>> measurementSupports;
+	std::map<int, std::vector<int>> physicalSupports;
+
+	/**
+	 * For each kernel in the current job, the
+	 * (classical bit, buffer qubit) pairs used
+	 * to decode its result bit strings.
+	 */
+	std::map<int, std::vector<std::pair<int, int>>> kernelReadouts;
+
+	/**
+	 * For each kernel in the current job, its name, the statistics
+	 * of the circuit that was submitted and of the passes that built it.
+	 */
+	std::map<int, std::string> kernelNames;
+	std::map<int, IBMCircuitStatistics> kernelStatistics;
+	std::map<int, std::vector<IBMPassStatistics>> kernelPassStatistics;
+
+	/**
+	 * For each kernel in the current job, the index
+	 * of the submitted circuit that contains it.
+	 */
+	std::map<int, int> kernelCircuits;
+
+	/**
+	 * The shots and gate durations of the current job, and the
+	 * OpenQasm size and estimated duration of one shot of each
+	 * of its circuits, as lowered after gate fusion.
+	 */
+	int jobShots = 0;
+	IBMGateDurations jobDurations;
+	std::map<int, std::size_t> circuitQasmBytes;
+	std::map<int, double> circuitTimes;
+
+	/**
+	 * The circuits of the current job that were
+	 * identical to one already submitted
+	 */
+	int nDuplicateCircuits = 0;
+
+	/**
+	 * The shared GateFunction calls of the last job that
+	 * reused OpenQasm lowered for an earlier kernel
+	 */
+	int nReusedPrefixes = 0;
+
+	IBMDryRunReport dryRunReport;
+
+	/**
+	 * The shots of the next job when --ibm-shot-budget splits
+	 * a batch into jobs by shot count, 0 to use --ibm-shots,
+	 * and the index in the batch of each kernel of that job.
+	 */
+	int allocatedShots = 0;
+	std::vector<int> jobKernelIds;
+
+	/**
+	 * False to submit every kernel as its own circuit, neither
+	 * grouped nor deduplicated, eg for repeated kernels whose
+	 * results must be independent.
+	 */
+	bool groupMeasurements = true;
+
+	/**
+	 * Kernel name to the expectation value and shots of its last
+	 * execution with --ibm-shot-budget, to estimate its variance.
+	 */
+	std::map<std::string, std::pair<double, int>> lastExpectations;
+
+	/**
+	 * Return the shots of each of the given kernels, splitting
+	 * --ibm-shot-budget by the kernel weights and variances, and
+	 * rounding to power of two levels so few jobs are needed.
+	 */
+	std::vector<int> allocateShots(
+			const std::vector<std::shared_ptr<Function>> functions);
+
+	/**
+	 * Execute the given kernels with the shots allocated
+	 * to them, one job per distinct shot count.
+	 */
+	std::vector<std::shared_ptr<AcceleratorBuffer>> executeAllocated(
+			std::shared_ptr<AcceleratorBuffer> buffer,
+			const std::vector<std::shared_ptr<Function>> functions);
+
+	/**
+	 * Execute the given kernels in chunks of shots, merging each
+	 * chunk into their buffers, until the standard error of every
+	 * expectation value is below --ibm-target-error or a kernel
+	 * reaches --ibm-max-shots. The next chunk is submitted before
+	 * waiting on the current one, so the device queue is never empty.
+	 * Fails with --ibm-correct-assignment-errors, as chunks are posted
+	 * without readout calibration.
+	 */
+	std::vector<std::shared_ptr<AcceleratorBuffer>> executeAdaptive(
+			std::shared_ptr<AcceleratorBuffer> buffer,
+			const std::vector<std::shared_ptr<Function>> functions);
+
+	/**
+	 * Compile the given kernels, submit them and return their
+	 * buffers as RemoteAccelerator::execute does. With a result
+	 * cache, only the circuits it does not hold are submitted.
+	 * With --ibm-correct-assignment-errors, the readout of the
+	 * backend is calibrated with the job when it is due.
+	 */
+	std::vector<std::shared_ptr<AcceleratorBuffer>> submitJob(
+			std::shared_ptr<AcceleratorBuffer> buffer,
+			const std::vector<std::shared_ptr<Function>> functions);
+
+	/**
+	 * Decode the counts of the given completed job document
+	 * into the buffers of the kernels of the current job.
+	 * Every outcome spans the buffer, bit i holding buffer
+	 * qubit i, whether the job ran one kernel or many.
+	 */
+	std::vector<std::shared_ptr<AcceleratorBuffer>> processResults(
+			std::shared_ptr<AcceleratorBuffer> buffer, const std::string& results);
+
+	std::shared_ptr<IBMResultCache> resultCache;
+
+	/**
+	 * Poll the job created by the given POST response
+	 * until it completes and return its final document.
+	 */
+	std::string waitForJob(const std::string& response);
+
+	/**
+	 * Append the given result counts to the given buffer, decoded
+	 * with the given readout, and return the number of shots.
+	 */
+	int appendCounts(std::shared_ptr<AcceleratorBuffer> buffer,
+			const Value& counts, const std::vector<std::pair<int, int>>& readout);
+
+	/**
+	 * Build the dry run report of the job
+	 * compiled by the last processInput.
+	 */
+	IBMDryRunReport createDryRunReport();
+
+	/**
+	 * Forget the bookkeeping of the current job.
+	 */
+	void clearJobState();
+
+	/**
+	 * Return the --ibm-kernel-file hash of the given source, for the
+	 * current backend, kernel file format and the options that
+	 * select our IRTransformations.
+	 */
+	std::uint64_t kernelFileHash(const std::string& source);
+
+	/**
+	 * Merge the kernels that share a state preparation prefix and
+	 * measure in qubit-wise commuting bases into one circuit, with
+	 * a single measurement per qubit read by all of them. The given
+	 * kernels are used for the circuits that serve one kernel.
+	 */
+	std::vector<IBMCircuit> groupCommutingKernels(
+			const std::vector<std::shared_ptr<Function>> functions,
+			std::vector<std::shared_ptr<Function>> kernels);
+
+	/**
+	 * Group the given circuits into the circuits to submit. With
+	 * --ibm-pack-kernels on physical backends, narrow circuits are
+	 * moved onto free qubits and share a circuit.
+	 */
+	std::vector<IBMCircuit> packKernels(std::vector<IBMCircuit> circuits);
+
+	/**
+	 * Attach the circuit statistics of the given
+	 * kernel of the current job to the given buffer.
+	 */
+	void attachStatistics(std::shared_ptr<AcceleratorBuffer> buffer,
+			const int kernelIdx);
 
 	IBMBackend chosenBackend;
 
+	/**
+	 * Qubit layouts recorded by our IR transformations
+	 */
+	std::shared_ptr<IBMCompilationContext> compilationContext =
+			std::make_shared<IBMCompilationContext>();
+
 };
 
 }
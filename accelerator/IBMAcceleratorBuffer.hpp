@@ -10,11 +10,60 @@
 
 
 #include "AcceleratorBuffer.hpp"
+#include "IBMCompilationContext.hpp"
+#include "IBMReadoutMitigator.hpp"
+#include <algorithm>
 
 namespace xacc {
 namespace quantum {
 class IBMAcceleratorBuffer: public xacc::AcceleratorBuffer {
 
+protected:
+
+	/**
+	 * Statistics of the circuit that produced these
+	 * results, and of each transformation that built it.
+	 */
+	IBMCircuitStatistics circuitStatistics;
+	std::vector<IBMPassStatistics> passStatistics;
+
+	/**
+	 * Readout calibration used to correct the expectation
+	 * value over the measured qubits, if any, and the
+	 * calibrated physical qubit each of them was read on.
+	 */
+	std::shared_ptr<IBMReadoutCalibration> readoutCalibration;
+	std::vector<int> measuredQubits;
+	std::vector<int> physicalQubits;
+
+	/**
+	 * The last parsed --ibm-rescale-expectation-values
+	 */
+	std::string rescaleData;
+	double pPlus = 0.0;
+	double pMinus = 0.0;
+
+	/**
+	 * Return true if readout errors should be corrected over the
+	 * observed outcomes with the IBMReadoutMitigator, rather than
+	 * over every outcome with the tensor product inverse, ie with
+	 * --ibm-readout-mitigation-distance or when there are too many
+	 * measured qubits to list every outcome.
+	 */
+	bool useReadoutMitigator() {
+		return xacc::optionExists("ibm-readout-mitigation-distance")
+				|| measuredQubits.size() > 16;
+	}
+
+	IBMReadoutMitigator createReadoutMitigator() {
+		int distance = 2;
+		if (xacc::optionExists("ibm-readout-mitigation-distance")) {
+			distance = std::stoi(
+					xacc::getOption("ibm-readout-mitigation-distance"));
+		}
+		return IBMReadoutMitigator(readoutCalibration, distance);
+	}
+
 public:
 	/**
 	 * The Constructor
@@ -43,6 +92,13 @@ public:
 	 * @param stream Stream to write the buffer to.
 	 */
 	virtual void print(std::ostream& stream) {
+		if (circuitStatistics.nGates > 0) {
+			stream << "circuit: " << circuitStatistics.toString() << "\n";
+		}
+		for (auto& p : passStatistics) {
+			stream << "pass " << p.pass << ": " << p.before.toString() << " -> "
+					<< p.after.toString() << "\n";
+		}
 		stream << "expectation: " << getExpectationValueZ() << "\n";
 		for (auto& kv : bitStringToCounts) {
 			stream << "measure result: " << kv.first << ", " << kv.second << "\n";
@@ -50,6 +106,87 @@ public:
 		return;
 	}
 
+	void setCircuitStatistics(const IBMCircuitStatistics& circuit,
+			const std::vector<IBMPassStatistics>& passes) {
+		circuitStatistics = circuit;
+		passStatistics = passes;
+	}
+
+	const IBMCircuitStatistics& getCircuitStatistics() {
+		return circuitStatistics;
+	}
+
+	const std::vector<IBMPassStatistics>& getPassStatistics() {
+		return passStatistics;
+	}
+
+	/**
+	 * Correct the expectation value of this buffer for the readout
+	 * errors of the given calibration on the given measured qubits,
+	 * qubits[i] being read on the calibrated qubit physical[i].
+	 */
+	void setReadoutCalibration(
+			std::shared_ptr<IBMReadoutCalibration> calibration,
+			const std::vector<int>& qubits, const std::vector<int>& physical) {
+		std::vector<std::pair<int, int>> readouts;
+		for (int i = 0; i < qubits.size() && i < physical.size(); i++) {
+			readouts.push_back(std::make_pair(qubits[i], physical[i]));
+		}
+		std::sort(readouts.begin(), readouts.end());
+
+		readoutCalibration = calibration;
+		measuredQubits.clear();
+		physicalQubits.clear();
+		for (auto& r : readouts) {
+			measuredQubits.push_back(r.first);
+			physicalQubits.push_back(r.second);
+		}
+	}
+
+	std::shared_ptr<IBMReadoutCalibration> getReadoutCalibration() {
+		return readoutCalibration;
+	}
+
+	/**
+	 * Return the readout corrected quasi-probabilities of the outcomes
+	 * of the measured qubits, keyed by bit strings of the measured
+	 * qubits in increasing order, the first one right most.
+	 */
+	std::map<std::string, double> getQuasiProbabilities() {
+		std::map<std::string, double> quasi;
+		if (!readoutCalibration) {
+			return quasi;
+		}
+		if (useReadoutMitigator()) {
+			return createReadoutMitigator().quasiProbabilities(bitStringToCounts,
+					measuredQubits, physicalQubits);
+		}
+
+		auto probabilities = readoutCalibration->correct(bitStringToCounts,
+				measuredQubits, physicalQubits);
+		for (std::size_t i = 0; i < probabilities.size(); i++) {
+			std::string bitStr(measuredQubits.size(), '0');
+			for (int j = 0; j < measuredQubits.size(); j++) {
+				if (i & (std::size_t(1) << j)) {
+					bitStr[measuredQubits.size() - 1 - j] = '1';
+				}
+			}
+			quasi[bitStr] = probabilities[i];
+		}
+		return quasi;
+	}
+
+	/**
+	 * Return the number of measurements appended to this buffer.
+	 */
+	int getNumberOfShots() {
+		int nShots = 0;
+		for (auto& kv : bitStringToCounts) {
+			nShots += kv.second;
+		}
+		return nShots;
+	}
+
 	/**
 	 * Compute and return the expectation value with respect
 	 * to the Pauli-Z operator. Here we provide a base implementation
@@ -60,30 +197,31 @@ public:
 	 * @return expVal The expectation value
 	 */
 	virtual const double getExpectationValueZ() {
+		if (readoutCalibration) {
+			if (useReadoutMitigator()) {
+				return createReadoutMitigator().expectationZ(bitStringToCounts,
+						measuredQubits, physicalQubits);
+			}
+			return readoutCalibration->expectationZ(bitStringToCounts,
+					measuredQubits, physicalQubits);
+		}
+
 		auto val = AcceleratorBuffer::getExpectationValueZ();
 
 		if (xacc::optionExists("ibm-rescale-expectation-values")) {
 			auto data = xacc::getOption("ibm-rescale-expectation-values");
-
-			xacc::info("Current Expectation Value: " + std::to_string(val));
-			xacc::info("Computing Rescaled Exp Val: " + data);
-			std::vector<std::string> split;
-			boost::split(split, data, boost::is_any_of(","));
-			auto p01 = std::stod(split[0]);
-			auto p10 = std::stod(split[1]);
-
-			xacc::info("Probs: " + split[0] + ", " + split[1]);
-
-			double pPlus = p01 + p10;
-			double pMinus = p01 - p10;
-
-			xacc::info("P+-: " + std::to_string(pPlus) + ", " + std::to_string(pMinus));
-
-//			val = (val + pPlus) / (1.0-pMinus);
+			if (data != rescaleData) {
+				xacc::info("Computing Rescaled Exp Val: " + data);
+				std::vector<std::string> split;
+				boost::split(split, data, boost::is_any_of(","));
+				auto p01 = std::stod(split[0]);
+				auto p10 = std::stod(split[1]);
+				pPlus = p01 + p10;
+				pMinus = p01 - p10;
+				rescaleData = data;
+			}
 
 			val = (val - pMinus) / (1.0 - pPlus);
-
-			xacc::info("New Expectation Value: " + std::to_string(val));
 		}
 
 		return val;
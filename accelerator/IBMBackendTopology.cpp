@@ -0,0 +1,89 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#include "IBMBackendTopology.hpp"
+#include "IBMKernelUtils.hpp"
+
+namespace xacc {
+namespace quantum {
+
+IBMBackendTopology::IBMBackendTopology(
+		const std::vector<std::pair<int, int>>& backendCouplers,
+		const int nBackendQubits) :
+		nQubits(nBackendQubits), complete(backendCouplers.empty()), couplers(
+				backendCouplers) {
+
+	if (complete) {
+		return;
+	}
+
+	for (auto c : couplers) {
+		nQubits = std::max(nQubits, std::max(c.first, c.second) + 1);
+	}
+
+	adjacency.assign(nQubits, boost::dynamic_bitset<>(nQubits));
+	directedCouplers.resize(nQubits * nQubits);
+	for (auto c : couplers) {
+		adjacency[c.first][c.second] = true;
+		adjacency[c.second][c.first] = true;
+		directedCouplers[c.first * nQubits + c.second] = true;
+	}
+
+	distances = allPairsDistances(couplers, nQubits);
+}
+
+boost::dynamic_bitset<> IBMBackendTopology::neighbors(const int qubit) const {
+	if (complete) {
+		boost::dynamic_bitset<> all(nQubits);
+		all.set();
+		all[qubit] = false;
+		return all;
+	}
+	return adjacency[qubit];
+}
+
+std::shared_ptr<AcceleratorGraph> IBMBackendTopology::getGraph() const {
+	auto graph = std::make_shared<AcceleratorGraph>(nQubits);
+	if (complete) {
+		for (int i = 0; i < nQubits; i++) {
+			for (int j = i + 1; j < nQubits; j++) {
+				graph->addEdge(i, j);
+			}
+		}
+	} else {
+		for (auto c : couplers) {
+			graph->addEdge(c.first, c.second);
+		}
+	}
+	return graph;
+}
+
+}
+}
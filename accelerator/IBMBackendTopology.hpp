@@ -0,0 +1,142 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#ifndef ACCELERATOR_IBMBACKENDTOPOLOGY_HPP_
+#define ACCELERATOR_IBMBACKENDTOPOLOGY_HPP_
+
+#include "Accelerator.hpp"
+#include <boost/dynamic_bitset.hpp>
+
+namespace xacc {
+namespace quantum {
+
+/**
+ * The IBMBackendTopology is the immutable connectivity model of
+ * an IBM backend, built once when the backend list is fetched and
+ * shared by the IBMAccelerator and its IR transformations.
+ *
+ * Physical backends hold undirected adjacency bitsets, a directed
+ * coupler lookup and the all pairs shortest path matrix of their
+ * coupling map. Simulators, which have no coupling map, are an
+ * implicit complete graph that stores none of these.
+ */
+class IBMBackendTopology {
+
+protected:
+
+	int nQubits = 0;
+
+	bool complete;
+
+	std::vector<std::pair<int, int>> couplers;
+
+	/**
+	 * Undirected neighbors of each qubit
+	 */
+	std::vector<boost::dynamic_bitset<>> adjacency;
+
+	/**
+	 * Row-major, bit src * nQubits + tgt is set
+	 * if the src -> tgt coupler exists
+	 */
+	boost::dynamic_bitset<> directedCouplers;
+
+	/**
+	 * Row-major all pairs shortest path lengths
+	 */
+	std::vector<int> distances;
+
+public:
+
+	/**
+	 * Build the topology of the given directed couplers, on at
+	 * least the given number of qubits. With no couplers the
+	 * topology is the complete graph on nQubits qubits.
+	 */
+	IBMBackendTopology(const std::vector<std::pair<int, int>>& couplers,
+			const int nQubits = 0);
+
+	int size() const {
+		return nQubits;
+	}
+
+	bool isComplete() const {
+		return complete;
+	}
+
+	const std::vector<std::pair<int, int>>& getCouplers() const {
+		return couplers;
+	}
+
+	/**
+	 * Return true if the src -> tgt coupler exists.
+	 */
+	bool isCoupled(const int src, const int tgt) const {
+		if (src < 0 || tgt < 0 || src >= nQubits || tgt >= nQubits) {
+			return false;
+		}
+		return complete ? src != tgt : directedCouplers[src * nQubits + tgt];
+	}
+
+	/**
+	 * Return true if a coupler exists between a and b, in either direction.
+	 */
+	bool isAdjacent(const int a, const int b) const {
+		return isCoupled(a, b) || isCoupled(b, a);
+	}
+
+	/**
+	 * Return the undirected neighbors of the given qubit.
+	 */
+	boost::dynamic_bitset<> neighbors(const int qubit) const;
+
+	/**
+	 * Return the number of couplers on the
+	 * shortest path between a and b.
+	 */
+	int distance(const int a, const int b) const {
+		if (complete) {
+			return a == b ? 0 : 1;
+		}
+		return distances[a * nQubits + b];
+	}
+
+	/**
+	 * Return a new AcceleratorGraph of this topology. Each call
+	 * builds its own graph, so callers may modify it without
+	 * changing the topology shared by everyone else.
+	 */
+	std::shared_ptr<AcceleratorGraph> getGraph() const;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,154 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#include "IBMClassicalShadow.hpp"
+#include "XACC.hpp"
+#include <algorithm>
+#include <bitset>
+#include <cctype>
+#include <cmath>
+#include <random>
+
+namespace xacc {
+namespace quantum {
+
+IBMClassicalShadow::IBMClassicalShadow(const int n) :
+		nQubits(n) {
+	if (nQubits > 64) {
+		xacc::error("IBMClassicalShadow supports at most 64 qubits, got "
+				+ std::to_string(nQubits) + ".");
+	}
+}
+
+void IBMClassicalShadow::addSnapshots(const std::string& bases,
+		const boost::dynamic_bitset<>& outcome, const int count) {
+	std::uint64_t x = 0, y = 0, s = 0;
+	for (int q = 0; q < nQubits && q < bases.size(); q++) {
+		auto bit = std::uint64_t(1) << q;
+		if (bases[q] == 'x') {
+			x |= bit;
+		} else if (bases[q] == 'y') {
+			y |= bit;
+		}
+		if (q < outcome.size() && outcome[q]) {
+			s |= bit;
+		}
+	}
+	xBases.insert(xBases.end(), count, x);
+	yBases.insert(yBases.end(), count, y);
+	outcomes.insert(outcomes.end(), count, s);
+}
+
+double IBMClassicalShadow::mean(const std::uint64_t x, const std::uint64_t y,
+		const std::uint64_t z, const std::size_t first,
+		const std::size_t stride) const {
+	auto support = x | y | z;
+	long sum = 0;
+	std::size_t n = 0;
+	for (std::size_t i = first; i < outcomes.size(); i += stride, n++) {
+		auto mismatch = (x & ~xBases[i]) | (y & ~yBases[i])
+				| (z & (xBases[i] | yBases[i]));
+		auto parity = std::bitset<64>(outcomes[i] & support).count() & 1;
+		sum += (mismatch == 0) * (1 - 2 * (long) parity);
+	}
+	auto scale = std::pow(3.0, std::bitset<64>(support).count());
+	return n > 0 ? scale * sum / n : 0.0;
+}
+
+double IBMClassicalShadow::expectation(const std::string& pauli,
+		const int nGroups) const {
+
+	// Parse eg "X0 Z2" into bitmasks
+	std::uint64_t x = 0, y = 0, z = 0;
+	for (int i = 0; i < pauli.size(); i++) {
+		auto op = std::toupper(pauli[i]);
+		if (op != 'X' && op != 'Y' && op != 'Z') {
+			continue;
+		}
+		int j = i + 1;
+		while (j < pauli.size() && std::isdigit(pauli[j])) {
+			j++;
+		}
+		if (j == i + 1) {
+			xacc::error("Invalid Pauli " + pauli + ", expected eg X0 Z2.");
+		}
+		auto q = std::stoi(pauli.substr(i + 1, j - i - 1));
+		if (q >= nQubits) {
+			xacc::error("Invalid Pauli " + pauli + ", qubit "
+					+ std::to_string(q) + " is not in the shadow.");
+		}
+		auto bit = std::uint64_t(1) << q;
+		(op == 'X' ? x : op == 'Y' ? y : z) |= bit;
+		i = j - 1;
+	}
+
+	if ((x | y | z) == 0) {
+		return 1.0;
+	}
+
+	// Median of means of interleaved groups, so that every group
+	// draws on every circuit rather than on a few whole bases
+	int groups = std::max(1, std::min(nGroups, size()));
+	std::vector<double> means;
+	for (int g = 0; g < groups; g++) {
+		means.push_back(mean(x, y, z, g, groups));
+	}
+	std::sort(means.begin(), means.end());
+	auto middle = means.size() / 2;
+	return means.size() % 2 ?
+			means[middle] : (means[middle - 1] + means[middle]) / 2.0;
+}
+
+std::vector<double> IBMClassicalShadow::expectations(
+		const std::vector<std::string>& paulis, const int nGroups) const {
+	std::vector<double> values;
+	for (auto& p : paulis) {
+		values.push_back(expectation(p, nGroups));
+	}
+	return values;
+}
+
+std::vector<std::string> IBMClassicalShadow::randomBases(const int nQubits,
+		const int nBases, const unsigned int seed) {
+	std::mt19937 generator(seed);
+	std::uniform_int_distribution<int> basis(0, 2);
+	std::vector<std::string> bases;
+	for (int b = 0; b < nBases; b++) {
+		std::string qubitBases;
+		for (int q = 0; q < nQubits; q++) {
+			qubitBases += "xyz"[basis(generator)];
+		}
+		bases.push_back(qubitBases);
+	}
+	return bases;
+}
+
+}
+}
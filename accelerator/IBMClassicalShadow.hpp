@@ -0,0 +1,124 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#ifndef ACCELERATOR_IBMCLASSICALSHADOW_HPP_
+#define ACCELERATOR_IBMCLASSICALSHADOW_HPP_
+
+#include <boost/dynamic_bitset.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace xacc {
+namespace quantum {
+
+/**
+ * The IBMClassicalShadow is a classical shadow of a quantum state, the
+ * outcomes of measuring each qubit in a uniformly random X, Y or Z
+ * basis, from which the expectation value of any Pauli observable can
+ * be estimated without running more circuits.
+ *
+ * A snapshot measured in basis b with outcome s estimates the Pauli P
+ * of support S as 3^|S| (-1)^(parity of s on S) if b agrees with P on
+ * S, and 0 otherwise. Estimates are the median of the means of groups
+ * of snapshots. Groups take every nGroups-th snapshot, as the shots of
+ * one circuit arrive together and share a single basis.
+ *
+ * Snapshots are stored as three bitmasks, so that an estimate is a
+ * branch free loop over flat arrays. Up to 64 qubits are supported.
+ */
+class IBMClassicalShadow {
+
+protected:
+
+	int nQubits;
+
+	/**
+	 * For each snapshot, the qubits measured in the X and Y
+	 * bases, the rest are measured in Z, and the qubits that
+	 * were measured as 1
+	 */
+	std::vector<std::uint64_t> xBases;
+	std::vector<std::uint64_t> yBases;
+	std::vector<std::uint64_t> outcomes;
+
+	/**
+	 * Return the mean estimate of the given Pauli over
+	 * snapshots first, first + stride, first + 2 stride...
+	 */
+	double mean(const std::uint64_t x, const std::uint64_t y,
+			const std::uint64_t z, const std::size_t first,
+			const std::size_t stride) const;
+
+public:
+
+	IBMClassicalShadow(const int nQubits);
+
+	int size() const {
+		return outcomes.size();
+	}
+
+	int getNumberOfQubits() const {
+		return nQubits;
+	}
+
+	/**
+	 * Add count snapshots of the given outcome, measured in the
+	 * given bases, one of 'x', 'y' or 'z' per qubit.
+	 */
+	void addSnapshots(const std::string& bases,
+			const boost::dynamic_bitset<>& outcome, const int count = 1);
+
+	/**
+	 * Return the estimated expectation value of the given Pauli,
+	 * written as a product of X, Y or Z and a qubit index, eg
+	 * "X0 Z2", from the median of the means of nGroups groups of
+	 * snapshots. The identity is "" or "I".
+	 */
+	double expectation(const std::string& pauli, const int nGroups = 10) const;
+
+	/**
+	 * Return the estimated expectation value of each given Pauli.
+	 */
+	std::vector<double> expectations(const std::vector<std::string>& paulis,
+			const int nGroups = 10) const;
+
+	/**
+	 * Return nBases uniformly random measurement bases, one of
+	 * 'x', 'y' or 'z' per qubit, drawn from the given seed.
+	 */
+	static std::vector<std::string> randomBases(const int nQubits,
+			const int nBases, const unsigned int seed);
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,228 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#ifndef ACCELERATOR_IBMCOMPILATIONCONTEXT_HPP_
+#define ACCELERATOR_IBMCOMPILATIONCONTEXT_HPP_
+
+#include "Function.hpp"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace xacc {
+namespace quantum {
+
+/**
+ * Size of a compiled kernel: its gate count, two qubit
+ * gate count and depth in layers of gates.
+ */
+struct IBMCircuitStatistics {
+	int nGates = 0;
+	int nTwoQubitGates = 0;
+	int depth = 0;
+
+	std::string toString() const {
+		return std::to_string(nGates) + " gates, "
+				+ std::to_string(nTwoQubitGates) + " two qubit, depth "
+				+ std::to_string(depth);
+	}
+};
+
+/**
+ * The statistics of a kernel before and after a transformation.
+ */
+struct IBMPassStatistics {
+	std::string pass;
+	IBMCircuitStatistics before;
+	IBMCircuitStatistics after;
+};
+
+/**
+ * The IBMCompilationContext is shared by the IBMAccelerator and
+ * the IR transformations it hands out. Transformations that move
+ * logical qubits onto other physical qubits record, per kernel,
+ * which logical qubit each measurement reads and where the
+ * logical qubits end up, so that results can be decoded back
+ * onto the logical qubits of the AcceleratorBuffer.
+ *
+ * Kernels are identified by object, not by name, so kernels
+ * sharing a name do not collide. A transformation that replaces
+ * a kernel hands its records on to the new kernel with inherit.
+ */
+class IBMCompilationContext {
+
+protected:
+
+	template<typename T>
+	using KernelMap = std::map<std::weak_ptr<Function>, T,
+			std::owner_less<std::weak_ptr<Function>>>;
+
+	std::mutex contextMutex;
+
+	/**
+	 * Kernel to logical to physical qubit layout
+	 */
+	KernelMap<std::vector<int>> layouts;
+
+	/**
+	 * Kernel to the logical qubit read by each
+	 * measurement, in program order
+	 */
+	KernelMap<std::vector<int>> measuredLogicalQubits;
+
+	/**
+	 * Kernel to the statistics of each
+	 * transformation run on it, in order
+	 */
+	KernelMap<std::vector<IBMPassStatistics>> passStatistics;
+
+	/**
+	 * Drop the records of kernels that no longer exist.
+	 */
+	template<typename T>
+	static void purge(KernelMap<T>& records) {
+		for (auto it = records.begin(); it != records.end();) {
+			it = it->first.expired() ? records.erase(it) : std::next(it);
+		}
+	}
+
+	template<typename T>
+	static T find(KernelMap<T>& records,
+			const std::shared_ptr<Function>& kernel) {
+		auto it = records.find(kernel);
+		return it == records.end() ? T { } : it->second;
+	}
+
+public:
+
+	/**
+	 * Hand the records of the kernel from on to the kernel to
+	 * that replaces it, unless to already has its own.
+	 */
+	void inherit(const std::shared_ptr<Function>& from,
+			const std::shared_ptr<Function>& to) {
+		std::lock_guard<std::mutex> lock(contextMutex);
+		if (from == to) {
+			return;
+		}
+		purge(layouts);
+		purge(measuredLogicalQubits);
+		purge(passStatistics);
+		auto layout = layouts.find(from);
+		if (layout != layouts.end()) {
+			layouts.insert(std::make_pair(to, layout->second));
+		}
+		auto measured = measuredLogicalQubits.find(from);
+		if (measured != measuredLogicalQubits.end()) {
+			measuredLogicalQubits.insert(std::make_pair(to, measured->second));
+		}
+		auto stats = passStatistics.find(from);
+		if (stats != passStatistics.end()) {
+			passStatistics.insert(std::make_pair(to, stats->second));
+		}
+	}
+
+	/**
+	 * Record that the physical qubit p of the given kernel
+	 * is moved to physical qubit permutation[p]. Composes
+	 * with any layout already recorded for the kernel.
+	 */
+	void composeLayout(const std::shared_ptr<Function>& kernel,
+			const std::vector<int>& permutation) {
+		std::lock_guard<std::mutex> lock(contextMutex);
+		auto& layout = layouts[kernel];
+		if (layout.empty()) {
+			layout = permutation;
+			return;
+		}
+		for (auto& p : layout) {
+			if (p >= 0 && p < permutation.size()) {
+				p = permutation[p];
+			}
+		}
+	}
+
+	/**
+	 * Return the logical to physical layout of the given
+	 * kernel, empty if its qubits were never moved.
+	 */
+	std::vector<int> getLayout(const std::shared_ptr<Function>& kernel) {
+		std::lock_guard<std::mutex> lock(contextMutex);
+		return find(layouts, kernel);
+	}
+
+	/**
+	 * Record the logical qubit read by each measurement of the
+	 * given kernel. Only the first transformation to move the
+	 * kernel's qubits sees logical indices, so later calls for
+	 * the same kernel are ignored.
+	 */
+	void recordMeasuredQubits(const std::shared_ptr<Function>& kernel,
+			const std::vector<int>& logicalQubits) {
+		std::lock_guard<std::mutex> lock(contextMutex);
+		measuredLogicalQubits.insert(std::make_pair(kernel, logicalQubits));
+	}
+
+	/**
+	 * Return the logical qubit read by each measurement of
+	 * the given kernel, empty if its qubits were never moved.
+	 */
+	std::vector<int> getMeasuredQubits(const std::shared_ptr<Function>& kernel) {
+		std::lock_guard<std::mutex> lock(contextMutex);
+		return find(measuredLogicalQubits, kernel);
+	}
+
+	/**
+	 * Record the statistics of the given kernel
+	 * before and after the given transformation.
+	 */
+	void recordPassStatistics(const std::shared_ptr<Function>& kernel,
+			const IBMPassStatistics& stats) {
+		std::lock_guard<std::mutex> lock(contextMutex);
+		passStatistics[kernel].push_back(stats);
+	}
+
+	/**
+	 * Return the statistics of every transformation
+	 * run on the given kernel, in order.
+	 */
+	std::vector<IBMPassStatistics> getPassStatistics(
+			const std::shared_ptr<Function>& kernel) {
+		std::lock_guard<std::mutex> lock(contextMutex);
+		return find(passStatistics, kernel);
+	}
+};
+
+}
+}
+
+#endif
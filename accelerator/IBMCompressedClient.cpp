@@ -0,0 +1,158 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#include "IBMCompressedClient.hpp"
+#include "XACC.hpp"
+
+#include <zlib.h>
+
+namespace xacc {
+namespace quantum {
+
+const std::string IBMCompressedClient::post(const std::string& remoteUrl,
+		const std::string& path, const std::string& postStr,
+		std::map<std::string, std::string> headers) {
+
+	headers["Accept-Encoding"] = "gzip, deflate";
+
+	// Only job submissions are large enough to be worth compressing,
+	// the login POST is always sent as is.
+	if (path.compare(0, 9, "/api/Jobs") != 0 || postStr.size() < _threshold) {
+		return decodeResponse(_client->post(remoteUrl, path, postStr, headers));
+	}
+
+	auto compressed = compress(postStr);
+	headers["Content-Encoding"] = "gzip";
+	if (headers.count("Content-Length")) {
+		headers["Content-Length"] = std::to_string(compressed.size());
+	}
+
+	xacc::info("Compressed POST body from " + std::to_string(postStr.size())
+			+ " to " + std::to_string(compressed.size()) + " bytes.");
+
+	return decodeResponse(_client->post(remoteUrl, path, compressed, headers));
+}
+
+const std::string IBMCompressedClient::get(const std::string& remoteUrl,
+		const std::string& path, std::map<std::string, std::string> headers) {
+	headers["Accept-Encoding"] = "gzip, deflate";
+	return decodeResponse(_client->get(remoteUrl, path, headers));
+}
+
+const std::string IBMCompressedClient::decodeResponse(
+		const std::string& response) {
+	if (!isCompressed(response)) {
+		return response;
+	}
+	auto size = decompress(response, inflateBuffer);
+	return std::string(inflateBuffer.data(), size);
+}
+
+std::string IBMCompressedClient::compress(const std::string& data) {
+	z_stream stream;
+	stream.zalloc = Z_NULL;
+	stream.zfree = Z_NULL;
+	stream.opaque = Z_NULL;
+
+	// 16 + MAX_WBITS selects the gzip wrapper
+	if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+			16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		xacc::error("Could not initialize gzip compression.");
+	}
+
+	std::string out(deflateBound(&stream, data.size()), '\0');
+	stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+	stream.avail_in = data.size();
+	stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+	stream.avail_out = out.size();
+
+	auto status = deflate(&stream, Z_FINISH);
+	auto size = stream.total_out;
+	deflateEnd(&stream);
+
+	if (status != Z_STREAM_END) {
+		xacc::error("Could not gzip compress POST body.");
+	}
+
+	out.resize(size);
+	return out;
+}
+
+bool IBMCompressedClient::isCompressed(const std::string& data) {
+	if (data.size() < 2) {
+		return false;
+	}
+	auto b0 = static_cast<unsigned char>(data[0]);
+	auto b1 = static_cast<unsigned char>(data[1]);
+	bool gzip = b0 == 0x1f && b1 == 0x8b;
+	bool zlib = (b0 & 0x0f) == 0x08 && ((b0 << 8) | b1) % 31 == 0;
+	return gzip || zlib;
+}
+
+std::size_t IBMCompressedClient::decompress(const std::string& data,
+		std::vector<char>& out) {
+	z_stream stream;
+	stream.zalloc = Z_NULL;
+	stream.zfree = Z_NULL;
+	stream.opaque = Z_NULL;
+	stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+	stream.avail_in = data.size();
+
+	// 32 + MAX_WBITS detects gzip and zlib headers
+	if (inflateInit2(&stream, 32 + MAX_WBITS) != Z_OK) {
+		xacc::error("Could not initialize response decompression.");
+	}
+
+	if (out.size() < 4 * data.size()) {
+		out.resize(4 * data.size());
+	}
+
+	int status = Z_OK;
+	while (status != Z_STREAM_END) {
+		if (stream.total_out == out.size()) {
+			out.resize(2 * out.size());
+		}
+		stream.next_out = reinterpret_cast<Bytef*>(out.data() + stream.total_out);
+		stream.avail_out = out.size() - stream.total_out;
+		status = inflate(&stream, Z_NO_FLUSH);
+		if (status != Z_OK && status != Z_STREAM_END) {
+			inflateEnd(&stream);
+			xacc::error("Could not decompress response, zlib status "
+					+ std::to_string(status));
+		}
+	}
+
+	auto size = stream.total_out;
+	inflateEnd(&stream);
+	return size;
+}
+
+}
+}
@@ -0,0 +1,117 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#ifndef ACCELERATOR_IBMCOMPRESSEDCLIENT_HPP_
+#define ACCELERATOR_IBMCOMPRESSEDCLIENT_HPP_
+
+#include "RemoteAccelerator.hpp"
+
+namespace xacc {
+namespace quantum {
+
+/**
+ * The IBMCompressedClient decorates the Client used by the
+ * RemoteAccelerator. Job submission (/api/Jobs) POST bodies larger
+ * than a threshold are gzip encoded and sent with a Content-Encoding
+ * header, other POSTs like login are sent uncompressed, every
+ * request advertises Accept-Encoding, and gzip or deflate
+ * encoded responses are inflated before they are returned.
+ *
+ * Inflation is done into a buffer owned by this client that
+ * is reused across requests.
+ */
+class IBMCompressedClient : public Client {
+
+protected:
+
+	/**
+	 * The Client that actually talks to the remote host.
+	 */
+	std::shared_ptr<Client> _client;
+
+	/**
+	 * Job submissions smaller than this are sent uncompressed.
+	 */
+	std::size_t _threshold;
+
+	/**
+	 * Reusable inflate buffer.
+	 */
+	std::vector<char> inflateBuffer;
+
+	/**
+	 * Inflate the response if it is gzip or
+	 * deflate encoded, else return it as is.
+	 */
+	const std::string decodeResponse(const std::string& response);
+
+public:
+
+	IBMCompressedClient(std::shared_ptr<Client> client,
+			const std::size_t threshold = 1024) :
+			_client(client), _threshold(threshold) {
+	}
+
+	virtual const std::string post(const std::string& remoteUrl,
+			const std::string& path, const std::string& postStr,
+			std::map<std::string, std::string> headers = std::map<std::string,
+					std::string> { });
+
+	virtual const std::string get(const std::string& remoteUrl,
+			const std::string& path,
+			std::map<std::string, std::string> headers = std::map<std::string,
+					std::string> { });
+
+	/**
+	 * Return the gzip encoding of the given string.
+	 */
+	static std::string compress(const std::string& data);
+
+	/**
+	 * Return true if the given string starts with
+	 * a gzip or zlib (deflate) header.
+	 */
+	static bool isCompressed(const std::string& data);
+
+	/**
+	 * Inflate gzip or deflate encoded data into out,
+	 * which is resized as needed and can be reused.
+	 * Returns the number of inflated bytes.
+	 */
+	static std::size_t decompress(const std::string& data,
+			std::vector<char>& out);
+
+	virtual ~IBMCompressedClient() {}
+};
+
+}
+}
+
+#endif
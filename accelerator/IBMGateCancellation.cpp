@@ -0,0 +1,164 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#include "IBMGateCancellation.hpp"
+#include "XACC.hpp"
+#include <algorithm>
+#include <cmath>
+#include <boost/math/constants/constants.hpp>
+
+namespace xacc {
+namespace quantum {
+
+namespace {
+
+const std::vector<std::string> selfInverseGates { "H", "X", "Y", "Z",
+		"CNOT", "CZ" };
+
+const std::vector<std::string> rotationGates { "Rx", "Ry", "Rz" };
+
+bool isIn(const std::string& name, const std::vector<std::string>& names) {
+	return std::find(names.begin(), names.end(), name) != names.end();
+}
+
+bool hasNumericAngle(std::shared_ptr<Instruction> inst) {
+	return inst->getParameters().size() == 1
+			&& inst->getParameter(0).which() == 1;
+}
+
+}
+
+std::vector<std::shared_ptr<Instruction>> IBMGateCancellation::cancel(
+		const std::vector<std::shared_ptr<Instruction>>& instructions) {
+
+	// Removed gates are left as nullptr until the end
+	std::vector<std::shared_ptr<Instruction>> out;
+
+	for (auto inst : instructions) {
+		bool absorbed = false;
+		auto bits = inst->bits();
+		auto name = inst->name();
+
+		for (int j = out.size() - 1; j >= 0; j--) {
+			auto prev = out[j];
+			if (!prev) {
+				continue;
+			}
+			auto prevBits = prev->bits();
+			bool shares = std::any_of(bits.begin(), bits.end(),
+					[&](int b) {
+						return std::find(prevBits.begin(), prevBits.end(), b)
+								!= prevBits.end();
+					});
+			if (!shares) {
+				continue;
+			}
+
+			if (prev->name() == name && prevBits == bits) {
+				if (isIn(name, selfInverseGates)) {
+					out[j] = nullptr;
+					nRemoved += 2;
+					absorbed = true;
+					break;
+				}
+
+				if (isIn(name, rotationGates) && hasNumericAngle(prev)
+						&& hasNumericAngle(inst)) {
+					// Rotations by 2 pi are the identity up to a global phase
+					auto twoPi = 2.0 * boost::math::constants::pi<double>();
+					auto angle = std::fmod(
+							boost::get<double>(prev->getParameter(0))
+									+ boost::get<double>(inst->getParameter(0)),
+							twoPi);
+					if (std::fabs(angle) < tolerance
+							|| std::fabs(std::fabs(angle) - twoPi) < tolerance) {
+						out[j] = nullptr;
+						nRemoved += 2;
+					} else {
+						out[j] = gateRegistry->createInstruction(name, bits,
+								std::vector<InstructionParameter> {
+										InstructionParameter(angle) });
+						nRemoved++;
+					}
+					absorbed = true;
+					break;
+				}
+			}
+
+			if (!gatesCommute(prev, inst)) {
+				break;
+			}
+		}
+
+		if (!absorbed) {
+			out.push_back(inst);
+		}
+	}
+
+	out.erase(std::remove(out.begin(), out.end(), nullptr), out.end());
+	return out;
+}
+
+std::shared_ptr<IR> IBMGateCancellation::transform(std::shared_ptr<IR> ir) {
+
+	xacc::info("Executing IBM Gate Cancellation - Removing redundant gates.");
+
+	gateRegistry = xacc::getService<IRProvider>("gate");
+	nRemoved = 0;
+
+	auto newir = gateRegistry->createIR();
+	for (auto kernel : ir->getKernels()) {
+		if (!isFlattenable(kernel)) {
+			newir->addKernel(kernel);
+			continue;
+		}
+
+		auto before = nRemoved;
+		auto instructions = cancel(flattenKernel(kernel));
+		if (nRemoved == before) {
+			newir->addKernel(kernel);
+			continue;
+		}
+
+		auto optimized = emptyCopy(kernel);
+		for (auto inst : instructions) {
+			optimized->addInstruction(inst);
+		}
+
+		xacc::info("Removed " + std::to_string(nRemoved - before)
+				+ " gates from " + kernel->name());
+		newir->addKernel(optimized);
+	}
+
+	return newir;
+}
+
+}
+}
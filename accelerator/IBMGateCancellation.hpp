@@ -0,0 +1,100 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#ifndef ACCELERATOR_IBMGATECANCELLATION_HPP_
+#define ACCELERATOR_IBMGATECANCELLATION_HPP_
+
+#include "IRTransformation.hpp"
+#include "IBMKernelUtils.hpp"
+
+namespace xacc {
+namespace quantum {
+
+/**
+ * The IBMGateCancellation is a peephole IRTransformation over
+ * the flattened instruction stream of each kernel. Every gate is
+ * commuted backwards past the gates it commutes with, and is
+ * cancelled against a matching self-inverse gate (H, X, Y, Z,
+ * CNOT, CZ) or merged with a rotation about the same axis.
+ *
+ * Commutation is decided by gatesCommute in IBMKernelUtils.
+ *
+ * It is meant to run after the IBMIRTransformation, which leaves
+ * back to back Hadamards around consecutive reversed CNOTs.
+ */
+class IBMGateCancellation: public IRTransformation {
+
+protected:
+
+	int nRemoved = 0;
+
+	/**
+	 * Rotations whose merged angle is within this
+	 * tolerance of zero are dropped.
+	 */
+	double tolerance;
+
+	std::shared_ptr<IRProvider> gateRegistry;
+
+	/**
+	 * Return the cancelled instruction stream
+	 * for the given flattened kernel.
+	 */
+	std::vector<std::shared_ptr<Instruction>> cancel(
+			const std::vector<std::shared_ptr<Instruction>>& instructions);
+
+public:
+
+	IBMGateCancellation(const double angleTolerance = 1e-12) :
+			tolerance(angleTolerance) {
+	}
+
+	virtual std::shared_ptr<IR> transform(std::shared_ptr<IR> ir);
+
+	/**
+	 * Return the number of gates removed by the last transform.
+	 */
+	int getNumberOfRemovedGates() {
+		return nRemoved;
+	}
+
+	virtual const std::string name() const {
+		return "ibm-gate-cancellation";
+	}
+
+	virtual const std::string description() const {
+		return "Cancel adjacent inverse gates and merge rotations.";
+	}
+};
+
+}
+}
+
+#endif
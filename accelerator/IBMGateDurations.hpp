@@ -0,0 +1,185 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#ifndef ACCELERATOR_IBMGATEDURATIONS_HPP_
+#define ACCELERATOR_IBMGATEDURATIONS_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/algorithm/string.hpp>
+
+namespace xacc {
+namespace quantum {
+
+/**
+ * Nominal gate durations of an IBM backend, in nanoseconds,
+ * used to estimate how much device time a job will take.
+ *
+ * Z rotations are frame changes on IBM hardware and take no time.
+ */
+struct IBMGateDurations {
+	double singleQubit;
+	double cnot;
+	double measure;
+
+	/**
+	 * Delay between shots, for the qubits to relax
+	 */
+	double repetition;
+
+	IBMGateDurations(const double u = 0.0, const double cx = 0.0,
+			const double m = 0.0, const double rep = 0.0) :
+			singleQubit(u), cnot(cx), measure(m), repetition(rep) {
+	}
+
+	/**
+	 * Return the durations of the given backend. Simulators,
+	 * and backends we have no table for, take no device time.
+	 */
+	static IBMGateDurations forBackend(const std::string& backendName) {
+		static const std::map<std::string, IBMGateDurations> tables {
+			{ "ibmqx2", IBMGateDurations(130.0, 390.0, 4000.0, 100000.0) },
+			{ "ibmqx3", IBMGateDurations(130.0, 430.0, 4000.0, 100000.0) },
+			{ "ibmqx4", IBMGateDurations(130.0, 350.0, 4000.0, 100000.0) },
+			{ "ibmqx5", IBMGateDurations(130.0, 430.0, 4000.0, 100000.0) }
+		};
+		auto it = tables.find(backendName);
+		return it == tables.end() ? IBMGateDurations() : it->second;
+	}
+
+	/**
+	 * Override these durations with a comma separated list of
+	 * name=nanoseconds, with names u, cx, measure and repetition.
+	 */
+	void parse(const std::string& durations) {
+		std::vector<std::string> entries;
+		boost::split(entries, durations, boost::is_any_of(","));
+		for (auto& entry : entries) {
+			std::vector<std::string> kv;
+			boost::split(kv, entry, boost::is_any_of("="));
+			if (kv.size() != 2) {
+				continue;
+			}
+			auto key = boost::trim_copy(kv[0]);
+			auto value = std::stod(kv[1]);
+			if (key == "u") {
+				singleQubit = value;
+			} else if (key == "cx") {
+				cnot = value;
+			} else if (key == "measure") {
+				measure = value;
+			} else if (key == "repetition") {
+				repetition = value;
+			}
+		}
+	}
+
+	/**
+	 * Return the duration of the given OpenQasm operation
+	 * acting on the given number of qubits.
+	 */
+	double duration(const std::string& op, const int nQubits) const {
+		if (op == "u1" || op == "z" || op == "id") {
+			return 0.0;
+		} else if (op == "measure") {
+			return measure;
+		} else if (nQubits == 2) {
+			return cnot;
+		}
+		return singleQubit;
+	}
+
+	/**
+	 * Return the duration of one shot of the given OpenQasm, as
+	 * emitted by the OpenQasmVisitor, the length of its critical
+	 * path weighted by gate durations. Conditional gates wait for
+	 * the measurement into the classical register they test.
+	 */
+	double circuitTime(const std::string& qasm) const {
+		std::map<std::string, double> wireTimes;
+		double total = 0.0;
+		std::vector<std::string> lines;
+		boost::split(lines, qasm, boost::is_any_of("\n"));
+		for (auto line : lines) {
+			boost::trim(line);
+
+			// Registers read by the statement, and the
+			// qubits and registers it writes
+			std::vector<std::string> reads, writes;
+			if (boost::starts_with(line, "if")) {
+				auto open = line.find('('), close = line.find(')');
+				if (open == std::string::npos || close == std::string::npos) {
+					continue;
+				}
+				auto condition = line.substr(open + 1, close - open - 1);
+				reads.push_back(
+						boost::trim_copy(condition.substr(0, condition.find('='))));
+				line = boost::trim_copy(line.substr(close + 1));
+			}
+
+			auto op = line.substr(0, line.find_first_of(" (;"));
+			if (op.empty() || op == "include" || op == "qreg" || op == "creg"
+					|| op == "barrier") {
+				continue;
+			}
+
+			auto arrow = line.find("->");
+			for (auto pos = line.find("q["); pos < arrow;
+					pos = line.find("q[", pos + 1)) {
+				writes.push_back(line.substr(pos, line.find(']', pos) - pos + 1));
+			}
+			auto nQubits = writes.size();
+			if (arrow != std::string::npos) {
+				auto target = boost::trim_copy(line.substr(arrow + 2));
+				writes.push_back(target.substr(0, target.find('[')));
+			}
+
+			double start = 0.0;
+			for (auto& wire : reads) {
+				start = std::max(start, wireTimes[wire]);
+			}
+			for (auto& wire : writes) {
+				start = std::max(start, wireTimes[wire]);
+			}
+			auto end = start + duration(op, nQubits);
+			for (auto& wire : writes) {
+				wireTimes[wire] = end;
+			}
+			total = std::max(total, end);
+		}
+		return total;
+	}
+};
+
+}
+}
+
+#endif
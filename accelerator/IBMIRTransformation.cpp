@@ -1,4 +1,5 @@
 #include "IBMIRTransformation.hpp"
+#include <thread>
 
 namespace xacc {
 namespace quantum {
@@ -7,84 +8,125 @@ std::shared_ptr<IR> IBMIRTransformation::transform(std::shared_ptr<IR> ir) {
 
 	xacc::info("Executing IBM IR Transformation - Modifying CNOT connectivity.");
 
-	std::shared_ptr<IRProvider> irProvider = xacc::getService<IRProvider>("gate");
-	auto newir = irProvider->createIR();
+	gateRegistry = xacc::getService<IRProvider>("gate");
+	auto newir = gateRegistry->createIR();
+	rewritten = std::make_shared<RewrittenComposites>();
+
+	auto kernels = ir->getKernels();
+	std::vector<std::shared_ptr<Function>> newKernels(kernels.size());
+
+	// Kernels are independent, so split them over the
+	// available hardware threads, each with its own copy
+	// of this visitor.
+	std::size_t nThreads = std::min<std::size_t>(kernels.size(),
+			std::max(1u, std::thread::hardware_concurrency()));
+	if (nThreads <= 1) {
+		for (int i = 0; i < kernels.size(); i++) {
+			newKernels[i] = rewrite(kernels[i]);
+		}
+	} else {
+		std::vector<std::thread> workers;
+		for (std::size_t t = 0; t < nThreads; t++) {
+			workers.push_back(std::thread([&, t]() {
+				IBMIRTransformation worker(*this);
+				for (std::size_t i = t; i < kernels.size(); i += nThreads) {
+					newKernels[i] = worker.rewrite(kernels[i]);
+				}
+			}));
+		}
+		for (auto& w : workers) {
+			w.join();
+		}
+	}
 
-	for (auto kernel : ir->getKernels()) {
+	for (auto kernel : newKernels) {
+		newir->addKernel(kernel);
+	}
 
-//		std::cout << "KERNEL BEFORE:\n" << kernel->toString("qreg") << "\n\n";
-		currentKernelInstructionIdx = 0;
+	rewritten.reset();
+	return newir;
+}
 
-		InstructionIterator it(kernel);
-		while (it.hasNext()) {
-			// Get the next node in the tree
-			auto nextInst = it.next();
+std::shared_ptr<Function> IBMIRTransformation::rewrite(
+		std::shared_ptr<Function> function) {
 
-			if (!nextInst->isComposite() && nextInst->isEnabled()) {
-				nextInst->accept(this);
+	std::shared_ptr<Function> newFunction;
+	if (auto cond = std::dynamic_pointer_cast<ConditionalFunction>(function)) {
+		newFunction = std::make_shared<ConditionalFunction>(
+				cond->getConditionalQubit());
+	} else {
+		newFunction = std::make_shared<GateFunction>(function->name(),
+				function->getParameters());
+	}
 
-				if (!nextInst->isEnabled() && "CNOT" == nextInst->name()) {
-					kernel->removeInstruction(currentKernelInstructionIdx);
-					int count = 0;
-					for (auto inst : newInstructions) {
-						kernel->insertInstruction(
-								currentKernelInstructionIdx + count, inst);
-						count++;
-					}
+	for (auto inst : function->getInstructions()) {
 
-					currentKernelInstructionIdx += count - 1;
-				}
+		if (inst->isComposite()) {
+			newFunction->addInstruction(
+					rewriteComposite(std::dynamic_pointer_cast<Function>(inst)));
+			continue;
+		}
 
-				newInstructions.clear();
-				currentKernelInstructionIdx++;
-			}
+		if (inst->isEnabled()) {
+			inst->accept(this);
+		}
 
+		if (newInstructions.empty()) {
+			newFunction->addInstruction(inst);
+		} else {
+			for (auto newInst : newInstructions) {
+				newFunction->addInstruction(newInst);
+			}
+			newInstructions.clear();
 		}
+	}
+
+	return newFunction;
+}
 
-//		std::cout << "KERNEL AFTER:\n" << kernel->toString("qreg") << "\n";
+std::shared_ptr<Function> IBMIRTransformation::rewriteComposite(
+		std::shared_ptr<Function> composite) {
 
-		newir->addKernel(kernel);
+	{
+		std::lock_guard<std::mutex> guard(rewritten->lock);
+		auto found = rewritten->copies.find(composite);
+		if (found != rewritten->copies.end()) {
+			return found->second;
+		}
 	}
 
+	// Rewrite outside the lock, other threads may race us
+	// to the same composite, the first copy stored wins.
+	auto newChild = rewrite(composite);
+	if (!composite->isEnabled()) {
+		newChild->disable();
+	}
 
-	return newir;
+	std::lock_guard<std::mutex> guard(rewritten->lock);
+	return rewritten->copies.insert(std::make_pair(composite, newChild)).first->second;
 }
 
 void IBMIRTransformation::visit(CNOT& cnot) {
 
 	auto source = cnot.bits()[0];
 	auto target = cnot.bits()[1];
-	std::shared_ptr<IRProvider> gateRegistry = xacc::getService<IRProvider>("gate");
 
 	if (!isCouplingAvailable(source, target)) {
 
-		// Disable this cnot
-		cnot.disable();
-
-		// Here I know that this cnot is at
-		// the currentKernelInstructionIdx, so I want
-		// to insert 2 Hadamards, a reversed cnot, then 2 hadamards
-
-		auto h0 = gateRegistry->createInstruction("H", std::vector<int> { source });
-		auto h1 = gateRegistry->createInstruction("H", std::vector<int> { target });
-		auto revCnot = gateRegistry->createInstruction("CNOT", std::vector<int> { target,
-				source });
-
-		newInstructions.push_back(h0);
-		newInstructions.push_back(h1);
-		newInstructions.push_back(revCnot);
-		newInstructions.push_back(h0);
-		newInstructions.push_back(h1);
-	}
-}
-
-bool IBMIRTransformation::isCouplingAvailable(const int src, const int tgt) {
-	for (auto c : _couplers) {
-		if (c.first == src && c.second == tgt) {
-			return true;
-		}
+		// Replace this cnot with 2 Hadamards,
+		// a reversed cnot, then 2 hadamards
+		newInstructions.push_back(
+				gateRegistry->createInstruction("H", std::vector<int> { source }));
+		newInstructions.push_back(
+				gateRegistry->createInstruction("H", std::vector<int> { target }));
+		newInstructions.push_back(
+				gateRegistry->createInstruction("CNOT",
+						std::vector<int> { target, source }));
+		newInstructions.push_back(
+				gateRegistry->createInstruction("H", std::vector<int> { source }));
+		newInstructions.push_back(
+				gateRegistry->createInstruction("H", std::vector<int> { target }));
 	}
-	return false; //tgt == _couplers[src].first || tgt == _couplers[src].second;
 }
 
 }
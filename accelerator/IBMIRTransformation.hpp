@@ -10,28 +10,80 @@
 #include "GateFunction.hpp"
 #include "Hadamard.hpp"
 #include "Measure.hpp"
+#include "ConditionalFunction.hpp"
+#include "IBMBackendTopology.hpp"
+#include <map>
+#include <mutex>
 
 namespace xacc {
 namespace quantum {
 
+/**
+ * The IBMIRTransformation rewrites every CNOT whose direction
+ * is not supported by the backend's coupling map into a
+ * reversed CNOT surrounded by Hadamards.
+ *
+ * Coupling lookups go through a dense nQubits x nQubits table,
+ * each kernel is rebuilt in a single pass over its instructions
+ * (the input IR is never modified), and independent kernels
+ * are transformed in parallel. A composite shared between
+ * kernels is rewritten once, so the new kernels share it too.
+ */
 class IBMIRTransformation: public IRTransformation,
 		public BaseInstructionVisitor,
 		public InstructionVisitor<CNOT> {
 
 protected:
 
-	std::vector<std::pair<int, int>> _couplers;
+	std::shared_ptr<IBMBackendTopology> topology;
 
-	int currentKernelInstructionIdx;
+	/**
+	 * The gate IRProvider, looked up once per transform.
+	 */
+	std::shared_ptr<IRProvider> gateRegistry;
 
+	/**
+	 * The instructions replacing the last visited
+	 * CNOT, empty if it can be kept as is.
+	 */
 	std::vector<std::shared_ptr<Instruction>> newInstructions;
 
-	bool isCouplingAvailable(const int src, const int tgt);
+	/**
+	 * The rewritten copy of every composite seen
+	 * during the current transform, shared by all
+	 * worker threads.
+	 */
+	struct RewrittenComposites {
+		std::mutex lock;
+		std::map<std::shared_ptr<Function>, std::shared_ptr<Function>> copies;
+	};
+	std::shared_ptr<RewrittenComposites> rewritten;
+
+	bool isCouplingAvailable(const int src, const int tgt) {
+		return topology->isCoupled(src, tgt);
+	}
+
+	/**
+	 * Return a copy of the given function with
+	 * every CNOT rewritten for the coupling map.
+	 */
+	std::shared_ptr<Function> rewrite(std::shared_ptr<Function> function);
+
+	/**
+	 * Return the rewritten copy of the given composite,
+	 * rewriting it the first time it is seen.
+	 */
+	std::shared_ptr<Function> rewriteComposite(
+			std::shared_ptr<Function> composite);
 
 public:
 
+	IBMIRTransformation(std::shared_ptr<IBMBackendTopology> backendTopology) :
+			topology(backendTopology) {
+	}
+
 	IBMIRTransformation(std::vector<std::pair<int, int>> couplers) :
-			_couplers(couplers), currentKernelInstructionIdx(0) {
+			IBMIRTransformation(std::make_shared<IBMBackendTopology>(couplers)) {
 	}
 
 	virtual std::shared_ptr<IR> transform(std::shared_ptr<IR> ir);
@@ -0,0 +1,203 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#include "IBMInstructionScheduler.hpp"
+#include "XACC.hpp"
+#include <algorithm>
+#include <numeric>
+#include <map>
+
+namespace xacc {
+namespace quantum {
+
+namespace {
+
+/**
+ * The layers a qubit is busy in, as disjoint [first, last) ranges
+ * keyed by first, with the commuting run of gates it is in.
+ */
+struct QubitTimeline {
+	std::map<int, int> busy;
+
+	// The basis of the current run of commuting gates, 0 if
+	// there is none, the first layer gates of the run may use
+	// and the last layer the run reaches
+	char runBasis = 0;
+	int runStart = 0;
+	int runEnd = -1;
+
+	/**
+	 * Return the first layer at or after the given one
+	 * this qubit is free in.
+	 */
+	int firstFree(const int layer) const {
+		auto range = busy.upper_bound(layer);
+		if (range != busy.begin() && (--range)->second > layer) {
+			return range->second;
+		}
+		return layer;
+	}
+
+	void occupy(const int layer) {
+		auto next = busy.find(layer + 1);
+		auto last = layer + 1;
+		if (next != busy.end()) {
+			last = next->second;
+			busy.erase(next);
+		}
+		auto previous = busy.upper_bound(layer);
+		if (previous != busy.begin() && (--previous)->second == layer) {
+			previous->second = last;
+		} else {
+			busy[layer] = last;
+		}
+	}
+};
+
+/**
+ * Return the ASAP layer of each instruction, in the given order.
+ *
+ * Gates commute on a qubit when they are diagonal in the same
+ * basis there, so an instruction only has to wait for the last
+ * run of gates it does not commute with on each of its qubits.
+ */
+std::vector<int> asapLayers(
+		const std::vector<std::shared_ptr<Instruction>>& instructions) {
+	std::vector<int> layers(instructions.size(), 0);
+	std::map<int, QubitTimeline> timelines;
+	int lastMeasureLayer = 0;
+
+	for (int i = 0; i < instructions.size(); i++) {
+		auto inst = instructions[i];
+		auto bits = inst->bits();
+
+		int earliest = 0;
+		for (auto b : bits) {
+			auto& timeline = timelines[b];
+			auto basis = gateBasis(inst, b);
+			if (basis == 0 || basis != timeline.runBasis) {
+				// Start a new run after the current one
+				timeline.runStart = std::max(timeline.runStart,
+						timeline.runEnd + 1);
+				timeline.runBasis = basis;
+			}
+			earliest = std::max(earliest, timeline.runStart);
+		}
+
+		// Measurements may share a layer, but never move ahead of
+		// an earlier one, results are decoded in measurement order
+		if (inst->name() == "Measure") {
+			earliest = std::max(earliest, lastMeasureLayer);
+		}
+
+		auto layer = earliest;
+		for (bool moved = true; moved;) {
+			moved = false;
+			for (auto b : bits) {
+				auto free = timelines[b].firstFree(layer);
+				if (free != layer) {
+					layer = free;
+					moved = true;
+				}
+			}
+		}
+
+		layers[i] = layer;
+		for (auto b : bits) {
+			auto& timeline = timelines[b];
+			timeline.occupy(layer);
+			timeline.runEnd = std::max(timeline.runEnd, layer);
+		}
+		if (inst->name() == "Measure") {
+			lastMeasureLayer = layer;
+		}
+	}
+
+	return layers;
+}
+
+}
+
+std::vector<int> IBMInstructionScheduler::schedule(
+		const std::vector<std::shared_ptr<Instruction>>& instructions,
+		const Policy policy) {
+	if (policy == Policy::ASAP) {
+		return asapLayers(instructions);
+	}
+
+	// ALAP is ASAP on the reversed program, with layers reversed
+	std::vector<std::shared_ptr<Instruction>> reversed(instructions.rbegin(),
+			instructions.rend());
+	auto reversedLayers = asapLayers(reversed);
+	int depth = 0;
+	for (auto l : reversedLayers) {
+		depth = std::max(depth, l + 1);
+	}
+	std::vector<int> layers(instructions.size());
+	for (int i = 0; i < instructions.size(); i++) {
+		layers[i] = depth - 1 - reversedLayers[instructions.size() - 1 - i];
+	}
+	return layers;
+}
+
+std::shared_ptr<IR> IBMInstructionScheduler::transform(std::shared_ptr<IR> ir) {
+
+	xacc::info("Executing IBM Instruction Scheduler - Layering instructions.");
+
+	auto provider = xacc::getService<IRProvider>("gate");
+	auto newir = provider->createIR();
+
+	for (auto kernel : ir->getKernels()) {
+		if (!isFlattenable(kernel)) {
+			newir->addKernel(kernel);
+			continue;
+		}
+
+		auto instructions = flattenKernel(kernel);
+		auto layers = schedule(instructions, policy);
+
+		std::vector<int> order(instructions.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+			return layers[a] < layers[b];
+		});
+
+		auto scheduled = emptyCopy(kernel);
+		for (auto i : order) {
+			scheduled->addInstruction(instructions[i]);
+		}
+		newir->addKernel(scheduled);
+	}
+
+	return newir;
+}
+
+}
+}
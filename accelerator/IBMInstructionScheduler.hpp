@@ -0,0 +1,88 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#ifndef ACCELERATOR_IBMINSTRUCTIONSCHEDULER_HPP_
+#define ACCELERATOR_IBMINSTRUCTIONSCHEDULER_HPP_
+
+#include "IRTransformation.hpp"
+#include "IBMKernelUtils.hpp"
+
+namespace xacc {
+namespace quantum {
+
+/**
+ * The IBMInstructionScheduler assigns every instruction of a
+ * flattened kernel to a layer, as soon as possible (ASAP) or as
+ * late as possible (ALAP), and rewrites the kernel layer by layer.
+ *
+ * An instruction only waits on earlier instructions it does not
+ * commute with, so commuting gates are reordered to shorten the
+ * critical path. Measurements keep their relative order so that
+ * results can still be decoded, but may share a layer.
+ */
+class IBMInstructionScheduler: public IRTransformation {
+
+public:
+
+	enum class Policy {
+		ASAP, ALAP
+	};
+
+	IBMInstructionScheduler(const Policy schedulingPolicy = Policy::ASAP) :
+			policy(schedulingPolicy) {
+	}
+
+	virtual std::shared_ptr<IR> transform(std::shared_ptr<IR> ir);
+
+	/**
+	 * Return the layer of each of the given instructions,
+	 * scheduled with the given policy.
+	 */
+	static std::vector<int> schedule(
+			const std::vector<std::shared_ptr<Instruction>>& instructions,
+			const Policy policy);
+
+	virtual const std::string name() const {
+		return "ibm-instruction-scheduler";
+	}
+
+	virtual const std::string description() const {
+		return "Layer instructions ASAP or ALAP, reordering commuting gates.";
+	}
+
+protected:
+
+	Policy policy;
+};
+
+}
+}
+
+#endif
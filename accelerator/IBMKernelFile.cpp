@@ -0,0 +1,490 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#include "IBMKernelFile.hpp"
+
+#include "XACC.hpp"
+#include "IRProvider.hpp"
+#include "GateFunction.hpp"
+#include "ConditionalFunction.hpp"
+#include "InstructionIterator.hpp"
+
+#include <fstream>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace xacc {
+namespace quantum {
+
+namespace {
+
+const char kernelFileMagic[8] = { 'X', 'A', 'C', 'C', 'I', 'B', 'M', 'K' };
+const std::uint32_t kernelFileVersion = 1;
+
+enum RecordFlags : std::uint8_t {
+	Enabled = 1, Composite = 2, Conditional = 4, Reference = 8
+};
+
+struct FileHeader {
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t nKernels;
+	std::uint64_t sourceHash;
+	std::uint32_t nRecords;
+	std::uint32_t nParams;
+	std::uint32_t nMeasured;
+	std::uint32_t nStringBytes;
+};
+
+struct KernelRecord {
+	std::uint32_t record;
+	std::uint32_t firstMeasured;
+	std::uint32_t nMeasured;
+};
+
+/**
+ * One flat instruction. Composites are followed by the records
+ * of their nChildren children, References point back at the
+ * record of a composite that was already written.
+ */
+struct InstructionRecord {
+	std::uint32_t nameOffset;
+	std::uint16_t nameLength;
+	std::uint8_t nBits;
+	std::uint8_t flags;
+	std::int32_t bits[2];
+	std::uint32_t firstParam;
+	std::uint32_t nParams;
+	std::uint32_t nChildren;
+	std::uint32_t link;
+};
+
+struct ParamRecord {
+	std::int32_t type;
+	std::uint32_t strOffset;
+	std::uint32_t strLength;
+	std::uint32_t padding;
+	double real;
+	double imag;
+};
+
+class KernelFileWriter {
+public:
+	std::vector<InstructionRecord> records;
+	std::vector<ParamRecord> params;
+	std::vector<std::int32_t> measured;
+	std::string strings;
+	std::map<Instruction*, std::uint32_t> writtenComposites;
+
+	std::uint32_t addString(const std::string& str) {
+		auto offset = strings.size();
+		strings += str;
+		return offset;
+	}
+
+	void addParameters(std::vector<InstructionParameter> parameters,
+			InstructionRecord& record) {
+		record.firstParam = params.size();
+		record.nParams = parameters.size();
+		for (auto& p : parameters) {
+			ParamRecord pr;
+			std::memset(&pr, 0, sizeof(ParamRecord));
+			pr.type = p.which();
+			switch (p.which()) {
+			case 0:
+				pr.real = boost::get<int>(p);
+				break;
+			case 1:
+				pr.real = boost::get<double>(p);
+				break;
+			case 2:
+				pr.real = boost::get<float>(p);
+				break;
+			case 3: {
+				auto str = boost::get<std::string>(p);
+				pr.strOffset = addString(str);
+				pr.strLength = str.length();
+				break;
+			}
+			default: {
+				auto c = boost::get<std::complex<double>>(p);
+				pr.real = c.real();
+				pr.imag = c.imag();
+			}
+			}
+			params.push_back(pr);
+		}
+	}
+
+	std::uint32_t addInstruction(std::shared_ptr<Instruction> inst) {
+		InstructionRecord record;
+		std::memset(&record, 0, sizeof(InstructionRecord));
+		auto idx = records.size();
+
+		auto found = writtenComposites.find(inst.get());
+		if (found != writtenComposites.end()) {
+			record.flags = Reference;
+			record.link = found->second;
+			records.push_back(record);
+			return idx;
+		}
+
+		auto name = inst->name();
+		record.nameOffset = addString(name);
+		record.nameLength = name.length();
+		record.flags = inst->isEnabled() ? Enabled : 0;
+
+		if (inst->isComposite()) {
+			auto function = std::dynamic_pointer_cast<Function>(inst);
+			record.flags |= Composite;
+			record.nChildren = function->nInstructions();
+			if (auto cond = std::dynamic_pointer_cast<ConditionalFunction>(inst)) {
+				record.flags |= Conditional;
+				record.nBits = 1;
+				record.bits[0] = cond->getConditionalQubit();
+			} else {
+				addParameters(function->getParameters(), record);
+			}
+			writtenComposites.insert(std::make_pair(inst.get(), idx));
+			records.push_back(record);
+			for (auto child : function->getInstructions()) {
+				addInstruction(child);
+			}
+			return idx;
+		}
+
+		auto bits = inst->bits();
+		if (bits.size() > 2) {
+			xacc::error("IBMKernelFile cannot persist instruction " + name
+					+ " acting on more than 2 qubits.");
+		}
+		record.nBits = bits.size();
+		for (int i = 0; i < bits.size(); i++) {
+			record.bits[i] = bits[i];
+		}
+		addParameters(inst->getParameters(), record);
+		records.push_back(record);
+		return idx;
+	}
+};
+
+class KernelFileReader {
+public:
+	const InstructionRecord* records;
+	const ParamRecord* params;
+	const char* strings;
+	std::uint32_t nRecords;
+	std::uint32_t nParams;
+	std::uint32_t nStringBytes;
+	std::shared_ptr<IRProvider> provider;
+	std::map<std::uint32_t, std::shared_ptr<Instruction>> builtComposites;
+
+	bool hasString(std::uint32_t offset, std::uint32_t length) {
+		return std::uint64_t(offset) + length <= nStringBytes;
+	}
+
+	std::string getString(std::uint32_t offset, std::uint32_t length) {
+		return std::string(strings + offset, length);
+	}
+
+	/**
+	 * Add the parameters of the given record to parameters,
+	 * returns false if they lie outside the file's tables.
+	 */
+	bool getParameters(const InstructionRecord& record,
+			std::vector<InstructionParameter>& parameters) {
+		if (std::uint64_t(record.firstParam) + record.nParams > nParams) {
+			return false;
+		}
+		for (std::uint32_t i = 0; i < record.nParams; i++) {
+			auto& pr = params[record.firstParam + i];
+			switch (pr.type) {
+			case 0:
+				parameters.push_back(InstructionParameter((int) pr.real));
+				break;
+			case 1:
+				parameters.push_back(InstructionParameter(pr.real));
+				break;
+			case 2:
+				parameters.push_back(InstructionParameter((float) pr.real));
+				break;
+			case 3:
+				if (!hasString(pr.strOffset, pr.strLength)) {
+					return false;
+				}
+				parameters.push_back(
+						InstructionParameter(getString(pr.strOffset, pr.strLength)));
+				break;
+			case 4:
+				parameters.push_back(
+						InstructionParameter(std::complex<double>(pr.real, pr.imag)));
+				break;
+			default:
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Rebuild the instruction at idx, leaving idx at the record
+	 * following its subtree. Returns null if the records are
+	 * malformed, eg an offset lies outside its table or a
+	 * reference does not point back at a composite.
+	 */
+	std::shared_ptr<Instruction> build(std::uint32_t& idx) {
+		if (idx >= nRecords) {
+			return nullptr;
+		}
+		auto recordIdx = idx++;
+		auto& record = records[recordIdx];
+
+		if (record.flags & Reference) {
+			auto found = builtComposites.find(record.link);
+			if (record.link >= recordIdx || found == builtComposites.end()) {
+				return nullptr;
+			}
+			return found->second;
+		}
+
+		if (!hasString(record.nameOffset, record.nameLength)
+				|| record.nBits > 2) {
+			return nullptr;
+		}
+
+		std::shared_ptr<Instruction> inst;
+		auto name = getString(record.nameOffset, record.nameLength);
+		std::vector<InstructionParameter> parameters;
+		if (!getParameters(record, parameters)) {
+			return nullptr;
+		}
+
+		if (record.flags & Composite) {
+			// Every child takes at least one record
+			if (record.nChildren > nRecords - idx) {
+				return nullptr;
+			}
+			std::shared_ptr<Function> function;
+			if (record.flags & Conditional) {
+				if (record.nBits != 1) {
+					return nullptr;
+				}
+				function = std::make_shared<ConditionalFunction>(record.bits[0]);
+			} else {
+				function = std::make_shared<GateFunction>(name, parameters);
+			}
+			for (std::uint32_t i = 0; i < record.nChildren; i++) {
+				auto child = build(idx);
+				if (!child) {
+					return nullptr;
+				}
+				function->addInstruction(child);
+			}
+
+			// Only finished composites can be referenced,
+			// so a composite can never contain itself
+			builtComposites.insert(std::make_pair(recordIdx, function));
+			inst = function;
+		} else {
+			std::vector<int> bits(record.bits, record.bits + record.nBits);
+			inst = provider->createInstruction(name, bits, parameters);
+		}
+
+		if (!(record.flags & Enabled)) {
+			inst->disable();
+		}
+		return inst;
+	}
+};
+
+}
+
+std::uint64_t IBMKernelFile::hash(const std::string& source) {
+	std::uint64_t h = 14695981039346656037ULL;
+	for (auto c : source) {
+		h ^= static_cast<unsigned char>(c);
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+std::uint32_t IBMKernelFile::formatVersion() {
+	return kernelFileVersion;
+}
+
+void IBMKernelFile::save(const std::uint64_t sourceHash,
+		std::vector<std::shared_ptr<Function>> functions,
+		std::vector<std::vector<int>> measured) {
+
+	KernelFileWriter writer;
+	std::vector<KernelRecord> kernelRecords;
+
+	for (int k = 0; k < functions.size(); k++) {
+		auto kernel = functions[k];
+		KernelRecord kr;
+		kr.record = writer.addInstruction(kernel);
+		kr.firstMeasured = writer.measured.size();
+
+		if (k < measured.size() && !measured[k].empty()) {
+			writer.measured.insert(writer.measured.end(), measured[k].begin(),
+					measured[k].end());
+		} else {
+			InstructionIterator it(kernel);
+			while (it.hasNext()) {
+				auto nextInst = it.next();
+				if (nextInst->isEnabled() && nextInst->name() == "Measure") {
+					writer.measured.push_back(nextInst->bits()[0]);
+				}
+			}
+		}
+
+		kr.nMeasured = writer.measured.size() - kr.firstMeasured;
+		kernelRecords.push_back(kr);
+	}
+
+	FileHeader header;
+	std::memset(&header, 0, sizeof(FileHeader));
+	std::memcpy(header.magic, kernelFileMagic, sizeof(kernelFileMagic));
+	header.version = kernelFileVersion;
+	header.nKernels = kernelRecords.size();
+	header.sourceHash = sourceHash;
+	header.nRecords = writer.records.size();
+	header.nParams = writer.params.size();
+	header.nMeasured = writer.measured.size();
+	header.nStringBytes = writer.strings.size();
+
+	std::ofstream out(_fileName, std::ios::binary | std::ios::trunc);
+	if (!out) {
+		xacc::error("Could not open " + _fileName + " for writing.");
+	}
+
+	out.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+	out.write(reinterpret_cast<const char*>(kernelRecords.data()),
+			kernelRecords.size() * sizeof(KernelRecord));
+	out.write(reinterpret_cast<const char*>(writer.records.data()),
+			writer.records.size() * sizeof(InstructionRecord));
+	out.write(reinterpret_cast<const char*>(writer.params.data()),
+			writer.params.size() * sizeof(ParamRecord));
+	out.write(reinterpret_cast<const char*>(writer.measured.data()),
+			writer.measured.size() * sizeof(std::int32_t));
+	out.write(writer.strings.data(), writer.strings.size());
+	out.close();
+
+	xacc::info("Wrote " + std::to_string(functions.size()) + " precompiled kernels to "
+			+ _fileName + ".");
+}
+
+bool IBMKernelFile::load(const std::uint64_t sourceHash) {
+
+	kernels.clear();
+	measuredQubits.clear();
+
+	int fd = open(_fileName.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < sizeof(FileHeader)) {
+		close(fd);
+		return false;
+	}
+
+	std::size_t fileSize = st.st_size;
+	void* data = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return false;
+	}
+
+	auto base = static_cast<const char*>(data);
+	auto header = reinterpret_cast<const FileHeader*>(base);
+
+	std::size_t expectedSize = sizeof(FileHeader)
+			+ header->nKernels * sizeof(KernelRecord)
+			+ header->nRecords * sizeof(InstructionRecord)
+			+ header->nParams * sizeof(ParamRecord)
+			+ header->nMeasured * sizeof(std::int32_t) + header->nStringBytes;
+
+	if (std::memcmp(header->magic, kernelFileMagic, sizeof(kernelFileMagic)) != 0
+			|| header->version != kernelFileVersion
+			|| header->sourceHash != sourceHash || expectedSize != fileSize) {
+		munmap(data, fileSize);
+		return false;
+	}
+
+	auto offset = sizeof(FileHeader);
+	auto kernelRecords = reinterpret_cast<const KernelRecord*>(base + offset);
+	offset += header->nKernels * sizeof(KernelRecord);
+
+	KernelFileReader reader;
+	reader.records = reinterpret_cast<const InstructionRecord*>(base + offset);
+	offset += header->nRecords * sizeof(InstructionRecord);
+	reader.params = reinterpret_cast<const ParamRecord*>(base + offset);
+	offset += header->nParams * sizeof(ParamRecord);
+	auto measured = reinterpret_cast<const std::int32_t*>(base + offset);
+	offset += header->nMeasured * sizeof(std::int32_t);
+	reader.strings = base + offset;
+	reader.provider = xacc::getService<IRProvider>("gate");
+
+	reader.nRecords = header->nRecords;
+	reader.nParams = header->nParams;
+	reader.nStringBytes = header->nStringBytes;
+
+	for (std::uint32_t i = 0; i < header->nKernels; i++) {
+		auto& kr = kernelRecords[i];
+		auto idx = kr.record;
+		auto kernel = std::dynamic_pointer_cast<Function>(reader.build(idx));
+		if (!kernel || std::uint64_t(kr.firstMeasured) + kr.nMeasured
+				> header->nMeasured) {
+			kernels.clear();
+			measuredQubits.clear();
+			munmap(data, fileSize);
+			xacc::info(_fileName + " is malformed, ignoring it.");
+			return false;
+		}
+		kernels.push_back(kernel);
+		measuredQubits.push_back(
+				std::vector<int>(measured + kr.firstMeasured,
+						measured + kr.firstMeasured + kr.nMeasured));
+	}
+
+	munmap(data, fileSize);
+
+	xacc::info("Loaded " + std::to_string(kernels.size()) + " precompiled kernels from "
+			+ _fileName + ".");
+	return true;
+}
+
+}
+}
@@ -0,0 +1,126 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#ifndef ACCELERATOR_IBMKERNELFILE_HPP_
+#define ACCELERATOR_IBMKERNELFILE_HPP_
+
+#include "Function.hpp"
+#include <cstdint>
+
+namespace xacc {
+namespace quantum {
+
+/**
+ * The IBMKernelFile persists lowered and transformed XACC
+ * kernels to a compact binary file, so that later processes
+ * can skip Program::build() and submit the kernels directly.
+ *
+ * The file holds a header with the hash of the source code
+ * the kernels were compiled from, a table of kernels, flat
+ * instruction records, parameter slots, measured-qubit tables
+ * and a string pool. GateFunctions shared by several kernels
+ * are written once and shared again when loaded.
+ *
+ * Files are read back by mapping them into memory, and are
+ * only accepted if the stored source hash matches and every
+ * offset and index in them lies within its table.
+ */
+class IBMKernelFile {
+
+public:
+
+	/**
+	 * The Constructor, takes the name of the file
+	 * to save to or load from.
+	 */
+	IBMKernelFile(const std::string& fileName) : _fileName(fileName) {
+	}
+
+	/**
+	 * Return a 64 bit FNV-1a hash of the given source code.
+	 */
+	static std::uint64_t hash(const std::string& source);
+
+	/**
+	 * Return the version of the format written by save.
+	 */
+	static std::uint32_t formatVersion();
+
+	/**
+	 * Write the given kernels to this file, tagged
+	 * with the given source hash.
+	 *
+	 * @param sourceHash The hash of the source the kernels were compiled from
+	 * @param kernels The (transformed) kernels to persist
+	 * @param measured The logical qubit read by each measurement of each kernel,
+	 * for kernels without an entry the qubits of their Measure instructions
+	 */
+	void save(const std::uint64_t sourceHash,
+			std::vector<std::shared_ptr<Function>> kernels,
+			std::vector<std::vector<int>> measured = std::vector<
+					std::vector<int>> { });
+
+	/**
+	 * Map this file and rebuild its kernels. Returns false
+	 * if the file does not exist, is malformed, or was
+	 * written for a different source hash.
+	 *
+	 * @param sourceHash The hash of the current source code
+	 * @return loaded True if the kernels were loaded
+	 */
+	bool load(const std::uint64_t sourceHash);
+
+	/**
+	 * Return the kernels rebuilt by load().
+	 */
+	std::vector<std::shared_ptr<Function>> getKernels() {
+		return kernels;
+	}
+
+	/**
+	 * Return the qubits measured by the kernel at the given index.
+	 */
+	std::vector<int> getMeasuredQubits(const int kernelIdx) {
+		return measuredQubits[kernelIdx];
+	}
+
+protected:
+
+	std::string _fileName;
+
+	std::vector<std::shared_ptr<Function>> kernels;
+
+	std::vector<std::vector<int>> measuredQubits;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,447 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#ifndef ACCELERATOR_IBMKERNELUTILS_HPP_
+#define ACCELERATOR_IBMKERNELUTILS_HPP_
+
+#include "GateFunction.hpp"
+#include "ConditionalFunction.hpp"
+#include "InstructionIterator.hpp"
+#include "IRProvider.hpp"
+#include "IBMCompilationContext.hpp"
+#include "XACC.hpp"
+#include <algorithm>
+#include <cctype>
+#include <queue>
+#include <set>
+#include <limits>
+
+namespace xacc {
+namespace quantum {
+
+/**
+ * Return true if the given kernel contains no conditional
+ * branches, so that its instructions can be flattened
+ * and its qubits moved freely.
+ */
+inline bool isFlattenable(std::shared_ptr<Function> kernel) {
+	InstructionIterator it(kernel);
+	while (it.hasNext()) {
+		if (std::dynamic_pointer_cast<ConditionalFunction>(it.next())) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Return the enabled, non-composite instructions
+ * of the given kernel in program order.
+ */
+inline std::vector<std::shared_ptr<Instruction>> flattenKernel(
+		std::shared_ptr<Function> kernel) {
+	std::vector<std::shared_ptr<Instruction>> flat;
+	InstructionIterator it(kernel);
+	while (it.hasNext()) {
+		auto nextInst = it.next();
+		if (!nextInst->isComposite() && nextInst->isEnabled()) {
+			flat.push_back(nextInst);
+		}
+	}
+	return flat;
+}
+
+/**
+ * Return a new instruction with the name and parameters
+ * of the given one, acting on the given qubits.
+ */
+inline std::shared_ptr<Instruction> remapInstruction(
+		std::shared_ptr<IRProvider> provider, std::shared_ptr<Instruction> inst,
+		const std::vector<int>& bits) {
+	return provider->createInstruction(inst->name(), bits,
+			inst->getParameters());
+}
+
+/**
+ * Return an empty GateFunction with the name
+ * and parameters of the given kernel.
+ */
+inline std::shared_ptr<Function> emptyCopy(std::shared_ptr<Function> kernel) {
+	return std::make_shared<GateFunction>(kernel->name(),
+			kernel->getParameters());
+}
+
+/**
+ * Instructions to their copies bound to some parameter values
+ */
+using BoundInstructions = std::map<std::shared_ptr<Instruction>,
+		std::shared_ptr<Instruction>>;
+
+/**
+ * Return a copy of the given instruction tree with every string
+ * parameter that names one of the given values, or its negation,
+ * replaced by the value. Instructions already bound to the same
+ * values are looked up in bound, so kernels calling the same
+ * state preparation share its bound copy.
+ */
+inline std::shared_ptr<Instruction> bindInstruction(
+		std::shared_ptr<IRProvider> provider, std::shared_ptr<Instruction> inst,
+		const std::map<std::string, double>& values, BoundInstructions& bound) {
+	auto cached = bound.find(inst);
+	if (cached != bound.end()) {
+		return cached->second;
+	}
+
+	std::shared_ptr<Instruction> copy;
+	if (auto conditional = std::dynamic_pointer_cast<ConditionalFunction>(inst)) {
+		auto function = std::make_shared<ConditionalFunction>(
+				conditional->getConditionalQubit());
+		for (auto child : conditional->getInstructions()) {
+			function->addInstruction(
+					bindInstruction(provider, child, values, bound));
+		}
+		copy = function;
+	} else if (auto composite = std::dynamic_pointer_cast<Function>(inst)) {
+		auto function = emptyCopy(composite);
+		for (auto child : composite->getInstructions()) {
+			if (child->isEnabled()) {
+				function->addInstruction(
+						bindInstruction(provider, child, values, bound));
+			}
+		}
+		copy = function;
+	} else {
+		auto params = inst->getParameters();
+		for (auto& p : params) {
+			if (p.which() != 3) {
+				continue;
+			}
+			auto name = boost::get<std::string>(p);
+			bool negate = !name.empty() && name[0] == '-';
+			auto value = values.find(negate ? name.substr(1) : name);
+			if (value != values.end()) {
+				p = negate ? -value->second : value->second;
+			}
+		}
+		copy = provider->createInstruction(inst->name(), inst->bits(), params);
+	}
+
+	bound.insert(std::make_pair(inst, copy));
+	return copy;
+}
+
+/**
+ * Return a copy of the given kernel with its parameters, in
+ * order, bound to the given values, one per parameter. The kernel
+ * is left as is. Copies are shared through bound, keyed by the
+ * named values.
+ */
+inline std::shared_ptr<Function> bindKernel(std::shared_ptr<IRProvider> provider,
+		std::shared_ptr<Function> kernel, const std::vector<double>& values,
+		std::map<std::map<std::string, double>, BoundInstructions>& bound) {
+	std::map<std::string, double> named;
+	auto params = kernel->getParameters();
+	if (params.size() != values.size()) {
+		xacc::error("Cannot bind " + std::to_string(values.size())
+				+ " values to the " + std::to_string(params.size())
+				+ " parameters of " + kernel->name() + ".");
+	}
+	for (int i = 0; i < params.size(); i++) {
+		if (params[i].which() == 3) {
+			named[boost::get<std::string>(params[i])] = values[i];
+		}
+	}
+
+	auto copy = emptyCopy(kernel);
+	for (auto inst : kernel->getInstructions()) {
+		if (inst->isEnabled()) {
+			copy->addInstruction(
+					bindInstruction(provider, inst, named, bound[named]));
+		}
+	}
+	return copy;
+}
+
+/**
+ * Return a copy of the given instruction tree bound to the given
+ * values, as bindInstruction does, with the instruction at the
+ * given path of child indices, from depth on, replaced by
+ * replacement. Only the composites on the path are copied anew,
+ * the rest are shared through bound.
+ */
+inline std::shared_ptr<Instruction> bindPath(
+		std::shared_ptr<IRProvider> provider, std::shared_ptr<Instruction> inst,
+		const std::vector<int>& path, const int depth,
+		std::shared_ptr<Instruction> replacement,
+		const std::map<std::string, double>& values, BoundInstructions& bound) {
+	if (depth == path.size()) {
+		return replacement;
+	}
+
+	auto composite = std::dynamic_pointer_cast<Function>(inst);
+	auto conditional = std::dynamic_pointer_cast<ConditionalFunction>(inst);
+	std::shared_ptr<Function> function;
+	if (conditional) {
+		function = std::make_shared<ConditionalFunction>(
+				conditional->getConditionalQubit());
+	} else {
+		function = emptyCopy(composite);
+	}
+
+	auto children = composite->getInstructions();
+	for (int i = 0; i < children.size(); i++) {
+		if (i == path[depth]) {
+			function->addInstruction(
+					bindPath(provider, children[i], path, depth + 1,
+							replacement, values, bound));
+		} else if (conditional || children[i]->isEnabled()) {
+			function->addInstruction(
+					bindInstruction(provider, children[i], values, bound));
+		}
+	}
+	return function;
+}
+
+/**
+ * Return true if the given parameter expression, eg 2*theta,
+ * contains the given variable name as an identifier.
+ */
+inline bool mentionsVariable(const std::string& expression,
+		const std::string& name) {
+	auto isIdentifier = [](const char c) {
+		return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+	};
+	for (auto pos = expression.find(name); pos != std::string::npos;
+			pos = expression.find(name, pos + 1)) {
+		auto end = pos + name.size();
+		if ((pos == 0 || !isIdentifier(expression[pos - 1]))
+				&& (end == expression.size() || !isIdentifier(expression[end]))) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Return 'z' or 'x' if the given gate is diagonal in the Z
+ * or X basis on the given qubit, 'i' if it does not act on
+ * it, and 0 otherwise.
+ */
+inline char gateBasis(std::shared_ptr<Instruction> inst, const int qubit) {
+	auto bits = inst->bits();
+	auto position = std::find(bits.begin(), bits.end(), qubit);
+	if (position == bits.end()) {
+		return 'i';
+	}
+
+	auto name = inst->name();
+	if (name == "Z" || name == "Rz" || name == "CZ" || name == "CPhase"
+			|| (name == "CNOT" && position == bits.begin())) {
+		return 'z';
+	}
+	if (name == "X" || name == "Rx" || name == "CNOT") {
+		return 'x';
+	}
+	return 0;
+}
+
+/**
+ * Return true if the given gates are known to commute, that is
+ * if on every qubit they share both are diagonal in the Z basis
+ * (Z, Rz, CZ, CPhase, CNOT control) or both are diagonal in the
+ * X basis (X, Rx, CNOT target).
+ */
+inline bool gatesCommute(std::shared_ptr<Instruction> a,
+		std::shared_ptr<Instruction> b) {
+	for (auto q : a->bits()) {
+		auto bBasis = gateBasis(b, q);
+		if (bBasis == 'i') {
+			continue;
+		}
+		auto aBasis = gateBasis(a, q);
+		if (aBasis == 0 || aBasis != bBasis) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Return a copy of the given composite without the leaves whose
+ * entry of keep, indexed in program order from idx on, is false.
+ * Composites that lose no gate are returned as is, so calls of
+ * a shared GateFunction outside the pruned region stay shared.
+ */
+inline std::shared_ptr<Function> pruneComposite(
+		std::shared_ptr<Function> composite, const std::vector<bool>& keep,
+		int& idx) {
+	std::vector<std::shared_ptr<Instruction>> children;
+	bool changed = false;
+	for (auto child : composite->getInstructions()) {
+		if (child->isComposite()) {
+			auto pruned = pruneComposite(
+					std::dynamic_pointer_cast<Function>(child), keep, idx);
+			changed = changed || pruned != child;
+			children.push_back(pruned);
+		} else if (!child->isEnabled() || keep[idx++]) {
+			children.push_back(child);
+		} else {
+			changed = true;
+		}
+	}
+	if (!changed) {
+		return composite;
+	}
+
+	auto pruned = emptyCopy(composite);
+	for (auto child : children) {
+		pruned->addInstruction(child);
+	}
+	return pruned;
+}
+
+/**
+ * Return the given kernel without the gates outside the backward
+ * light cone of its measurements, that is the gates that cannot
+ * affect any measured qubit, and add the number of dropped gates
+ * to nPruned. Returns the kernel itself if nothing can be dropped,
+ * or if it has conditional branches. Only the composites that
+ * lose gates are copied.
+ */
+inline std::shared_ptr<Function> lightConeKernel(
+		std::shared_ptr<Function> kernel, int& nPruned) {
+	if (!isFlattenable(kernel)) {
+		return kernel;
+	}
+
+	auto instructions = flattenKernel(kernel);
+	bool measures = std::any_of(instructions.begin(), instructions.end(),
+			[](std::shared_ptr<Instruction> inst) {
+				return inst->name() == "Measure";
+			});
+	if (!measures) {
+		return kernel;
+	}
+
+	// Walk backwards, a gate is in the cone if it touches
+	// a qubit that is measured later, and then so are
+	// all of its qubits
+	std::set<int> cone;
+	std::vector<bool> keep(instructions.size(), false);
+	int nDropped = 0;
+	for (int i = instructions.size() - 1; i >= 0; i--) {
+		auto bits = instructions[i]->bits();
+		if (instructions[i]->name() == "Measure"
+				|| std::any_of(bits.begin(), bits.end(),
+						[&](int b) {return cone.count(b) > 0;})) {
+			keep[i] = true;
+			cone.insert(bits.begin(), bits.end());
+		} else {
+			nDropped++;
+		}
+	}
+
+	if (nDropped == 0) {
+		return kernel;
+	}
+
+	int idx = 0;
+	nPruned += nDropped;
+	return pruneComposite(kernel, keep, idx);
+}
+
+/**
+ * Return the gate count, two qubit gate count and depth
+ * of the enabled instructions of the given kernel.
+ */
+inline IBMCircuitStatistics computeStatistics(std::shared_ptr<Function> kernel) {
+	IBMCircuitStatistics stats;
+	std::map<int, int> qubitDepths;
+	InstructionIterator it(kernel);
+	while (it.hasNext()) {
+		auto nextInst = it.next();
+		if (nextInst->isComposite() || !nextInst->isEnabled()) {
+			continue;
+		}
+		auto bits = nextInst->bits();
+		stats.nGates++;
+		if (bits.size() == 2) {
+			stats.nTwoQubitGates++;
+		}
+		int layer = 0;
+		for (auto b : bits) {
+			layer = std::max(layer, qubitDepths[b]);
+		}
+		for (auto b : bits) {
+			qubitDepths[b] = layer + 1;
+		}
+		stats.depth = std::max(stats.depth, layer + 1);
+	}
+	return stats;
+}
+
+/**
+ * Return the row-major nQubits x nQubits matrix of shortest
+ * path lengths in the undirected graph of the given couplers.
+ * Unconnected pairs are given a very large distance.
+ */
+inline std::vector<int> allPairsDistances(
+		const std::vector<std::pair<int, int>>& couplers, const int nQubits) {
+	std::vector<std::vector<int>> neighbors(nQubits);
+	for (auto c : couplers) {
+		neighbors[c.first].push_back(c.second);
+		neighbors[c.second].push_back(c.first);
+	}
+
+	// Breadth first search from every qubit
+	auto unreachable = std::numeric_limits<int>::max() / 2;
+	std::vector<int> distances(nQubits * nQubits, unreachable);
+	for (int s = 0; s < nQubits; s++) {
+		std::queue<int> queue;
+		distances[s * nQubits + s] = 0;
+		queue.push(s);
+		while (!queue.empty()) {
+			auto p = queue.front();
+			queue.pop();
+			for (auto n : neighbors[p]) {
+				if (distances[s * nQubits + n] == unreachable) {
+					distances[s * nQubits + n] = distances[s * nQubits + p] + 1;
+					queue.push(n);
+				}
+			}
+		}
+	}
+	return distances;
+}
+
+}
+}
+
+#endif
@@ -0,0 +1,103 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#ifndef ACCELERATOR_IBMPASSINSTRUMENTATION_HPP_
+#define ACCELERATOR_IBMPASSINSTRUMENTATION_HPP_
+
+#include "IRTransformation.hpp"
+#include "IBMKernelUtils.hpp"
+#include "XACC.hpp"
+
+namespace xacc {
+namespace quantum {
+
+/**
+ * The IBMPassInstrumentation is an IRTransformation that runs
+ * another one and records, per kernel, the gate count, two qubit
+ * gate count and depth before and after it in the
+ * IBMCompilationContext, and hands the records of each
+ * kernel on to the kernel that replaces it. The IBMAccelerator
+ * reports them once per submitted batch.
+ */
+class IBMPassInstrumentation: public IRTransformation {
+
+protected:
+
+	std::shared_ptr<IRTransformation> pass;
+
+	std::shared_ptr<IBMCompilationContext> context;
+
+public:
+
+	IBMPassInstrumentation(std::shared_ptr<IRTransformation> transformation,
+			std::shared_ptr<IBMCompilationContext> ctx) :
+			pass(transformation), context(ctx) {
+	}
+
+	virtual std::shared_ptr<IR> transform(std::shared_ptr<IR> ir) {
+		auto kernels = ir->getKernels();
+		std::vector<IBMCircuitStatistics> before;
+		for (auto kernel : kernels) {
+			before.push_back(computeStatistics(kernel));
+		}
+
+		auto newir = pass->transform(ir);
+
+		// Transformations keep the kernels in order, each
+		// replacement inherits the records of its kernel
+		auto newKernels = newir->getKernels();
+		for (int i = 0; i < newKernels.size(); i++) {
+			auto kernel = newKernels[i];
+			IBMPassStatistics stats;
+			stats.pass = pass->name();
+			stats.after = computeStatistics(kernel);
+			if (i < kernels.size()) {
+				context->inherit(kernels[i], kernel);
+				stats.before = before[i];
+			}
+			context->recordPassStatistics(kernel, stats);
+		}
+
+		return newir;
+	}
+
+	virtual const std::string name() const {
+		return pass->name();
+	}
+
+	virtual const std::string description() const {
+		return pass->description();
+	}
+};
+
+}
+}
+
+#endif
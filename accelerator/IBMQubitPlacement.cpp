@@ -0,0 +1,325 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#include "IBMQubitPlacement.hpp"
+#include "XACC.hpp"
+#include <random>
+#include <functional>
+#include <sstream>
+#include <cmath>
+
+namespace xacc {
+namespace quantum {
+
+std::shared_ptr<IR> IBMQubitPlacement::transform(std::shared_ptr<IR> ir) {
+
+	xacc::info("Executing IBM Qubit Placement - Choosing initial qubit layouts.");
+
+	auto provider = xacc::getService<IRProvider>("gate");
+	auto newir = provider->createIR();
+
+	for (auto kernel : ir->getKernels()) {
+		if (!isFlattenable(kernel)) {
+			xacc::info("Not placing " + kernel->name()
+					+ ", it contains conditional branches.");
+			newir->addKernel(kernel);
+			continue;
+		}
+
+		auto instructions = flattenKernel(kernel);
+
+		int nLogicalQubits = 0;
+		std::map<std::pair<int, int>, int> interactions;
+		std::vector<int> measuredQubits;
+		for (auto inst : instructions) {
+			auto bits = inst->bits();
+			for (auto b : bits) {
+				nLogicalQubits = std::max(nLogicalQubits, b + 1);
+			}
+			if (bits.size() == 2) {
+				interactions[std::make_pair(std::min(bits[0], bits[1]),
+						std::max(bits[0], bits[1]))]++;
+			}
+			if (inst->name() == "Measure") {
+				measuredQubits.push_back(bits[0]);
+			}
+		}
+
+		if (nLogicalQubits > nPhysicalQubits) {
+			xacc::error(kernel->name() + " needs " + std::to_string(nLogicalQubits)
+					+ " qubits, the backend only has "
+					+ std::to_string(nPhysicalQubits));
+		}
+
+		auto placement = place(nLogicalQubits, interactions);
+
+		// The identity placement keeps the kernel as it is, with
+		// its composites, eg a shared state preparation, intact
+		bool identity = true;
+		for (int i = 0; i < nLogicalQubits; i++) {
+			identity = identity && placement[i] == i;
+		}
+		if (identity) {
+			xacc::info("Placed " + kernel->name() + " on the identity.");
+			newir->addKernel(kernel);
+			continue;
+		}
+
+		auto placed = emptyCopy(kernel);
+		for (auto inst : instructions) {
+			std::vector<int> bits;
+			for (auto b : inst->bits()) {
+				bits.push_back(placement[b]);
+			}
+			placed->addInstruction(remapInstruction(provider, inst, bits));
+		}
+
+		std::stringstream ss;
+		for (int i = 0; i < nLogicalQubits; i++) {
+			ss << i << "->" << placement[i] << " ";
+		}
+		xacc::info("Placed " + kernel->name() + ": " + ss.str()
+				+ "(routing cost " + std::to_string(cost(placement, interactions))
+				+ ")");
+
+		context->inherit(kernel, placed);
+		context->recordMeasuredQubits(placed, measuredQubits);
+		context->composeLayout(placed, placement);
+		newir->addKernel(placed);
+	}
+
+	return newir;
+}
+
+int IBMQubitPlacement::cost(const std::vector<int>& placement,
+		const std::map<std::pair<int, int>, int>& interactions) {
+	int total = 0;
+	for (auto& kv : interactions) {
+		total += kv.second
+				* (topology->distance(placement[kv.first.first],
+						placement[kv.first.second]) - 1);
+	}
+	return total;
+}
+
+std::vector<int> IBMQubitPlacement::place(const int nLogicalQubits,
+		const std::map<std::pair<int, int>, int>& interactions) {
+
+	// Start from the identity, which covers every physical qubit
+	std::vector<int> placement(nPhysicalQubits);
+	for (int i = 0; i < nPhysicalQubits; i++) {
+		placement[i] = i;
+	}
+
+	if (interactions.empty()) {
+		return placement;
+	}
+
+	std::set<int> qubits;
+	std::set<std::pair<int, int>> edges;
+	for (auto& kv : interactions) {
+		qubits.insert(kv.first.first);
+		qubits.insert(kv.first.second);
+		edges.insert(kv.first);
+	}
+
+	auto embedding = findEmbedding(qubits, edges, *topology, false);
+	if (!embedding.empty()) {
+		// Complete the embedding into a permutation
+		std::set<int> usedPhysical;
+		for (auto& kv : embedding) {
+			usedPhysical.insert(kv.second);
+		}
+		int nextFree = 0;
+		for (int l = 0; l < nPhysicalQubits; l++) {
+			if (embedding.count(l)) {
+				placement[l] = embedding[l];
+				continue;
+			}
+			while (usedPhysical.count(nextFree)) {
+				nextFree++;
+			}
+			placement[l] = nextFree++;
+		}
+		return placement;
+	}
+
+	// No exact embedding, anneal. Moves swap the physical
+	// qubits of an interacting logical qubit and any other
+	// logical qubit (used or not).
+	std::vector<int> interacting(qubits.begin(), qubits.end());
+	std::mt19937 gen(0);
+	std::uniform_int_distribution<int> pickInteracting(0, interacting.size() - 1);
+	std::uniform_int_distribution<int> pickAny(0, nPhysicalQubits - 1);
+	std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+	auto current = cost(placement, interactions);
+	auto best = placement;
+	auto bestCost = current;
+
+	int nSteps = 2000 * interacting.size();
+	double temperature = 2.0, cooling = std::pow(0.01 / temperature, 1.0 / nSteps);
+	for (int step = 0; step < nSteps && bestCost > 0; step++) {
+		auto a = interacting[pickInteracting(gen)];
+		auto b = pickAny(gen);
+		if (a == b) {
+			continue;
+		}
+
+		std::swap(placement[a], placement[b]);
+		auto proposed = cost(placement, interactions);
+		auto delta = proposed - current;
+		if (delta <= 0 || uniform(gen) < std::exp(-delta / temperature)) {
+			current = proposed;
+			if (current < bestCost) {
+				bestCost = current;
+				best = placement;
+			}
+		} else {
+			std::swap(placement[a], placement[b]);
+		}
+		temperature *= cooling;
+	}
+
+	return best;
+}
+
+std::map<int, int> IBMQubitPlacement::findEmbedding(const std::set<int>& qubits,
+		const std::set<std::pair<int, int>>& edges,
+		const IBMBackendTopology& topology, const bool directed,
+		const std::set<int>& unavailable, const int maxSteps) {
+
+	int nPhysical = topology.size();
+	auto coupled = [&](int src, int tgt) {
+		return directed ?
+				topology.isCoupled(src, tgt) : topology.isAdjacent(src, tgt);
+	};
+	std::vector<int> physicalDegree(nPhysical, 0);
+	for (int p = 0; p < nPhysical; p++) {
+		physicalDegree[p] = topology.neighbors(p).count();
+	}
+
+	std::map<int, std::vector<int>> logicalNeighbors;
+	for (auto e : edges) {
+		logicalNeighbors[e.first].push_back(e.second);
+		logicalNeighbors[e.second].push_back(e.first);
+	}
+
+	// Order the qubits breadth first from the highest degree
+	// one, so each qubit after the first of its component has
+	// an already mapped neighbor that constrains it.
+	std::vector<int> order;
+	std::set<int> seen;
+	while (order.size() < qubits.size()) {
+		int start = -1;
+		for (auto q : qubits) {
+			if (!seen.count(q) && (start < 0
+					|| logicalNeighbors[q].size() > logicalNeighbors[start].size())) {
+				start = q;
+			}
+		}
+		std::queue<int> queue;
+		queue.push(start);
+		seen.insert(start);
+		while (!queue.empty()) {
+			auto q = queue.front();
+			queue.pop();
+			order.push_back(q);
+			for (auto n : logicalNeighbors[q]) {
+				if (!seen.count(n)) {
+					seen.insert(n);
+					queue.push(n);
+				}
+			}
+		}
+	}
+
+	std::map<int, int> mapping;
+	std::vector<bool> used(nPhysical, false);
+	for (auto u : unavailable) {
+		if (u < nPhysical) {
+			used[u] = true;
+		}
+	}
+
+	int steps = 0;
+	std::function<bool(int)> search = [&](int depth) -> bool {
+		if (depth == order.size()) {
+			return true;
+		}
+		auto q = order[depth];
+		for (int p = 0; p < nPhysical; p++) {
+			if (used[p] || physicalDegree[p] < logicalNeighbors[q].size()) {
+				continue;
+			}
+			if (++steps > maxSteps) {
+				return false;
+			}
+
+			bool consistent = true;
+			for (auto n : logicalNeighbors[q]) {
+				auto mapped = mapping.find(n);
+				if (mapped == mapping.end()) {
+					continue;
+				}
+				if ((edges.count(std::make_pair(q, n))
+						&& !coupled(p, mapped->second))
+						|| (edges.count(std::make_pair(n, q))
+								&& !coupled(mapped->second, p))) {
+					consistent = false;
+					break;
+				}
+			}
+			if (!consistent) {
+				continue;
+			}
+
+			mapping[q] = p;
+			used[p] = true;
+			if (search(depth + 1)) {
+				return true;
+			}
+			used[p] = false;
+			mapping.erase(q);
+			if (steps > maxSteps) {
+				return false;
+			}
+		}
+		return false;
+	};
+
+	if (!search(0)) {
+		return std::map<int, int> { };
+	}
+	return mapping;
+}
+
+}
+}
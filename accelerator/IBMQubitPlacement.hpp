@@ -0,0 +1,123 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#ifndef ACCELERATOR_IBMQUBITPLACEMENT_HPP_
+#define ACCELERATOR_IBMQUBITPLACEMENT_HPP_
+
+#include "IRTransformation.hpp"
+#include "IBMCompilationContext.hpp"
+#include "IBMKernelUtils.hpp"
+#include "IBMBackendTopology.hpp"
+#include <set>
+
+namespace xacc {
+namespace quantum {
+
+/**
+ * The IBMQubitPlacement chooses the initial physical qubit
+ * for every logical qubit of a kernel, before routing.
+ *
+ * It builds the kernel's interaction graph from its two qubit
+ * gates and first searches for a subgraph isomorphism onto the
+ * backend's coupling graph, which needs no routing at all. If
+ * there is none, it anneals the mapping to minimize the weighted
+ * distance between interacting qubits.
+ *
+ * Kernels are flattened and relabeled onto the chosen physical
+ * qubits, and the layout and measured logical qubits are recorded
+ * in the IBMCompilationContext.
+ */
+class IBMQubitPlacement: public IRTransformation {
+
+protected:
+
+	std::shared_ptr<IBMBackendTopology> topology;
+
+	int nPhysicalQubits = 0;
+
+	std::shared_ptr<IBMCompilationContext> context;
+
+	/**
+	 * Return the placement of the given logical qubits, indexed
+	 * by logical qubit, that minimizes routing overhead for the
+	 * given weighted interaction edges.
+	 */
+	std::vector<int> place(const int nLogicalQubits,
+			const std::map<std::pair<int, int>, int>& interactions);
+
+	/**
+	 * Return the weighted routing distance of the given placement.
+	 */
+	int cost(const std::vector<int>& placement,
+			const std::map<std::pair<int, int>, int>& interactions);
+
+public:
+
+	IBMQubitPlacement(std::shared_ptr<IBMBackendTopology> backendTopology,
+			std::shared_ptr<IBMCompilationContext> ctx =
+					std::make_shared<IBMCompilationContext>()) :
+			topology(backendTopology), nPhysicalQubits(backendTopology->size()), context(
+					ctx) {
+	}
+
+	IBMQubitPlacement(std::vector<std::pair<int, int>> couplers,
+			std::shared_ptr<IBMCompilationContext> ctx =
+					std::make_shared<IBMCompilationContext>()) :
+			IBMQubitPlacement(std::make_shared<IBMBackendTopology>(couplers), ctx) {
+	}
+
+	virtual std::shared_ptr<IR> transform(std::shared_ptr<IR> ir);
+
+	/**
+	 * Search for an injective map of the given qubits onto the
+	 * physical qubits of the given topology such that every edge
+	 * lands on a coupled pair. If directed, the edge (a,b) must map
+	 * onto the coupler (p(a),p(b)) itself. Physical qubits in
+	 * unavailable are never used. Returns an empty map if no
+	 * embedding is found within the given number of search steps.
+	 */
+	static std::map<int, int> findEmbedding(const std::set<int>& qubits,
+			const std::set<std::pair<int, int>>& edges,
+			const IBMBackendTopology& topology, const bool directed, const std::set<int>& unavailable =
+					std::set<int> { }, const int maxSteps = 100000);
+
+	virtual const std::string name() const {
+		return "ibm-qubit-placement";
+	}
+
+	virtual const std::string description() const {
+		return "Map logical qubits onto physical qubits to minimize routing.";
+	}
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,196 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#include "IBMQubitRouter.hpp"
+#include "XACC.hpp"
+#include <limits>
+
+namespace xacc {
+namespace quantum {
+
+IBMQubitRouter::IBMQubitRouter(
+		std::shared_ptr<IBMBackendTopology> backendTopology,
+		std::shared_ptr<IBMCompilationContext> ctx, const int lookaheadGates) :
+		nPhysicalQubits(backendTopology->size()), topology(backendTopology), context(
+				ctx), lookahead(lookaheadGates) {
+}
+
+std::shared_ptr<IR> IBMQubitRouter::transform(std::shared_ptr<IR> ir) {
+
+	xacc::info("Executing IBM Qubit Router - Inserting SWAPs for uncoupled gates.");
+
+	auto provider = xacc::getService<IRProvider>("gate");
+	auto newir = provider->createIR();
+
+	nSwaps = 0;
+	for (auto kernel : ir->getKernels()) {
+		if (!isFlattenable(kernel)) {
+			xacc::info("Not routing " + kernel->name()
+					+ ", it contains conditional branches.");
+			newir->addKernel(kernel);
+			continue;
+		}
+		newir->addKernel(route(kernel, provider));
+	}
+
+	xacc::info("IBM Qubit Router inserted " + std::to_string(nSwaps) + " SWAPs.");
+	return newir;
+}
+
+std::shared_ptr<Function> IBMQubitRouter::route(std::shared_ptr<Function> kernel,
+		std::shared_ptr<IRProvider> provider) {
+
+	auto instructions = flattenKernel(kernel);
+	auto routed = emptyCopy(kernel);
+	auto before = nSwaps;
+
+	// virtualToPhysical maps the qubit indices of the incoming
+	// kernel onto physical qubits, physicalToVirtual is its inverse
+	std::vector<int> virtualToPhysical(nPhysicalQubits), physicalToVirtual(
+			nPhysicalQubits);
+	for (int i = 0; i < nPhysicalQubits; i++) {
+		virtualToPhysical[i] = i;
+		physicalToVirtual[i] = i;
+	}
+
+	// Positions of the two qubit gates, for the lookahead
+	std::vector<int> twoQubitGates;
+	for (int i = 0; i < instructions.size(); i++) {
+		for (auto b : instructions[i]->bits()) {
+			if (b >= nPhysicalQubits) {
+				xacc::error(kernel->name() + " uses qubit " + std::to_string(b)
+						+ ", the backend only has " + std::to_string(nPhysicalQubits));
+			}
+		}
+		if (instructions[i]->bits().size() == 2) {
+			twoQubitGates.push_back(i);
+		} else if (instructions[i]->bits().size() > 2) {
+			xacc::error("IBMQubitRouter cannot route " + instructions[i]->name());
+		}
+	}
+
+	std::vector<int> measuredQubits;
+	auto swapOn = [&](int p, int q) {
+		routed->addInstruction(provider->createInstruction("CNOT", std::vector<int> {p, q}));
+		routed->addInstruction(provider->createInstruction("CNOT", std::vector<int> {q, p}));
+		routed->addInstruction(provider->createInstruction("CNOT", std::vector<int> {p, q}));
+		std::swap(physicalToVirtual[p], physicalToVirtual[q]);
+		virtualToPhysical[physicalToVirtual[p]] = p;
+		virtualToPhysical[physicalToVirtual[q]] = q;
+		nSwaps++;
+	};
+
+	int nextTwoQubitGate = 0;
+	for (int i = 0; i < instructions.size(); i++) {
+		auto inst = instructions[i];
+		auto bits = inst->bits();
+
+		if (inst->name() == "Measure") {
+			measuredQubits.push_back(bits[0]);
+		}
+
+		if (bits.size() == 2) {
+			nextTwoQubitGate++;
+			auto a = bits[0], b = bits[1];
+			if (distance(virtualToPhysical[a], virtualToPhysical[b])
+					>= nPhysicalQubits) {
+				xacc::error("Qubits " + std::to_string(a) + " and "
+						+ std::to_string(b) + " are not connected on this backend.");
+			}
+
+			while (distance(virtualToPhysical[a], virtualToPhysical[b]) > 1) {
+				auto pa = virtualToPhysical[a], pb = virtualToPhysical[b];
+				auto current = distance(pa, pb);
+
+				// Candidate SWAPs move one end of the gate
+				// one step along a shortest path
+				double bestScore = std::numeric_limits<double>::max();
+				std::pair<int, int> best(-1, -1);
+				for (auto end : { pa, pb }) {
+					auto other = end == pa ? pb : pa;
+					auto adjacent = topology->neighbors(end);
+					for (auto bit = adjacent.find_first(); bit != adjacent.npos;
+							bit = adjacent.find_next(bit)) {
+						int n = bit;
+						if (distance(n, other) >= current) {
+							continue;
+						}
+
+						auto moved = [&](int v) {
+							auto p = virtualToPhysical[v];
+							return p == end ? n : (p == n ? end : p);
+						};
+
+						double score = 0.0, weight = 1.0;
+						for (int k = nextTwoQubitGate; k < twoQubitGates.size()
+								&& k < nextTwoQubitGate + lookahead; k++) {
+							auto next = instructions[twoQubitGates[k]]->bits();
+							score += weight * distance(moved(next[0]), moved(next[1]));
+							weight *= 0.5;
+						}
+
+						if (score < bestScore) {
+							bestScore = score;
+							best = std::make_pair(end, n);
+						}
+					}
+				}
+
+				swapOn(best.first, best.second);
+			}
+
+			routed->addInstruction(
+					remapInstruction(provider, inst,
+							std::vector<int> { virtualToPhysical[a],
+									virtualToPhysical[b] }));
+		} else {
+			std::vector<int> newBits;
+			for (auto q : bits) {
+				newBits.push_back(virtualToPhysical[q]);
+			}
+			routed->addInstruction(remapInstruction(provider, inst, newBits));
+		}
+	}
+
+	// Kernels that needed no SWAP are kept as they are,
+	// with their composites intact
+	if (nSwaps == before) {
+		return kernel;
+	}
+
+	context->inherit(kernel, routed);
+	context->recordMeasuredQubits(routed, measuredQubits);
+	context->composeLayout(routed, virtualToPhysical);
+
+	return routed;
+}
+
+}
+}
@@ -0,0 +1,119 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#ifndef ACCELERATOR_IBMQUBITROUTER_HPP_
+#define ACCELERATOR_IBMQUBITROUTER_HPP_
+
+#include "IRTransformation.hpp"
+#include "IBMCompilationContext.hpp"
+#include "IBMKernelUtils.hpp"
+#include "IBMBackendTopology.hpp"
+
+namespace xacc {
+namespace quantum {
+
+/**
+ * The IBMQubitRouter makes every two qubit gate act on
+ * qubits that are coupled on the backend. When the qubits
+ * of a gate are not adjacent, it inserts SWAPs (as three
+ * CNOTs) along a shortest path in the coupling graph. Of the
+ * SWAPs that bring the pair closer, it picks the one that also
+ * minimizes the weighted distance of the upcoming two qubit
+ * gates.
+ *
+ * Kernels are flattened, and the logical qubit read by each
+ * measurement and the final logical to physical layout are
+ * recorded in the IBMCompilationContext. CNOT directions are
+ * left to the IBMIRTransformation, which runs after this pass.
+ */
+class IBMQubitRouter: public IRTransformation {
+
+protected:
+
+	int nPhysicalQubits = 0;
+
+	std::shared_ptr<IBMBackendTopology> topology;
+
+	std::shared_ptr<IBMCompilationContext> context;
+
+	/**
+	 * Number of upcoming two qubit gates considered
+	 * when scoring a candidate SWAP.
+	 */
+	int lookahead;
+
+	int distance(const int p, const int q) {
+		return topology->distance(p, q);
+	}
+
+	std::shared_ptr<Function> route(std::shared_ptr<Function> kernel,
+			std::shared_ptr<IRProvider> provider);
+
+public:
+
+	IBMQubitRouter(std::shared_ptr<IBMBackendTopology> backendTopology,
+			std::shared_ptr<IBMCompilationContext> ctx =
+					std::make_shared<IBMCompilationContext>(),
+			const int lookaheadGates = 10);
+
+	IBMQubitRouter(std::vector<std::pair<int, int>> couplers,
+			std::shared_ptr<IBMCompilationContext> ctx =
+					std::make_shared<IBMCompilationContext>(),
+			const int lookaheadGates = 10) :
+			IBMQubitRouter(std::make_shared<IBMBackendTopology>(couplers), ctx,
+					lookaheadGates) {
+	}
+
+	virtual std::shared_ptr<IR> transform(std::shared_ptr<IR> ir);
+
+	/**
+	 * Return the number of SWAPs inserted by the last transform.
+	 */
+	int getNumberOfSwaps() {
+		return nSwaps;
+	}
+
+	virtual const std::string name() const {
+		return "ibm-qubit-router";
+	}
+
+	virtual const std::string description() const {
+		return "Insert SWAPs so that two qubit gates act on coupled qubits.";
+	}
+
+protected:
+
+	int nSwaps = 0;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,216 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#ifndef ACCELERATOR_IBMREADOUTCALIBRATION_HPP_
+#define ACCELERATOR_IBMREADOUTCALIBRATION_HPP_
+
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <boost/dynamic_bitset.hpp>
+
+namespace xacc {
+namespace quantum {
+
+/**
+ * Per qubit readout (assignment) errors of a backend, measured
+ * by preparing every qubit in 0 and every qubit in 1, and their
+ * correction under the model that the errors of the qubits are
+ * independent, ie the assignment matrix is the tensor product
+ * of the 2x2 matrices of the qubits.
+ */
+struct IBMReadoutCalibration {
+
+	/**
+	 * The calibrated qubits, the others are read without error
+	 */
+	std::set<int> qubits;
+
+	/**
+	 * For each prepared state, the number of shots and the
+	 * number of them in which each qubit was read flipped.
+	 */
+	int nShots[2] = { 0, 0 };
+	std::vector<int> nFlips[2];
+
+	/**
+	 * For each prepared state, the number of shots in which
+	 * each set of qubits below 64 was read flipped, as a mask,
+	 * which keeps the correlations between their errors.
+	 */
+	std::map<std::uint64_t, int> flipPatterns[2];
+
+	/**
+	 * When the calibration was measured
+	 */
+	std::time_t timestamp = 0;
+
+	IBMReadoutCalibration() {
+	}
+
+	IBMReadoutCalibration(const std::set<int>& calibrated) :
+			qubits(calibrated) {
+		auto nQubits = qubits.empty() ? 0 : *qubits.rbegin() + 1;
+		nFlips[0].assign(nQubits, 0);
+		nFlips[1].assign(nQubits, 0);
+	}
+
+	/**
+	 * Add count shots of the given outcome of the
+	 * circuit preparing every qubit in prepared.
+	 */
+	void addShots(const bool prepared, const boost::dynamic_bitset<>& outcome,
+			const int count) {
+		nShots[prepared] += count;
+		std::uint64_t pattern = 0;
+		for (auto q : qubits) {
+			if (q < outcome.size() && outcome[q] != prepared) {
+				nFlips[prepared][q] += count;
+				if (q < 64) {
+					pattern |= std::uint64_t(1) << q;
+				}
+			}
+		}
+		flipPatterns[prepared][pattern] += count;
+	}
+
+	/**
+	 * Return the probability that, after preparing every qubit in
+	 * prepared, the qubits of the given support mask read flipped
+	 * are exactly those of the given pattern.
+	 */
+	double patternProbability(const bool prepared, const std::uint64_t support,
+			const std::uint64_t pattern) const {
+		if (nShots[prepared] == 0) {
+			return pattern == 0 ? 1.0 : 0.0;
+		}
+		int count = 0;
+		for (auto& kv : flipPatterns[prepared]) {
+			if ((kv.first & support) == pattern) {
+				count += kv.second;
+			}
+		}
+		return (double) count / nShots[prepared];
+	}
+
+	/**
+	 * Return the probability of reading the given
+	 * qubit as 1 - prepared after preparing it in prepared.
+	 */
+	double flipProbability(const int qubit, const bool prepared) const {
+		if (nShots[prepared] == 0 || qubit >= nFlips[prepared].size()) {
+			return 0.0;
+		}
+		return (double) nFlips[prepared][qubit] / nShots[prepared];
+	}
+
+	/**
+	 * Return the probabilities of the outcomes of the given qubits in
+	 * the given histogram, with the inverse assignment matrix applied.
+	 * Outcome i has qubits[j] read as bit j of i. Keys of counts are
+	 * bit strings with qubit 0 as their right most character. Qubit
+	 * qubits[j] was measured on the calibrated qubit physical[j], or
+	 * on itself if physical is empty. The result may have small
+	 * negative entries.
+	 */
+	std::vector<double> correct(const std::map<std::string, int>& counts,
+			const std::vector<int>& qubits,
+			const std::vector<int>& physical = std::vector<int> { }) const {
+		std::vector<double> probabilities(std::size_t(1) << qubits.size(), 0.0);
+		int total = 0;
+		for (auto& kv : counts) {
+			std::size_t outcome = 0;
+			auto n = kv.first.size();
+			for (int j = 0; j < qubits.size(); j++) {
+				if (qubits[j] < n && kv.first[n - 1 - qubits[j]] == '1') {
+					outcome |= std::size_t(1) << j;
+				}
+			}
+			probabilities[outcome] += kv.second;
+			total += kv.second;
+		}
+		if (total == 0) {
+			return probabilities;
+		}
+		for (auto& p : probabilities) {
+			p /= total;
+		}
+
+		// Apply the 2x2 inverse of each qubit along its axis,
+		// pairing the outcomes that differ only in bit j
+		for (int j = 0; j < qubits.size(); j++) {
+			auto calibrated = physical.empty() ? qubits[j] : physical[j];
+			auto p01 = flipProbability(calibrated, 0);
+			auto p10 = flipProbability(calibrated, 1);
+			auto det = 1.0 - p01 - p10;
+			if (det <= 0.0) {
+				continue;
+			}
+			std::size_t stride = std::size_t(1) << j;
+			for (std::size_t block = 0; block < probabilities.size();
+					block += 2 * stride) {
+				for (std::size_t i = block; i < block + stride; i++) {
+					auto zero = probabilities[i];
+					auto one = probabilities[i + stride];
+					probabilities[i] = ((1.0 - p10) * zero - p10 * one) / det;
+					probabilities[i + stride] = ((1.0 - p01) * one - p01 * zero) / det;
+				}
+			}
+		}
+		return probabilities;
+	}
+
+	/**
+	 * Return the corrected expectation value of the
+	 * product of Z on the given qubits.
+	 */
+	double expectationZ(const std::map<std::string, int>& counts,
+			const std::vector<int>& qubits,
+			const std::vector<int>& physical = std::vector<int> { }) const {
+		auto probabilities = correct(counts, qubits, physical);
+		double expectation = 0.0;
+		for (std::size_t i = 0; i < probabilities.size(); i++) {
+			int parity = 0;
+			for (auto b = i; b; b &= b - 1) {
+				parity ^= 1;
+			}
+			expectation += parity ? -probabilities[i] : probabilities[i];
+		}
+		return expectation;
+	}
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,313 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#include "IBMReadoutMitigator.hpp"
+#include "XACC.hpp"
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <functional>
+#include <unordered_map>
+
+namespace xacc {
+namespace quantum {
+
+namespace {
+
+double dot(const std::vector<double>& a, const std::vector<double>& b) {
+	double sum = 0.0;
+	for (std::size_t i = 0; i < a.size(); i++) {
+		sum += a[i] * b[i];
+	}
+	return sum;
+}
+
+}
+
+IBMReadoutMitigator::IBMReadoutMitigator(
+		std::shared_ptr<IBMReadoutCalibration> calib, const int dist,
+		const double tol, const int maxIters) :
+		calibration(calib), distance(dist), tolerance(tol), maxIterations(
+				maxIters) {
+}
+
+double IBMReadoutMitigator::assignmentProbability(const std::uint64_t y,
+		const std::uint64_t x, const std::uint64_t support) {
+	auto flips = (x ^ y) & support;
+	double probability = 1.0;
+	for (int prepared = 0; prepared < 2; prepared++) {
+		auto group = prepared ? (x & support) : (~x & support);
+		auto key = std::make_pair(group, flips & group);
+		auto cached = patternCache[prepared].find(key);
+		if (cached == patternCache[prepared].end()) {
+			cached = patternCache[prepared].insert(std::make_pair(key,
+					calibration->patternProbability(prepared, key.first,
+							key.second))).first;
+		}
+		probability *= cached->second;
+	}
+	return probability;
+}
+
+std::vector<double> IBMReadoutMitigator::multiply(
+		const std::vector<double>& v) const {
+	std::vector<double> product(v.size(), 0.0);
+	for (std::size_t c = 0; c < columns.size(); c++) {
+		for (auto& entry : columns[c]) {
+			product[entry.first] += entry.second * v[c];
+		}
+	}
+	return product;
+}
+
+void IBMReadoutMitigator::solve(const std::vector<double>& b,
+		std::vector<double>& x) {
+	auto n = b.size();
+	auto bNorm = std::sqrt(dot(b, b));
+	nIterations = 0;
+	residual = 0.0;
+	if (bNorm == 0.0) {
+		std::fill(x.begin(), x.end(), 0.0);
+		return;
+	}
+
+	int restart = std::min((int) n, 30);
+	while (true) {
+		auto r = multiply(x);
+		for (std::size_t i = 0; i < n; i++) {
+			r[i] = b[i] - r[i];
+		}
+		auto beta = std::sqrt(dot(r, r));
+		residual = beta / bNorm;
+		if (residual <= tolerance || nIterations >= maxIterations) {
+			return;
+		}
+
+		// Arnoldi with Givens rotations keeping the
+		// Hessenberg matrix upper triangular
+		std::vector<std::vector<double>> basis(1, r);
+		for (auto& v : basis[0]) {
+			v /= beta;
+		}
+		std::vector<std::vector<double>> h(restart + 1,
+				std::vector<double>(restart, 0.0));
+		std::vector<double> cs(restart), sn(restart), g(restart + 1, 0.0);
+		g[0] = beta;
+
+		int k = 0;
+		while (k < restart && nIterations < maxIterations) {
+			auto w = multiply(basis[k]);
+			for (int i = 0; i <= k; i++) {
+				h[i][k] = dot(w, basis[i]);
+				for (std::size_t l = 0; l < n; l++) {
+					w[l] -= h[i][k] * basis[i][l];
+				}
+			}
+			auto wNorm = std::sqrt(dot(w, w));
+			h[k + 1][k] = wNorm;
+
+			for (int i = 0; i < k; i++) {
+				auto t = cs[i] * h[i][k] + sn[i] * h[i + 1][k];
+				h[i + 1][k] = -sn[i] * h[i][k] + cs[i] * h[i + 1][k];
+				h[i][k] = t;
+			}
+			auto denom = std::hypot(h[k][k], h[k + 1][k]);
+			cs[k] = denom == 0.0 ? 1.0 : h[k][k] / denom;
+			sn[k] = denom == 0.0 ? 0.0 : h[k + 1][k] / denom;
+			h[k][k] = denom;
+			h[k + 1][k] = 0.0;
+			g[k + 1] = -sn[k] * g[k];
+			g[k] = cs[k] * g[k];
+
+			k++;
+			nIterations++;
+			residual = std::fabs(g[k]) / bNorm;
+			if (residual <= tolerance || wNorm == 0.0) {
+				break;
+			}
+			for (auto& v : w) {
+				v /= wNorm;
+			}
+			basis.push_back(w);
+		}
+
+		// Back substitute and update the solution
+		std::vector<double> y(k, 0.0);
+		for (int i = k - 1; i >= 0; i--) {
+			auto sum = g[i];
+			for (int j = i + 1; j < k; j++) {
+				sum -= h[i][j] * y[j];
+			}
+			y[i] = h[i][i] == 0.0 ? 0.0 : sum / h[i][i];
+		}
+		for (int i = 0; i < k; i++) {
+			for (std::size_t l = 0; l < n; l++) {
+				x[l] += y[i] * basis[i][l];
+			}
+		}
+	}
+}
+
+std::vector<std::pair<std::uint64_t, double>> IBMReadoutMitigator::mitigate(
+		const std::map<std::string, int>& counts,
+		const std::vector<int>& qubits, const std::vector<int>& physical) {
+	auto calibrated = physical.empty() ? qubits : physical;
+	std::uint64_t support = 0;
+	for (auto q : calibrated) {
+		if (q < 0 || q >= 64) {
+			xacc::error("IBMReadoutMitigator supports at most 64 qubits, got qubit "
+					+ std::to_string(q) + ".");
+		}
+		support |= std::uint64_t(1) << q;
+	}
+
+	// Marginalize onto the given qubits
+	std::map<std::uint64_t, int> observed;
+	int total = 0;
+	for (auto& kv : counts) {
+		std::uint64_t outcome = 0;
+		auto n = kv.first.size();
+		for (int j = 0; j < qubits.size(); j++) {
+			if (qubits[j] < n && kv.first[n - 1 - qubits[j]] == '1') {
+				outcome |= std::uint64_t(1) << calibrated[j];
+			}
+		}
+		observed[outcome] += kv.second;
+		total += kv.second;
+	}
+
+	std::vector<std::uint64_t> outcomes;
+	std::vector<double> probabilities;
+	for (auto& kv : observed) {
+		outcomes.push_back(kv.first);
+		probabilities.push_back(total > 0 ? (double) kv.second / total : 0.0);
+	}
+
+	// Restricted, column normalized assignment matrix. The rows of
+	// each column are found by flipping up to distance of the measured
+	// qubits and looking the result up, or by scanning the outcomes
+	// when there are fewer of them than such flips.
+	std::unordered_map<std::uint64_t, int> outcomeIdx;
+	for (std::size_t i = 0; i < outcomes.size(); i++) {
+		outcomeIdx[outcomes[i]] = i;
+	}
+	std::vector<int> supportBits;
+	for (int q = 0; q < 64; q++) {
+		if (support & (std::uint64_t(1) << q)) {
+			supportBits.push_back(q);
+		}
+	}
+	double ballSize = 0.0, binomial = 1.0;
+	for (int d = 0; d <= distance && d <= supportBits.size(); d++) {
+		ballSize += binomial;
+		binomial = binomial * (supportBits.size() - d) / (d + 1);
+	}
+	bool enumerateBall = ballSize < outcomes.size();
+
+	columns.assign(outcomes.size(), {});
+	for (std::size_t c = 0; c < outcomes.size(); c++) {
+		auto& column = columns[c];
+		auto addRow = [&](const int r) {
+			auto a = assignmentProbability(outcomes[r], outcomes[c], support);
+			if (a > 0.0) {
+				column.push_back(std::make_pair(r, a));
+			}
+		};
+
+		if (enumerateBall) {
+			std::function<void(int, int, std::uint64_t)> flip =
+					[&](int first, int remaining, std::uint64_t y) {
+				auto found = outcomeIdx.find(y);
+				if (found != outcomeIdx.end()) {
+					addRow(found->second);
+				}
+				for (int b = first; remaining > 0 && b < supportBits.size(); b++) {
+					flip(b + 1, remaining - 1,
+							y ^ (std::uint64_t(1) << supportBits[b]));
+				}
+			};
+			flip(0, distance, outcomes[c]);
+		} else {
+			for (std::size_t r = 0; r < outcomes.size(); r++) {
+				if (std::bitset<64>(outcomes[r] ^ outcomes[c]).count() <= distance) {
+					addRow(r);
+				}
+			}
+		}
+
+		double sum = 0.0;
+		for (auto& entry : column) {
+			sum += entry.second;
+		}
+		for (auto& entry : column) {
+			entry.second /= sum;
+		}
+	}
+
+	auto quasi = probabilities;
+	solve(probabilities, quasi);
+
+	std::vector<std::pair<std::uint64_t, double>> result;
+	for (std::size_t i = 0; i < outcomes.size(); i++) {
+		result.push_back(std::make_pair(outcomes[i], quasi[i]));
+	}
+	return result;
+}
+
+std::map<std::string, double> IBMReadoutMitigator::quasiProbabilities(
+		const std::map<std::string, int>& counts,
+		const std::vector<int>& qubits, const std::vector<int>& physical) {
+	auto calibrated = physical.empty() ? qubits : physical;
+	std::map<std::string, double> quasi;
+	for (auto& kv : mitigate(counts, qubits, physical)) {
+		std::string bitStr(qubits.size(), '0');
+		for (int j = 0; j < qubits.size(); j++) {
+			if (kv.first & (std::uint64_t(1) << calibrated[j])) {
+				bitStr[qubits.size() - 1 - j] = '1';
+			}
+		}
+		quasi[bitStr] += kv.second;
+	}
+	return quasi;
+}
+
+double IBMReadoutMitigator::expectationZ(
+		const std::map<std::string, int>& counts,
+		const std::vector<int>& qubits, const std::vector<int>& physical) {
+	double expectation = 0.0;
+	for (auto& kv : mitigate(counts, qubits, physical)) {
+		auto parity = std::bitset<64>(kv.first).count() & 1;
+		expectation += parity ? -kv.second : kv.second;
+	}
+	return expectation;
+}
+
+}
+}
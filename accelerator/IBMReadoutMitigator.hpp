@@ -0,0 +1,157 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#ifndef ACCELERATOR_IBMREADOUTMITIGATOR_HPP_
+#define ACCELERATOR_IBMREADOUTMITIGATOR_HPP_
+
+#include "IBMReadoutCalibration.hpp"
+#include <memory>
+
+namespace xacc {
+namespace quantum {
+
+/**
+ * The IBMReadoutMitigator corrects a histogram for correlated readout
+ * errors without forming the 2^n assignment matrix.
+ *
+ * The probability of reading y after preparing x is modelled as the
+ * probability that the qubits prepared in 0 flip as y does, times that
+ * of the qubits prepared in 1, each taken from the joint flip patterns
+ * of the calibration preparing every qubit in 0 or in 1. Errors of
+ * qubits prepared alike are thus correlated as in the calibration.
+ *
+ * The matrix is restricted to the observed outcomes, with entries only
+ * between outcomes within the given Hamming distance, and each column
+ * renormalized. The corrected quasi-probabilities solve this sparse
+ * system by restarted GMRES, in O(unique outcomes x neighbors) memory.
+ * Up to 64 qubits are supported.
+ *
+ * Unobserved neighbors of the observed outcomes are left out. With
+ * small readout errors, outcomes the state prepares with noticeable
+ * probability are observed, so the neighbors would carry almost no
+ * weight, while there are O(n^distance) of them per observed outcome,
+ * which would dominate the size of the system for wide registers.
+ */
+class IBMReadoutMitigator {
+
+protected:
+
+	std::shared_ptr<IBMReadoutCalibration> calibration;
+
+	int distance;
+
+	double tolerance;
+
+	int maxIterations;
+
+	/**
+	 * Iterations and relative residual of the last solve
+	 */
+	int nIterations = 0;
+	double residual = 0.0;
+
+	/**
+	 * For each observed outcome, the observed outcomes within
+	 * distance of it and the probability of reading them
+	 */
+	std::vector<std::vector<std::pair<int, double>>> columns;
+
+	/**
+	 * Memoized pattern probabilities of each prepared state
+	 */
+	std::map<std::pair<std::uint64_t, std::uint64_t>, double> patternCache[2];
+
+	/**
+	 * Return the probability of reading y on the qubits
+	 * of the given support mask after preparing x.
+	 */
+	double assignmentProbability(const std::uint64_t y, const std::uint64_t x,
+			const std::uint64_t support);
+
+	/**
+	 * Return the product of the restricted matrix and v.
+	 */
+	std::vector<double> multiply(const std::vector<double>& v) const;
+
+	/**
+	 * Solve the restricted system for b by restarted
+	 * GMRES, starting from x.
+	 */
+	void solve(const std::vector<double>& b, std::vector<double>& x);
+
+	/**
+	 * Return the observed outcomes of the given qubits as masks
+	 * of the physical qubits they were measured on, and their
+	 * corrected quasi-probabilities.
+	 */
+	std::vector<std::pair<std::uint64_t, double>> mitigate(
+			const std::map<std::string, int>& counts,
+			const std::vector<int>& qubits, const std::vector<int>& physical);
+
+public:
+
+	IBMReadoutMitigator(std::shared_ptr<IBMReadoutCalibration> calibration,
+			const int distance = 2, const double tolerance = 1e-10,
+			const int maxIterations = 200);
+
+	/**
+	 * Return the corrected quasi-probabilities of the outcomes of the
+	 * given qubits observed in the given histogram. Keys of counts are
+	 * bit strings with qubit 0 as their right most character, keys of
+	 * the result have qubits[j] as their j-th character from the right.
+	 * Qubit qubits[j] was measured on the calibrated qubit physical[j],
+	 * or on itself if physical is empty.
+	 */
+	std::map<std::string, double> quasiProbabilities(
+			const std::map<std::string, int>& counts,
+			const std::vector<int>& qubits,
+			const std::vector<int>& physical = std::vector<int> { });
+
+	/**
+	 * Return the corrected expectation value of the product
+	 * of Z on the given qubits.
+	 */
+	double expectationZ(const std::map<std::string, int>& counts,
+			const std::vector<int>& qubits,
+			const std::vector<int>& physical = std::vector<int> { });
+
+	int getNumberOfIterations() const {
+		return nIterations;
+	}
+
+	double getResidual() const {
+		return residual;
+	}
+};
+
+}
+}
+
+#endif
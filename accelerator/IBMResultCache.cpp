@@ -0,0 +1,182 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#include "IBMResultCache.hpp"
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+namespace xacc {
+namespace quantum {
+
+namespace {
+
+/**
+ * Holds a flock on the given file for its lifetime.
+ */
+class FileLock {
+	int fd;
+public:
+	FileLock(const boost::filesystem::path& path, const bool exclusive) {
+		fd = open(path.string().c_str(), O_RDWR | O_CREAT, 0644);
+		if (fd >= 0) {
+			flock(fd, exclusive ? LOCK_EX : LOCK_SH);
+		}
+	}
+
+	~FileLock() {
+		if (fd >= 0) {
+			flock(fd, LOCK_UN);
+			close(fd);
+		}
+	}
+};
+
+const std::string entryExtension = ".result";
+
+}
+
+IBMResultCache::IBMResultCache(const std::string& dir,
+		const std::uintmax_t bytes, const std::time_t age) :
+		directory(dir), maxBytes(bytes), maxAge(age) {
+	boost::system::error_code ec;
+	boost::filesystem::create_directories(directory, ec);
+}
+
+std::string IBMResultCache::hash(const std::string& key) {
+	std::uint64_t h = 14695981039346656037ULL;
+	for (auto c : key) {
+		h ^= (unsigned char) c;
+		h *= 1099511628211ULL;
+	}
+	std::stringstream ss;
+	ss << std::hex << std::setw(16) << std::setfill('0') << h;
+	return ss.str();
+}
+
+boost::filesystem::path IBMResultCache::entryPath(const std::string& key) const {
+	return directory / (hash(key) + entryExtension);
+}
+
+bool IBMResultCache::get(const std::string& key, std::string& value) {
+	auto path = entryPath(key);
+	bool found = false;
+	{
+		FileLock lock(directory / ".lock", false);
+
+		// Entries are the key size, the key, then the value
+		std::ifstream in(path.string(), std::ios::binary);
+		std::size_t keySize = 0;
+		if (in >> keySize && in.get() == '\n') {
+			std::string storedKey(keySize, '\0');
+			if (in.read(&storedKey[0], keySize) && storedKey == key) {
+				std::stringstream ss;
+				ss << in.rdbuf();
+				value = ss.str();
+				found = true;
+			}
+		}
+		in.close();
+
+		// Expired entries are evicted on the next put
+		boost::system::error_code ec;
+		if (found && std::time(nullptr)
+				- boost::filesystem::last_write_time(path, ec) > maxAge) {
+			found = false;
+		}
+		if (found) {
+			boost::filesystem::last_write_time(path, std::time(nullptr), ec);
+		}
+	}
+
+	found ? hits++ : misses++;
+	return found;
+}
+
+void IBMResultCache::put(const std::string& key, const std::string& value) {
+	FileLock lock(directory / ".lock", true);
+
+	auto path = entryPath(key);
+	auto tmp = path;
+	tmp += ".tmp" + std::to_string(getpid());
+	{
+		std::ofstream out(tmp.string(), std::ios::binary);
+		out << key.size() << "\n" << key << value;
+	}
+	boost::system::error_code ec;
+	boost::filesystem::rename(tmp, path, ec);
+	if (ec) {
+		boost::filesystem::remove(tmp, ec);
+		return;
+	}
+
+	evict();
+}
+
+void IBMResultCache::evict() {
+	boost::system::error_code ec;
+	auto now = std::time(nullptr);
+
+	std::vector<std::pair<std::time_t, boost::filesystem::path>> entries;
+	std::uintmax_t totalBytes = 0;
+	for (boost::filesystem::directory_iterator it(directory, ec), end;
+			!ec && it != end; it.increment(ec)) {
+		auto path = it->path();
+		if (path.extension() != entryExtension) {
+			continue;
+		}
+		auto lastUsed = boost::filesystem::last_write_time(path, ec);
+		if (now - lastUsed > maxAge) {
+			boost::filesystem::remove(path, ec);
+			continue;
+		}
+		totalBytes += boost::filesystem::file_size(path, ec);
+		entries.push_back(std::make_pair(lastUsed, path));
+	}
+
+	// Least recently used first
+	std::sort(entries.begin(), entries.end());
+	for (auto& entry : entries) {
+		if (totalBytes <= maxBytes) {
+			break;
+		}
+		auto size = boost::filesystem::file_size(entry.second, ec);
+		boost::filesystem::remove(entry.second, ec);
+		totalBytes -= std::min(totalBytes, size);
+	}
+}
+
+}
+}
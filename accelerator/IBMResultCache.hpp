@@ -0,0 +1,118 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#ifndef ACCELERATOR_IBMRESULTCACHE_HPP_
+#define ACCELERATOR_IBMRESULTCACHE_HPP_
+
+#include <boost/filesystem.hpp>
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+namespace xacc {
+namespace quantum {
+
+/**
+ * The IBMResultCache is an on disk cache of job results, mapping a
+ * key (eg a circuit's OpenQasm, shots and backend) to a value (eg
+ * its counts). Each entry is a file named by a hash of its key, that
+ * also holds the key so that hash collisions are misses.
+ *
+ * Several processes may share a cache directory. Reads hold a shared
+ * flock on the directory's lock file and writes an exclusive one, and
+ * entries are written to a temporary file that is then renamed.
+ *
+ * Entries older than maxAge are evicted, then the least recently used
+ * entries until the cache holds at most maxBytes.
+ */
+class IBMResultCache {
+
+protected:
+
+	boost::filesystem::path directory;
+
+	std::uintmax_t maxBytes;
+
+	std::time_t maxAge;
+
+	int hits = 0;
+	int misses = 0;
+
+	boost::filesystem::path entryPath(const std::string& key) const;
+
+	/**
+	 * Evict old and least recently used entries,
+	 * the caller holds the exclusive lock.
+	 */
+	void evict();
+
+public:
+
+	IBMResultCache(const std::string& directory,
+			const std::uintmax_t maxBytes = 64 * 1024 * 1024,
+			const std::time_t maxAge = 7 * 24 * 3600);
+
+	/**
+	 * Set value to the cached value of the given key and
+	 * return true, or return false if it is not cached.
+	 */
+	bool get(const std::string& key, std::string& value);
+
+	/**
+	 * Cache the given value for the given key.
+	 */
+	void put(const std::string& key, const std::string& value);
+
+	const std::string getDirectory() const {
+		return directory.string();
+	}
+
+	int getHits() const {
+		return hits;
+	}
+
+	int getMisses() const {
+		return misses;
+	}
+
+	double getHitRate() const {
+		return hits + misses > 0 ? (double) hits / (hits + misses) : 0.0;
+	}
+
+	/**
+	 * Return the 64 bit FNV-1a hash of the given key, in hex.
+	 */
+	static std::string hash(const std::string& key);
+};
+
+}
+}
+
+#endif
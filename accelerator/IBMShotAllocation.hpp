@@ -0,0 +1,192 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#ifndef ACCELERATOR_IBMSHOTALLOCATION_HPP_
+#define ACCELERATOR_IBMSHOTALLOCATION_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <string>
+#include <vector>
+#include <boost/algorithm/string.hpp>
+#include "XACC.hpp"
+
+namespace xacc {
+namespace quantum {
+
+/**
+ * Splits a total shot budget across the kernels of a batch whose
+ * expectation values are summed with the given weights, eg the
+ * terms of a Hamiltonian.
+ *
+ * The variance of the weighted sum is sum_k w_k^2 sigma_k^2 / n_k,
+ * which for a fixed budget is smallest when n_k is proportional
+ * to |w_k| sigma_k (Neyman allocation).
+ */
+struct IBMShotAllocation {
+
+	/**
+	 * Return the shots of each kernel, summing to budget, given the
+	 * kernel weights and the standard deviation of one shot of each
+	 * kernel. Every kernel gets at least minShots, it is an error if
+	 * the budget does not allow for that. Without standard
+	 * deviations, every kernel is assumed to have the largest
+	 * possible one, 1 for a +-1 valued observable.
+	 */
+	static std::vector<int> allocate(const std::vector<double>& weights,
+			const std::vector<double>& stddevs, const int budget,
+			const int minShots = 1) {
+		auto n = weights.size();
+		std::vector<int> shots(n, minShots);
+		int remaining = budget - minShots * (int) n;
+		if (remaining < 0) {
+			xacc::error("A budget of " + std::to_string(budget)
+					+ " shots cannot give " + std::to_string(n)
+					+ " kernels " + std::to_string(minShots) + " shots each.");
+		}
+		if (n == 0 || remaining == 0) {
+			return shots;
+		}
+
+		auto scores = scoreKernels(weights, stddevs);
+		auto total = std::accumulate(scores.begin(), scores.end(), 0.0);
+
+		// Round down, then hand out what is left by largest remainder
+		std::vector<std::pair<double, int>> remainders;
+		int assigned = 0;
+		for (int k = 0; k < n; k++) {
+			auto ideal = remaining * scores[k] / total;
+			auto whole = (int) std::floor(ideal);
+			shots[k] += whole;
+			assigned += whole;
+			remainders.push_back(std::make_pair(ideal - whole, k));
+		}
+		std::stable_sort(remainders.begin(), remainders.end(),
+				[](const std::pair<double, int>& a,
+						const std::pair<double, int>& b) {
+					return a.first > b.first;
+				});
+		for (int i = 0; i < remaining - assigned; i++) {
+			shots[remainders[i % n].second]++;
+		}
+		return shots;
+	}
+
+	/**
+	 * Return the shots of each kernel as allocate does, rounded to
+	 * the levels minShots * 2^j so that kernels with similar
+	 * allocations share a shot count, and thus a job. Every kernel
+	 * first gets the highest level not above its allocation, then
+	 * the kernels with the highest score per shot are doubled while
+	 * the budget allows.
+	 */
+	static std::vector<int> allocateLevels(const std::vector<double>& weights,
+			const std::vector<double>& stddevs, const int budget,
+			const int minShots = 1) {
+		auto shots = allocate(weights, stddevs, budget, minShots);
+		auto scores = scoreKernels(weights, stddevs);
+
+		int remaining = budget;
+		for (auto& s : shots) {
+			int level = std::max(minShots, 1);
+			while (2 * level <= s) {
+				level *= 2;
+			}
+			s = level;
+			remaining -= level;
+		}
+
+		while (true) {
+			int best = -1;
+			for (int k = 0; k < shots.size(); k++) {
+				if (scores[k] > 0.0 && shots[k] <= remaining
+						&& (best < 0 || scores[k] * shots[best]
+								> scores[best] * shots[k])) {
+					best = k;
+				}
+			}
+			if (best < 0) {
+				return shots;
+			}
+			remaining -= shots[best];
+			shots[best] *= 2;
+		}
+	}
+
+	/**
+	 * Return the variance of one shot of a +-1 valued observable
+	 * with the given expectation value, estimated from the given
+	 * number of shots. An estimate from n shots cannot resolve a
+	 * variance below 1/n, so it is used as a floor.
+	 */
+	static double variance(const double expectation, const int nShots) {
+		auto var = 1.0 - expectation * expectation;
+		return nShots > 0 ? std::max(var, 1.0 / nShots) : 1.0;
+	}
+
+	/**
+	 * Return |w_k| sigma_k for each kernel, or 1 for every
+	 * kernel if they are all 0.
+	 */
+	static std::vector<double> scoreKernels(const std::vector<double>& weights,
+			const std::vector<double>& stddevs) {
+		std::vector<double> scores(weights.size());
+		for (int k = 0; k < weights.size(); k++) {
+			scores[k] = std::fabs(weights[k])
+					* (k < stddevs.size() ? stddevs[k] : 1.0);
+		}
+		if (std::accumulate(scores.begin(), scores.end(), 0.0) <= 0.0) {
+			std::fill(scores.begin(), scores.end(), 1.0);
+		}
+		return scores;
+	}
+
+	/**
+	 * Parse a comma separated list of numbers.
+	 */
+	static std::vector<double> parseList(const std::string& list) {
+		std::vector<std::string> entries;
+		boost::split(entries, list, boost::is_any_of(","));
+		std::vector<double> values;
+		for (auto& entry : entries) {
+			boost::trim(entry);
+			if (!entry.empty()) {
+				values.push_back(std::stod(entry));
+			}
+		}
+		return values;
+	}
+};
+
+}
+}
+
+#endif
@@ -30,7 +30,11 @@
  **********************************************************************************/
 #include <memory>
 #include <gtest/gtest.h>
+#include <boost/filesystem.hpp>
 #include "IBMAccelerator.hpp"
+#include "IBMAcceleratorBuffer.hpp"
+#include "IBMKernelUtils.hpp"
+#include "GateIR.hpp"
 #include "xacc-ibm-config.hpp"
 #include "XACC.hpp"
 
@@ -53,6 +57,12 @@ protected:
 
 public:
 
+	std::string lastPost;
+
+	void setResults(const std::string& results) {
+		fakeGetResults = results;
+	}
+
 	FakeRestClient(const std::string& login, const std::string& initBackends,
 			const std::string& post, const std::string& results) :
 			fakeInitLogin(login), fakeInitGetBackends(initBackends), fakePostJob(
@@ -64,6 +74,7 @@ public:
 				std::map<std::string, std::string> headers = std::map<std::string,
 						std::string> { }) {
 		std::cout << "HELLO WORLD POSTING FAKE CLIENT \n";
+		lastPost = postStr;
 		if (path == "/api/users/loginWithToken") {
 			return fakeInitLogin;
 		} else {
@@ -86,6 +97,18 @@ public:
 	}
 };
 
+/**
+ * Return the number of circuits in the given job post.
+ */
+int countCircuits(const std::string& post) {
+	int nCircuits = 0;
+	for (auto pos = post.find("\"qasm\""); pos != std::string::npos;
+			pos = post.find("\"qasm\"", pos + 1)) {
+		nCircuits++;
+	}
+	return nCircuits;
+}
+
 const std::string fakeLogin = R"fakeLogin({"id":"oRpEgRr0Su96EwLn00aM7JPQnAA49xi7XRDJEi6ObWMXCrywZ1axXq00Bh85mcDA","ttl":1209600,"created":"2017-10-04T16:49:00.645Z","userId":"12074c90bb6425be346c55a1f1318a03"})fakeLogin";
 const std::string fakeBackends = R"fakeBackends([{"couplingMap":[[0,1],[0,2],[1,2],[3,2],[3,4],[4,2]],"description":"Device Real5Qv1","id":"cc7f910ff2e6860e0d4918e9ee0ebae0","nQubits":5,"name":"Device Real5Qv1","serialNumber":"Real5Qv1","simulator":false,"status":"off","topologyId":"250e969c6b9e68aa2a045ffbceb3ac33"},{"basisGates":"SU2+CNOT","chipName":"Raven","couplingMap":[[1,0],[2,0],[2,1],[2,4],[3,2],[3,4]],"description":"5 qubit transmon bowtie chip 3","id":"c16c5ddebbf8922a7e2a0f5a89cac478","nQubits":5,"name":"ibmqx4","onlineDate":"2017-09-18T11:00:00.000Z","serialNumber":"ibmqx4","simulator":false,"status":"on","topologyId":"3b8e671a5a3b56899e6e601e6a3816a1","url":"https://ibm.biz/qiskit-ibmqx4","version":"1"},{"basisGates":"u1,u2,u3,cx,id","chipName":"Sparrow","couplingMap":[[0,1],[0,2],[1,2],[3,2],[3,4],[4,2]],"description":"5 transmon bowtie","id":"28147a578bdc88ec8087af46ede526e1","nQubits":5,"name":"ibmqx2","onlineDate":"2017-01-10T12:00:00.000Z","serialNumber":"Real5Qv2","simulator":false,"status":"on","topologyId":"250e969c6b9e68aa2a045ffbceb3ac33","url":"https://ibm.biz/qiskit-ibmqx2","version":"1"},{"basisGates":"u1,u2,u3,cx,id","chipName":"Albatross","couplingMap":[[1,0],[1,2],[2,3],[3,4],[3,14],[5,4],[6,5],[6,7],[6,11],[7,10],[8,7],[9,8],[9,10],[11,10],[12,5],[12,11],[12,13],[13,4],[13,14],[15,0],[15,2],[15,14]],"description":"16 transmon 2x8 ladder","id":"f451527ae7b9c9998e7addf1067c0df4","nQubits":16,"name":"ibmqx5","onlineDate":"2017-09-21T11:00:00.000Z","serialNumber":"ibmqx5","simulator":false,"status":"on","topologyId":"ad8b182a0653f51dfbd5d66c33fd08c7","url":"https://ibm.biz/qiskit-ibmqx5","version":"1"},{"basisGates":"u1,u2,u3,cx,id","chipName":"Albatross","couplingMap":[[0,1],[1,2],[2,3],[3,14],[4,3],[4,5],[6,7],[6,11],[7,10],[8,7],[9,8],[9,10],[11,10],[12,5],[12,11],[12,13],[13,4],[13,14],[15,0],[15,14]],"description":"16 transmon 2x8 ladder","id":"2bcc3cdb587d1bef305ac14447b9b0a6","nQubits":16,"name":"ibmqx3","onlineDate":"2017-06-06T11:00:00.000Z","serialNumber":"ibmqx3","simulator":false,"status":"off","topologyId":"db99eef232f426b45d2d147359580bc6","url":"https://ibm.biz/qiskit-ibmqx3","version":"1"},{"description":"online qasm simulator","gateSet":"u1,u2,u3,cx","id":"0a403248d95598fef21ee1a71d5db79a","nQubits":24,"name":"ibmqx_qasm_simulator","serialNumber":"ibmqx_qasm_simulator","simulator":true,"status":"on","topologyId":"4cfbd99fee9fc80b91888e8c914666a5"}])fakeBackends";
 const std::string fakePostResultSim = R"fakePostResults({"qasms":[{"qasm":"\ninclude \"qelib1.inc\";\nqreg q[3];\nx q[0];\nh q[1];\ncx q[1], q[2];\ncx q[0], q[1];\nh q[0];\ncreg c0[1];\nmeasure q[0] -> c0[0];\ncreg c1[1];\nmeasure q[1] -> c1[0];\nif (c0 == 1) z q[2];\nif (c1 == 1) x q[2];\ncreg c2[1];\nmeasure q[2] -> c2[0];\n","status":"WORKING_IN_PROGRESS","executionId":"a66ff99b6e44a916ed3a6c7579ee0f06"}],"shots":1024,"backend":{"name":"ibmqx_qasm_simulator"},"status":"RUNNING","maxCredits":3,"usedCredits":0,"creationDate":"2017-10-04T16:49:02.376Z","deleted":false,"id":"fd386cfd16b707b6f5d8ece36d6f7c3b","userId":"12074c90bb6425be346c55a1f1318a03"})fakePostResults";
@@ -165,6 +188,983 @@ TEST(IBMAcceleratorTester,checkKernelPhysicalExecution) {
 
 }
 
+TEST(IBMAcceleratorTester,checkActiveQubitCompaction) {
+        xacc::Initialize();
+        xacc::setOption("ibm-api-key", "hello");
+        xacc::setOption("ibm-api-url", "hello");
+
+	const std::string fakeGetResults = R"fakeGetResults({"backend":{"name":"ibmqx_qasm_simulator"},"id":"fd386cfd16b707b6f5d8ece36d6f7c3b","qasms":[{"qasm":"","result":{"data":{"counts":{"0":400,"1":624}}},"status":"DONE"}],"shots":1024,"status":"COMPLETED"})fakeGetResults";
+
+	auto fakeClient = std::make_shared<FakeRestClient>(fakeLogin, fakeBackends,
+			fakePostResultSim, fakeGetResults);
+
+	IBMAccelerator acc(fakeClient);
+	acc.initialize();
+
+	// Default buffer has 30 qubits, the kernel only touches 2
+	auto buffer = acc.createBuffer("qubits");
+
+	auto f = std::make_shared<GateFunction>("foo");
+	f->addInstruction(std::make_shared<Hadamard>(5));
+	f->addInstruction(std::make_shared<CNOT>(5, 9));
+	f->addInstruction(std::make_shared<Measure>(9, 0));
+
+	acc.execute(buffer, f);
+
+	EXPECT_TRUE(boost::contains(fakeClient->lastPost, "qreg q[2];"));
+	EXPECT_TRUE(boost::contains(fakeClient->lastPost, "cx q[0], q[1];"));
+
+	// Outcomes are mapped back onto qubit 9 of the buffer
+	EXPECT_NEAR((400.0 - 624.0) / 1024.0, buffer->getExpectationValueZ(), 1e-12);
+
+	xacc::Finalize();
+}
+
+TEST(IBMAcceleratorTester,checkSingleKernelOutcomeLayout) {
+        xacc::Initialize();
+        xacc::setOption("ibm-api-key", "hello");
+        xacc::setOption("ibm-api-url", "hello");
+
+	// c0 holds the first measurement, of qubit 2, c1 that of qubit 0
+	const std::string fakeGetResults = R"fakeGetResults({"backend":{"name":"ibmqx_qasm_simulator"},"id":"fd386cfd16b707b6f5d8ece36d6f7c3b","qasms":[{"qasm":"","result":{"data":{"counts":{"0 1":1024}}},"status":"DONE"}],"shots":1024,"status":"COMPLETED"})fakeGetResults";
+
+	auto fakeClient = std::make_shared<FakeRestClient>(fakeLogin, fakeBackends,
+			fakePostResultSim, fakeGetResults);
+
+	IBMAccelerator acc(fakeClient);
+	acc.initialize();
+	auto buffer = acc.createBuffer("qubits", 3);
+
+	auto f = std::make_shared<GateFunction>("foo");
+	f->addInstruction(std::make_shared<X>(2));
+	f->addInstruction(std::make_shared<Measure>(2, 0));
+	f->addInstruction(std::make_shared<Measure>(0, 1));
+
+	acc.execute(buffer, f);
+
+	// A single kernel's outcomes span the buffer, bit i holding
+	// qubit i, as for batches, not one bit per measurement
+	std::stringstream ss;
+	std::dynamic_pointer_cast<IBMAcceleratorBuffer>(buffer)->print(ss);
+	EXPECT_TRUE(boost::contains(ss.str(), "measure result: 100, 1024"));
+	EXPECT_NEAR(-1.0, buffer->getExpectationValueZ(), 1e-12);
+
+	xacc::Finalize();
+}
+
+TEST(IBMAcceleratorTester,checkLightConePruning) {
+        xacc::Initialize();
+        xacc::setOption("ibm-api-key", "hello");
+        xacc::setOption("ibm-api-url", "hello");
+
+	const std::string fakeGetResults = R"fakeGetResults({"backend":{"name":"ibmqx_qasm_simulator"},"id":"fd386cfd16b707b6f5d8ece36d6f7c3b","qasms":[{"qasm":"","result":{"data":{"counts":{"0":400,"1":624}}},"status":"DONE"}],"shots":1024,"status":"COMPLETED"})fakeGetResults";
+
+	auto fakeClient = std::make_shared<FakeRestClient>(fakeLogin, fakeBackends,
+			fakePostResultSim, fakeGetResults);
+
+	IBMAccelerator acc(fakeClient);
+	acc.initialize();
+	auto buffer = acc.createBuffer("qubits", 4);
+
+	// Only qubits 0 and 1 can affect the measurement of 1
+	auto f = std::make_shared<GateFunction>("foo");
+	f->addInstruction(std::make_shared<Hadamard>(0));
+	f->addInstruction(std::make_shared<Hadamard>(2));
+	f->addInstruction(std::make_shared<CNOT>(2, 3));
+	f->addInstruction(std::make_shared<CNOT>(0, 1));
+	f->addInstruction(std::make_shared<X>(0));
+	f->addInstruction(std::make_shared<Measure>(1, 0));
+
+	acc.execute(buffer, f);
+
+	EXPECT_TRUE(boost::contains(fakeClient->lastPost, "qreg q[2];"));
+	EXPECT_TRUE(boost::contains(fakeClient->lastPost, "cx q[0], q[1];"));
+	EXPECT_FALSE(boost::contains(fakeClient->lastPost, "x q[0];"));
+	EXPECT_NEAR((400.0 - 624.0) / 1024.0, buffer->getExpectationValueZ(), 1e-12);
+
+	xacc::Finalize();
+}
+
+TEST(IBMAcceleratorTester,checkKernelPacking) {
+        xacc::Initialize();
+        xacc::setOption("ibm-api-key", "hello");
+        xacc::setOption("ibm-api-url", "hello");
+        xacc::setOption("ibm-backend", "ibmqx5");
+        xacc::setOption("ibm-pack-kernels", "");
+
+	// The second kernel lands on the 15 -> 2 coupler, so qubit 0
+	// reads the first kernel and qubit 2 reads the second.
+	const std::string fakeGetResults = R"fakeGetResults({"backend":{"name":"ibmqx5"},"id":"fd386cfd16b707b6f5d8ece36d6f7c3b","qasms":[{"qasm":"","result":{"data":{"counts":{"0000000000000001":300,"0000000000000100":200,"0000000000000000":524}}},"status":"DONE"}],"shots":1024,"status":"COMPLETED"})fakeGetResults";
+
+	auto fakeClient = std::make_shared<FakeRestClient>(fakeLogin, fakeBackends,
+			fakePostResultSim, fakeGetResults);
+
+	IBMAccelerator acc(fakeClient);
+	acc.initialize();
+	auto buffer = acc.createBuffer("qubits", 2);
+
+	auto f = std::make_shared<GateFunction>("f");
+	f->addInstruction(std::make_shared<Hadamard>(1));
+	f->addInstruction(std::make_shared<CNOT>(1, 0));
+	f->addInstruction(std::make_shared<Measure>(0, 0));
+
+	auto g = std::make_shared<GateFunction>("g");
+	g->addInstruction(std::make_shared<X>(1));
+	g->addInstruction(std::make_shared<CNOT>(1, 0));
+	g->addInstruction(std::make_shared<Measure>(0, 0));
+
+	auto buffers = acc.execute(buffer,
+			std::vector<std::shared_ptr<Function>> { f, g });
+
+	// One circuit holds both kernels
+	EXPECT_EQ(1, countCircuits(fakeClient->lastPost));
+	EXPECT_TRUE(boost::contains(fakeClient->lastPost, "qreg q[16];"));
+	EXPECT_TRUE(boost::contains(fakeClient->lastPost, "cx q[1], q[0];"));
+	EXPECT_TRUE(boost::contains(fakeClient->lastPost, "cx q[15], q[2];"));
+
+	// Each kernel gets the marginal counts of its own qubits
+	EXPECT_EQ(2, buffers.size());
+	EXPECT_NEAR((724.0 - 300.0) / 1024.0, buffers[0]->getExpectationValueZ(), 1e-12);
+	EXPECT_NEAR((824.0 - 200.0) / 1024.0, buffers[1]->getExpectationValueZ(), 1e-12);
+
+	RuntimeOptions::instance()->erase("ibm-backend");
+	RuntimeOptions::instance()->erase("ibm-pack-kernels");
+	xacc::Finalize();
+}
+
+TEST(IBMAcceleratorTester,checkDryRun) {
+        xacc::Initialize();
+        xacc::setOption("ibm-api-key", "hello");
+        xacc::setOption("ibm-api-url", "hello");
+        xacc::setOption("ibm-backend", "ibmqx5");
+        xacc::setOption("ibm-dry-run", "");
+
+	auto fakeClient = std::make_shared<FakeRestClient>(fakeLogin, fakeBackends,
+			fakePostResultSim, fakeGetResultsSim);
+
+	IBMAccelerator acc(fakeClient);
+	acc.initialize();
+	auto buffer = acc.createBuffer("qubits", 2);
+
+	auto f = std::make_shared<GateFunction>("foo");
+	f->addInstruction(std::make_shared<Hadamard>(1));
+	f->addInstruction(std::make_shared<CNOT>(1, 0));
+	f->addInstruction(std::make_shared<Measure>(0, 0));
+	f->addInstruction(std::make_shared<Measure>(1, 1));
+
+	acc.execute(buffer, f);
+
+	// Nothing was submitted
+	EXPECT_FALSE(boost::contains(fakeClient->lastPost, "qasms"));
+
+	auto report = acc.getDryRunReport();
+	EXPECT_EQ("ibmqx5", report.backend);
+	EXPECT_EQ(1024, report.shots);
+	EXPECT_EQ(1, report.nCircuits);
+	EXPECT_EQ(1, report.kernels.size());
+	EXPECT_EQ(4, report.kernels[0].statistics.nGates);
+	EXPECT_EQ(1, report.kernels[0].statistics.nTwoQubitGates);
+	EXPECT_EQ(3, report.kernels[0].statistics.depth);
+	EXPECT_EQ(std::vector<int>({0, 1}), report.kernels[0].measuredQubits);
+	EXPECT_TRUE(report.kernels[0].qasmBytes > 0);
+	EXPECT_EQ(report.kernels[0].qasmBytes, report.totalQasmBytes);
+
+	// u + cx + measure on the critical path, then the repetition delay
+	EXPECT_NEAR(130.0 + 430.0 + 4000.0, report.kernels[0].circuitTime, 1e-9);
+	EXPECT_NEAR(1024 * (4560.0 + 100000.0), report.deviceTime, 1e-6);
+
+	// The time is that of the lowered circuit, where h h fuses away
+	auto g = std::make_shared<GateFunction>("bar");
+	g->addInstruction(std::make_shared<Hadamard>(0));
+	g->addInstruction(std::make_shared<Hadamard>(0));
+	g->addInstruction(std::make_shared<Measure>(0, 0));
+
+	acc.execute(buffer, g);
+	EXPECT_NEAR(4000.0, acc.getDryRunReport().kernels[0].circuitTime, 1e-9);
+
+	RuntimeOptions::instance()->erase("ibm-backend");
+	RuntimeOptions::instance()->erase("ibm-dry-run");
+	xacc::Finalize();
+}
+
+TEST(IBMAcceleratorTester,checkMeasurementGrouping) {
+        xacc::Initialize();
+        xacc::setOption("ibm-api-key", "hello");
+        xacc::setOption("ibm-api-url", "hello");
+
+	// The Z0, Z1 and Z0Z1 kernels share the first circuit, which
+	// measures qubit 0 then qubit 1. X0 needs a circuit of its own.
+	const std::string fakeGetResults = R"fakeGetResults({"backend":{"name":"ibmqx_qasm_simulator"},"id":"fd386cfd16b707b6f5d8ece36d6f7c3b","qasms":[{"qasm":"","result":{"data":{"counts":{"0 0":400,"0 1":100,"1 1":524}}},"status":"DONE"},{"qasm":"","result":{"data":{"counts":{"0":700,"1":324}}},"status":"DONE"}],"shots":1024,"status":"COMPLETED"})fakeGetResults";
+
+	auto fakeClient = std::make_shared<FakeRestClient>(fakeLogin, fakeBackends,
+			fakePostResultSim, fakeGetResults);
+
+	IBMAccelerator acc(fakeClient);
+	acc.initialize();
+	auto buffer = acc.createBuffer("qubits", 2);
+
+	auto prep = std::make_shared<GateFunction>("prep");
+	prep->addInstruction(std::make_shared<Hadamard>(0));
+	prep->addInstruction(std::make_shared<CNOT>(0, 1));
+
+	auto z0 = std::make_shared<GateFunction>("z0");
+	z0->addInstruction(prep);
+	z0->addInstruction(std::make_shared<Measure>(0, 0));
+
+	auto z1 = std::make_shared<GateFunction>("z1");
+	z1->addInstruction(prep);
+	z1->addInstruction(std::make_shared<Measure>(1, 0));
+
+	auto z0z1 = std::make_shared<GateFunction>("z0z1");
+	z0z1->addInstruction(prep);
+	z0z1->addInstruction(std::make_shared<Measure>(0, 0));
+	z0z1->addInstruction(std::make_shared<Measure>(1, 1));
+
+	auto x0 = std::make_shared<GateFunction>("x0");
+	x0->addInstruction(prep);
+	x0->addInstruction(std::make_shared<Hadamard>(0));
+	x0->addInstruction(std::make_shared<Measure>(0, 0));
+
+	auto buffers = acc.execute(buffer,
+			std::vector<std::shared_ptr<Function>> { z0, z1, z0z1, x0 });
+
+	EXPECT_EQ(2, countCircuits(fakeClient->lastPost));
+
+	int nMeasures = 0;
+	for (auto pos = fakeClient->lastPost.find("measure"); pos != std::string::npos;
+			pos = fakeClient->lastPost.find("measure", pos + 1)) {
+		nMeasures++;
+	}
+	EXPECT_EQ(3, nMeasures);
+
+	// Every kernel is served from the histogram of its circuit
+	EXPECT_EQ(4, buffers.size());
+	EXPECT_NEAR((400.0 - 624.0) / 1024.0, buffers[0]->getExpectationValueZ(), 1e-12);
+	EXPECT_NEAR((500.0 - 524.0) / 1024.0, buffers[1]->getExpectationValueZ(), 1e-12);
+	EXPECT_NEAR((924.0 - 100.0) / 1024.0, buffers[2]->getExpectationValueZ(), 1e-12);
+	EXPECT_NEAR((700.0 - 324.0) / 1024.0, buffers[3]->getExpectationValueZ(), 1e-12);
+
+	xacc::Finalize();
+}
+
+TEST(IBMAcceleratorTester,checkShotAllocation) {
+
+	// Shots go as |weight| * standard deviation
+	EXPECT_EQ(std::vector<int>({3072, 1024}),
+			IBMShotAllocation::allocate({ 3.0, -1.0 }, { }, 4096));
+	EXPECT_EQ(std::vector<int>({818, 172, 10}),
+			IBMShotAllocation::allocate({ 0.5, -0.2, 0.0 }, { 1.0, 0.5, 1.0 },
+					1000, 10));
+	EXPECT_EQ(std::vector<int>({34, 33, 33}),
+			IBMShotAllocation::allocate({ 1.0, 1.0, 1.0 }, { }, 100));
+
+	// Rounded to 10 * 2^j levels, the zero weight kernel stays at 10
+	EXPECT_EQ(std::vector<int>({640, 320, 10}),
+			IBMShotAllocation::allocateLevels({ 0.5, -0.2, 0.0 },
+					{ 1.0, 0.5, 1.0 }, 1000, 10));
+	EXPECT_EQ(std::vector<int>({2048, 2048}),
+			IBMShotAllocation::allocateLevels({ 3.0, -1.0 }, { }, 4096));
+
+	// A deterministic outcome still has the variance 1/n floor
+	EXPECT_NEAR(0.01, IBMShotAllocation::variance(1.0, 100), 1e-12);
+	EXPECT_NEAR(0.75, IBMShotAllocation::variance(0.5, 100), 1e-12);
+
+        xacc::Initialize();
+        xacc::setOption("ibm-api-key", "hello");
+        xacc::setOption("ibm-api-url", "hello");
+        xacc::setOption("ibm-shot-budget", "4096");
+        xacc::setOption("ibm-shot-weights", "3.0, -1.0");
+
+	const std::string fakeGetResults = R"fakeGetResults({"backend":{"name":"ibmqx_qasm_simulator"},"id":"fd386cfd16b707b6f5d8ece36d6f7c3b","qasms":[{"qasm":"","result":{"data":{"counts":{"0":800,"1":1248}}},"status":"DONE"},{"qasm":"","result":{"data":{"counts":{"1":2048}}},"status":"DONE"}],"shots":2048,"status":"COMPLETED"})fakeGetResults";
+
+	auto fakeClient = std::make_shared<FakeRestClient>(fakeLogin, fakeBackends,
+			fakePostResultSim, fakeGetResults);
+
+	IBMAccelerator acc(fakeClient);
+	acc.initialize();
+	auto buffer = acc.createBuffer("qubits", 1);
+
+	auto f = std::make_shared<GateFunction>("f");
+	f->addInstruction(std::make_shared<Hadamard>(0));
+	f->addInstruction(std::make_shared<Measure>(0, 0));
+
+	auto g = std::make_shared<GateFunction>("g");
+	g->addInstruction(std::make_shared<X>(0));
+	g->addInstruction(std::make_shared<Measure>(0, 0));
+
+	auto buffers = acc.execute(buffer,
+			std::vector<std::shared_ptr<Function>> { f, g });
+
+	// Both kernels land on the 2048 shot level and share one job
+	EXPECT_TRUE(boost::contains(fakeClient->lastPost, "\"shots\": 2048"));
+	EXPECT_EQ(2, buffers.size());
+	EXPECT_EQ("qubits0", buffers[0]->name());
+	EXPECT_EQ("qubits1", buffers[1]->name());
+	EXPECT_NEAR((800.0 - 1248.0) / 2048.0, buffers[0]->getExpectationValueZ(), 1e-12);
+	EXPECT_NEAR(-1.0, buffers[1]->getExpectationValueZ(), 1e-12);
+
+	RuntimeOptions::instance()->erase("ibm-shot-budget");
+	RuntimeOptions::instance()->erase("ibm-shot-weights");
+	xacc::Finalize();
+}
+
+TEST(IBMAcceleratorTester,checkAdaptiveSampling) {
+        xacc::Initialize();
+        xacc::setOption("ibm-api-key", "hello");
+        xacc::setOption("ibm-api-url", "hello");
+        xacc::setOption("ibm-target-error", "0.02");
+        xacc::setOption("ibm-chunk-shots", "1024");
+
+	const std::string fakeGetResults = R"fakeGetResults({"backend":{"name":"ibmqx_qasm_simulator"},"id":"fd386cfd16b707b6f5d8ece36d6f7c3b","qasms":[{"qasm":"","result":{"data":{"counts":{"0":400,"1":624}}},"status":"DONE"}],"shots":1024,"status":"COMPLETED"})fakeGetResults";
+
+	auto fakeClient = std::make_shared<FakeRestClient>(fakeLogin, fakeBackends,
+			fakePostResultSim, fakeGetResults);
+
+	IBMAccelerator acc(fakeClient);
+	acc.initialize();
+	auto buffer = acc.createBuffer("qubits", 1);
+
+	auto f = std::make_shared<GateFunction>("f");
+	f->addInstruction(std::make_shared<Hadamard>(0));
+	f->addInstruction(std::make_shared<Measure>(0, 0));
+
+	acc.execute(buffer, f);
+
+	// The standard error drops below 0.02 after 3072 shots, by
+	// then a fourth chunk is already queued and is merged too
+	EXPECT_TRUE(boost::contains(fakeClient->lastPost, "\"shots\":1024"));
+	EXPECT_EQ(4096,
+			std::dynamic_pointer_cast<IBMAcceleratorBuffer>(buffer)->getNumberOfShots());
+	EXPECT_NEAR((400.0 - 624.0) / 1024.0, buffer->getExpectationValueZ(), 1e-12);
+
+	// An unreachable target stops at the shot cap
+	xacc::setOption("ibm-target-error", "0.001");
+	xacc::setOption("ibm-max-shots", "2048");
+	auto capped = acc.createBuffer("capped", 1);
+	acc.execute(capped, f);
+	EXPECT_EQ(2048,
+			std::dynamic_pointer_cast<IBMAcceleratorBuffer>(capped)->getNumberOfShots());
+
+	// Chunks are not corrected for readout errors
+	xacc::setOption("ibm-correct-assignment-errors", "");
+	EXPECT_DEATH(acc.execute(capped, f), "");
+	RuntimeOptions::instance()->erase("ibm-correct-assignment-errors");
+
+	RuntimeOptions::instance()->erase("ibm-target-error");
+	RuntimeOptions::instance()->erase("ibm-chunk-shots");
+	RuntimeOptions::instance()->erase("ibm-max-shots");
+	xacc::Finalize();
+}
+
+TEST(IBMAcceleratorTester,checkParameterSweep) {
+        xacc::Initialize();
+        xacc::setOption("ibm-api-key", "hello");
+        xacc::setOption("ibm-api-url", "hello");
+
+	const std::string fakeGetResults = R"fakeGetResults({"backend":{"name":"ibmqx_qasm_simulator"},"id":"fd386cfd16b707b6f5d8ece36d6f7c3b","qasms":[{"qasm":"","result":{"data":{"counts":{"0":1000,"1":24}}},"status":"DONE"},{"qasm":"","result":{"data":{"counts":{"0":300,"1":724}}},"status":"DONE"}],"shots":1024,"status":"COMPLETED"})fakeGetResults";
+
+	auto fakeClient = std::make_shared<FakeRestClient>(fakeLogin, fakeBackends,
+			fakePostResultSim, fakeGetResults);
+
+	IBMAccelerator acc(fakeClient);
+	acc.initialize();
+	auto buffer = acc.createBuffer("qubits", 1);
+
+	InstructionParameter theta(std::string("theta"));
+	auto f = std::make_shared<GateFunction>("f",
+			std::vector<InstructionParameter> { theta });
+	auto rx = std::make_shared<Rx>(0, 0.0);
+	rx->setParameter(0, theta);
+	f->addInstruction(rx);
+	f->addInstruction(std::make_shared<Measure>(0, 0));
+
+	auto results = acc.executeSweep(buffer,
+			std::vector<std::shared_ptr<Function>> { f }, { { 0.5 }, { 1.5 } });
+
+	// Both rows go in one job, indexed by row then kernel
+	EXPECT_EQ(2, countCircuits(fakeClient->lastPost));
+	EXPECT_EQ(2, results.size());
+	EXPECT_EQ(1, results[0].size());
+	EXPECT_EQ("qubits0", results[0][0]->name());
+	EXPECT_EQ("qubits1", results[1][0]->name());
+	EXPECT_NEAR((1000.0 - 24.0) / 1024.0, results[0][0]->getExpectationValueZ(), 1e-12);
+	EXPECT_NEAR((300.0 - 724.0) / 1024.0, results[1][0]->getExpectationValueZ(), 1e-12);
+
+	// The kernel itself is left unbound
+	EXPECT_EQ(3, rx->getParameter(0).which());
+
+	// A dry run sweep compiles the rows without submitting them
+	xacc::setOption("ibm-dry-run", "");
+	auto submitted = fakeClient->lastPost;
+	results = acc.executeSweep(buffer,
+			std::vector<std::shared_ptr<Function>> { f }, { { 0.1 }, { 0.2 } });
+	EXPECT_EQ(submitted, fakeClient->lastPost);
+	EXPECT_EQ(2, acc.getDryRunReport().nCircuits);
+	EXPECT_EQ("qubits1", results[1][0]->name());
+
+	RuntimeOptions::instance()->erase("ibm-dry-run");
+	xacc::Finalize();
+}
+
+TEST(IBMAcceleratorTester,checkParameterShiftGradient) {
+        xacc::Initialize();
+        xacc::setOption("ibm-api-key", "hello");
+        xacc::setOption("ibm-api-url", "hello");
+
+	// The unshifted kernel, then theta +- pi/2 in Rx and -theta +- pi/2 in Ry
+	const std::string fakeGetResults = R"fakeGetResults({"backend":{"name":"ibmqx_qasm_simulator"},"id":"fd386cfd16b707b6f5d8ece36d6f7c3b","qasms":[{"qasm":"","result":{"data":{"counts":{"0":512,"1":512}}},"status":"DONE"},{"qasm":"","result":{"data":{"counts":{"0":1024}}},"status":"DONE"},{"qasm":"","result":{"data":{"counts":{"1":1024}}},"status":"DONE"},{"qasm":"","result":{"data":{"counts":{"0":768,"1":256}}},"status":"DONE"},{"qasm":"","result":{"data":{"counts":{"0":256,"1":768}}},"status":"DONE"}],"shots":1024,"status":"COMPLETED"})fakeGetResults";
+
+	auto fakeClient = std::make_shared<FakeRestClient>(fakeLogin, fakeBackends,
+			fakePostResultSim, fakeGetResults);
+
+	IBMAccelerator acc(fakeClient);
+	acc.initialize();
+	auto buffer = acc.createBuffer("qubits", 1);
+
+	InstructionParameter theta(std::string("theta"));
+	InstructionParameter minusTheta(std::string("-theta"));
+	auto f = std::make_shared<GateFunction>("f",
+			std::vector<InstructionParameter> { theta });
+	auto rx = std::make_shared<Rx>(0, 0.0);
+	rx->setParameter(0, theta);
+	auto ry = std::make_shared<Ry>(0, 0.0);
+	ry->setParameter(0, minusTheta);
+	f->addInstruction(rx);
+	f->addInstruction(ry);
+	f->addInstruction(std::make_shared<Measure>(0, 0));
+
+	auto gradient = acc.executeGradient(buffer, f, { 0.3 });
+
+	EXPECT_EQ(5, countCircuits(fakeClient->lastPost));
+
+	EXPECT_NEAR(0.0, gradient.expectation, 1e-12);
+	EXPECT_EQ(4, gradient.terms.size());
+	EXPECT_EQ(0, gradient.terms[2].parameter);
+	EXPECT_EQ(1, gradient.terms[2].gate);
+	EXPECT_NEAR(0.5, gradient.terms[2].expectation, 1e-12);
+
+	// (1 - -1) / 2 - (0.5 - -0.5) / 2
+	EXPECT_EQ(1, gradient.gradient.size());
+	EXPECT_NEAR(0.5, gradient.gradient[0], 1e-12);
+
+	xacc::Finalize();
+}
+
+TEST(IBMAcceleratorTester,checkGradientOfRepeatedComposite) {
+        xacc::Initialize();
+        xacc::setOption("ibm-api-key", "hello");
+        xacc::setOption("ibm-api-url", "hello");
+        xacc::setOption("ibm-no-gate-fusion", "");
+        xacc::setOption("ibm-no-circuit-deduplication", "");
+
+	// The unshifted kernel, then each call of the layer shifted up and down
+	const std::string fakeGetResults = R"fakeGetResults({"backend":{"name":"ibmqx_qasm_simulator"},"id":"fd386cfd16b707b6f5d8ece36d6f7c3b","qasms":[{"qasm":"","result":{"data":{"counts":{"0":512,"1":512}}},"status":"DONE"},{"qasm":"","result":{"data":{"counts":{"0":1024}}},"status":"DONE"},{"qasm":"","result":{"data":{"counts":{"1":1024}}},"status":"DONE"},{"qasm":"","result":{"data":{"counts":{"0":768,"1":256}}},"status":"DONE"},{"qasm":"","result":{"data":{"counts":{"0":256,"1":768}}},"status":"DONE"}],"shots":1024,"status":"COMPLETED"})fakeGetResults";
+
+	auto fakeClient = std::make_shared<FakeRestClient>(fakeLogin, fakeBackends,
+			fakePostResultSim, fakeGetResults);
+
+	IBMAccelerator acc(fakeClient);
+	acc.initialize();
+	auto buffer = acc.createBuffer("qubits", 1);
+
+	InstructionParameter theta(std::string("theta"));
+	auto layer = std::make_shared<GateFunction>("layer",
+			std::vector<InstructionParameter> { theta });
+	auto rx = std::make_shared<Rx>(0, 0.0);
+	rx->setParameter(0, theta);
+	layer->addInstruction(rx);
+
+	auto f = std::make_shared<GateFunction>("f",
+			std::vector<InstructionParameter> { theta });
+	f->addInstruction(layer);
+	f->addInstruction(layer);
+	f->addInstruction(std::make_shared<Measure>(0, 0));
+
+	auto gradient = acc.executeGradient(buffer, f, { 0.3 });
+
+	// Each call of the layer is shifted on its own
+	EXPECT_EQ(5, countCircuits(fakeClient->lastPost));
+	EXPECT_EQ(4, gradient.terms.size());
+	EXPECT_EQ(0, gradient.terms[1].gate);
+	EXPECT_EQ(1, gradient.terms[2].gate);
+
+	// (1 - -1) / 2 + (0.5 - -0.5) / 2
+	EXPECT_NEAR(1.5, gradient.gradient[0], 1e-12);
+
+	RuntimeOptions::instance()->erase("ibm-no-gate-fusion");
+	RuntimeOptions::instance()->erase("ibm-no-circuit-deduplication");
+	xacc::Finalize();
+}
+
+TEST(IBMAcceleratorTester,checkGradientOfScaledAngle) {
+        xacc::Initialize();
+        xacc::setOption("ibm-api-key", "hello");
+        xacc::setOption("ibm-api-url", "hello");
+
+	EXPECT_TRUE(mentionsVariable("0.5*theta", "theta"));
+	EXPECT_TRUE(mentionsVariable("theta+1", "theta"));
+	EXPECT_FALSE(mentionsVariable("theta2", "theta"));
+	EXPECT_FALSE(mentionsVariable("2*phi", "theta"));
+
+	auto fakeClient = std::make_shared<FakeRestClient>(fakeLogin, fakeBackends,
+			fakePostResultSim, fakeGetResultsSim);
+
+	IBMAccelerator acc(fakeClient);
+	acc.initialize();
+	auto buffer = acc.createBuffer("qubits", 1);
+
+	// The shift rule of 2*theta needs a factor 2, which is not
+	// supported, so it is an error rather than a wrong gradient
+	InstructionParameter theta(std::string("theta"));
+	auto rx = std::make_shared<Rx>(0, 0.0);
+	rx->setParameter(0, InstructionParameter(std::string("2*theta")));
+	auto f = std::make_shared<GateFunction>("f",
+			std::vector<InstructionParameter> { theta });
+	f->addInstruction(rx);
+	f->addInstruction(std::make_shared<Measure>(0, 0));
+
+	EXPECT_DEATH(acc.executeGradient(buffer, f, { 0.3 }), "");
+	EXPECT_FALSE(boost::contains(fakeClient->lastPost, "qasms"));
+
+	xacc::Finalize();
+}
+
+TEST(IBMAcceleratorTester,checkClassicalShadow) {
+        xacc::Initialize();
+        xacc::setOption("ibm-api-key", "hello");
+        xacc::setOption("ibm-api-url", "hello");
+
+	const std::string fakeGetResults = R"fakeGetResults({"backend":{"name":"ibmqx_qasm_simulator"},"id":"fd386cfd16b707b6f5d8ece36d6f7c3b","qasms":[{"qasm":"","result":{"data":{"counts":{"0 0":2}}},"status":"DONE"},{"qasm":"","result":{"data":{"counts":{"0 0":1,"1 1":1}}},"status":"DONE"},{"qasm":"","result":{"data":{"counts":{"1 1":2}}},"status":"DONE"}],"shots":2,"status":"COMPLETED"})fakeGetResults";
+
+	auto fakeClient = std::make_shared<FakeRestClient>(fakeLogin, fakeBackends,
+			fakePostResultSim, fakeGetResults);
+
+	IBMAccelerator acc(fakeClient);
+	acc.initialize();
+	auto buffer = acc.createBuffer("qubits", 2);
+
+	auto prep = std::make_shared<GateFunction>("prep");
+	prep->addInstruction(std::make_shared<Hadamard>(0));
+	prep->addInstruction(std::make_shared<CNOT>(0, 1));
+
+	auto shadow = acc.executeShadow(buffer, prep, 3, 2);
+
+	// One circuit per random basis, even if two bases coincide
+	EXPECT_EQ(3, countCircuits(fakeClient->lastPost));
+	EXPECT_TRUE(boost::contains(fakeClient->lastPost, "\"shots\": 2"));
+
+	EXPECT_EQ(2, shadow->getNumberOfQubits());
+	EXPECT_EQ(6, shadow->size());
+	EXPECT_NEAR(1.0, shadow->expectation(""), 1e-12);
+
+	xacc::Finalize();
+}
+
+TEST(IBMAcceleratorTester,checkCircuitDeduplication) {
+        xacc::Initialize();
+        xacc::setOption("ibm-api-key", "hello");
+        xacc::setOption("ibm-api-url", "hello");
+
+	const std::string fakeGetResults = R"fakeGetResults({"backend":{"name":"ibmqx_qasm_simulator"},"id":"fd386cfd16b707b6f5d8ece36d6f7c3b","qasms":[{"qasm":"","result":{"data":{"counts":{"0":400,"1":624}}},"status":"DONE"},{"qasm":"","result":{"data":{"counts":{"1":1024}}},"status":"DONE"}],"shots":1024,"status":"COMPLETED"})fakeGetResults";
+
+	auto fakeClient = std::make_shared<FakeRestClient>(fakeLogin, fakeBackends,
+			fakePostResultSim, fakeGetResults);
+
+	IBMAccelerator acc(fakeClient);
+	acc.initialize();
+	auto buffer = acc.createBuffer("qubits", 1);
+
+	// Two copies of the same circuit and a different one
+	auto f1 = std::make_shared<GateFunction>("f1");
+	f1->addInstruction(std::make_shared<Hadamard>(0));
+	f1->addInstruction(std::make_shared<Measure>(0, 0));
+
+	auto f2 = std::make_shared<GateFunction>("f2");
+	f2->addInstruction(std::make_shared<Hadamard>(0));
+	f2->addInstruction(std::make_shared<Measure>(0, 0));
+
+	auto g = std::make_shared<GateFunction>("g");
+	g->addInstruction(std::make_shared<X>(0));
+	g->addInstruction(std::make_shared<Measure>(0, 0));
+
+	auto buffers = acc.execute(buffer,
+			std::vector<std::shared_ptr<Function>> { f1, g, f2 });
+
+	EXPECT_EQ(2, countCircuits(fakeClient->lastPost));
+
+	// Both copies read the histogram of the one submitted
+	EXPECT_EQ(3, buffers.size());
+	EXPECT_NEAR((400.0 - 624.0) / 1024.0, buffers[0]->getExpectationValueZ(), 1e-12);
+	EXPECT_NEAR(-1.0, buffers[1]->getExpectationValueZ(), 1e-12);
+	EXPECT_NEAR((400.0 - 624.0) / 1024.0, buffers[2]->getExpectationValueZ(), 1e-12);
+
+	xacc::Finalize();
+}
+
+TEST(IBMAcceleratorTester,checkSharedPrefixLowering) {
+        xacc::Initialize();
+        xacc::setOption("ibm-api-key", "hello");
+        xacc::setOption("ibm-api-url", "hello");
+        xacc::setOption("ibm-no-measurement-grouping", "");
+
+	const std::string fakeGetResults = R"fakeGetResults({"backend":{"name":"ibmqx_qasm_simulator"},"id":"fd386cfd16b707b6f5d8ece36d6f7c3b","qasms":[{"qasm":"","result":{"data":{"counts":{"00":512,"11":512}}},"status":"DONE"},{"qasm":"","result":{"data":{"counts":{"00":1024}}},"status":"DONE"}],"shots":1024,"status":"COMPLETED"})fakeGetResults";
+
+	auto fakeClient = std::make_shared<FakeRestClient>(fakeLogin, fakeBackends,
+			fakePostResultSim, fakeGetResults);
+
+	IBMAccelerator acc(fakeClient);
+	acc.initialize();
+	auto buffer = acc.createBuffer("qubits", 3);
+
+	// The state preparation ends on a CNOT, so no gate
+	// fusion run crosses the end of the prefix
+	auto makePrep = []() {
+		auto prep = std::make_shared<GateFunction>("prep");
+		prep->addInstruction(std::make_shared<Hadamard>(0));
+		prep->addInstruction(std::make_shared<CNOT>(0, 1));
+		return prep;
+	};
+	auto makeKernels = [](std::shared_ptr<GateFunction> fPrep,
+			std::shared_ptr<GateFunction> gPrep) {
+		auto f = std::make_shared<GateFunction>("f");
+		f->addInstruction(fPrep);
+		f->addInstruction(std::make_shared<Measure>(0, 0));
+		f->addInstruction(std::make_shared<Measure>(1, 1));
+
+		auto g = std::make_shared<GateFunction>("g");
+		g->addInstruction(gPrep);
+		g->addInstruction(std::make_shared<Hadamard>(0));
+		g->addInstruction(std::make_shared<Hadamard>(1));
+		g->addInstruction(std::make_shared<X>(2));
+		g->addInstruction(std::make_shared<Measure>(0, 0));
+		g->addInstruction(std::make_shared<Measure>(1, 1));
+		return std::vector<std::shared_ptr<Function>> { f, g };
+	};
+
+	// Both kernels call the same prefix, it is lowered once. The
+	// unmeasured X is pruned without unsharing the prefix.
+	auto prep = makePrep();
+	acc.execute(buffer, makeKernels(prep, prep));
+	EXPECT_EQ(1, acc.getNumberOfReusedPrefixes());
+	EXPECT_FALSE(boost::contains(fakeClient->lastPost, "x q["));
+	auto shared = fakeClient->lastPost;
+
+	// Each kernel has its own copy, so each is lowered in place
+	acc.execute(buffer, makeKernels(makePrep(), makePrep()));
+	EXPECT_EQ(0, acc.getNumberOfReusedPrefixes());
+	EXPECT_EQ(fakeClient->lastPost, shared);
+
+	RuntimeOptions::instance()->erase("ibm-no-measurement-grouping");
+	xacc::Finalize();
+}
+
+TEST(IBMAcceleratorTester,checkPrecompiledKernels) {
+        xacc::Initialize();
+        xacc::setOption("ibm-api-key", "hello");
+        xacc::setOption("ibm-api-url", "hello");
+
+	auto path = (boost::filesystem::temp_directory_path()
+			/ boost::filesystem::unique_path()).string();
+	xacc::setOption("ibm-kernel-file", path);
+
+	auto fakeClient = std::make_shared<FakeRestClient>(fakeLogin, fakeBackends,
+			fakePostResultSim, fakeGetResultsSim);
+
+	IBMAccelerator acc(fakeClient);
+	acc.initialize();
+
+	auto f = std::make_shared<GateFunction>("foo");
+	f->addInstruction(std::make_shared<Hadamard>(0));
+	f->addInstruction(std::make_shared<Measure>(0, 0));
+
+	const std::string src = "__qpu__ foo(qbit qreg) {}";
+	EXPECT_TRUE(acc.loadPrecompiledKernels(src).empty());
+	acc.savePrecompiledKernels(src,
+			std::vector<std::shared_ptr<Function>> { f });
+
+	auto kernels = acc.loadPrecompiledKernels(src);
+	EXPECT_EQ(1, kernels.size());
+	EXPECT_EQ("foo", kernels[0]->name());
+	EXPECT_EQ(2, kernels[0]->nInstructions());
+
+	// Another source, or the same one compiled with other passes
+	// or for another backend
+	EXPECT_TRUE(acc.loadPrecompiledKernels(src + " ").empty());
+	xacc::setOption("ibm-schedule", "asap");
+	EXPECT_TRUE(acc.loadPrecompiledKernels(src).empty());
+	RuntimeOptions::instance()->erase("ibm-schedule");
+	xacc::setOption("ibm-no-gate-cancellation", "");
+	EXPECT_TRUE(acc.loadPrecompiledKernels(src).empty());
+	RuntimeOptions::instance()->erase("ibm-no-gate-cancellation");
+	EXPECT_EQ(1, acc.loadPrecompiledKernels(src).size());
+	xacc::setOption("ibm-backend", "ibmqx5");
+	EXPECT_TRUE(acc.loadPrecompiledKernels(src).empty());
+
+	boost::filesystem::remove(path);
+	RuntimeOptions::instance()->erase("ibm-backend");
+	RuntimeOptions::instance()->erase("ibm-kernel-file");
+	xacc::Finalize();
+}
+
+TEST(IBMAcceleratorTester,checkResultCache) {
+        xacc::Initialize();
+        xacc::setOption("ibm-api-key", "hello");
+        xacc::setOption("ibm-api-url", "hello");
+
+	auto directory = boost::filesystem::temp_directory_path()
+			/ boost::filesystem::unique_path();
+	xacc::setOption("ibm-result-cache", directory.string());
+
+	auto fakeClient = std::make_shared<FakeRestClient>(fakeLogin, fakeBackends,
+			fakePostResultSim, fakeGetResultsSim);
+
+	IBMAccelerator acc(fakeClient);
+	acc.initialize();
+
+	auto f = std::make_shared<GateFunction>("foo");
+	f->addInstruction(std::make_shared<Hadamard>(0));
+	f->addInstruction(std::make_shared<Measure>(0, 0));
+
+	auto buffer = acc.createBuffer("qubits", 1);
+	acc.execute(buffer, f);
+	EXPECT_FALSE(fakeClient->lastPost.empty());
+	auto expected = buffer->getExpectationValueZ();
+
+	// The second run is served from the cache
+	fakeClient->lastPost = "";
+	auto cached = acc.createBuffer("cached", 1);
+	acc.execute(cached, f);
+	EXPECT_TRUE(fakeClient->lastPost.empty());
+	EXPECT_NEAR(expected, cached->getExpectationValueZ(), 1e-12);
+	EXPECT_EQ(1, acc.getResultCache()->getHits());
+
+	// Bypassing the cache submits the circuit again
+	xacc::setOption("ibm-result-cache-bypass", "");
+	auto refreshed = acc.createBuffer("refreshed", 1);
+	acc.execute(refreshed, f);
+	EXPECT_FALSE(fakeClient->lastPost.empty());
+
+	RuntimeOptions::instance()->erase("ibm-result-cache-bypass");
+	RuntimeOptions::instance()->erase("ibm-result-cache");
+	boost::filesystem::remove_all(directory);
+	xacc::Finalize();
+}
+
+TEST(IBMAcceleratorTester,checkReadoutCalibration) {
+        xacc::Initialize();
+        xacc::setOption("ibm-api-key", "hello");
+        xacc::setOption("ibm-api-url", "hello");
+	xacc::setOption("ibm-correct-assignment-errors", "");
+
+	// The kernel, then the calibration kernels preparing 0 and 1
+	const std::string fakeGetResults = R"fakeGetResults({"backend":{"name":"ibmqx_qasm_simulator"},"id":"fd386cfd16b707b6f5d8ece36d6f7c3b","qasms":[{"qasm":"","result":{"data":{"counts":{"0":500,"1":524}}},"status":"DONE"},{"qasm":"","result":{"data":{"counts":{"0":922,"1":102}}},"status":"DONE"},{"qasm":"","result":{"data":{"counts":{"0":205,"1":819}}},"status":"DONE"}],"shots":1024,"status":"COMPLETED"})fakeGetResults";
+
+	auto fakeClient = std::make_shared<FakeRestClient>(fakeLogin, fakeBackends,
+			fakePostResultSim, fakeGetResults);
+
+	IBMAccelerator acc(fakeClient);
+	acc.initialize();
+
+	auto f = std::make_shared<GateFunction>("foo");
+	f->addInstruction(std::make_shared<Hadamard>(0));
+	f->addInstruction(std::make_shared<Measure>(0, 0));
+
+	auto buffer = acc.createBuffer("qubits", 1);
+	acc.execute(buffer, f);
+	EXPECT_EQ(3, countCircuits(fakeClient->lastPost));
+
+	// Tensor inverse of the 2x2 assignment matrix on qubit 0
+	auto p01 = 102.0 / 1024.0;
+	auto p10 = 205.0 / 1024.0;
+	auto p0 = 500.0 / 1024.0;
+	auto p1 = 524.0 / 1024.0;
+	auto expected = ((1.0 - p10 + p01) * p0 - (1.0 - p01 + p10) * p1)
+			/ (1.0 - p01 - p10);
+	EXPECT_NEAR(expected, buffer->getExpectationValueZ(), 1e-12);
+
+	// The calibration is reused by the next job
+	auto next = acc.createBuffer("next", 1);
+	acc.execute(next, f);
+	EXPECT_EQ(1, countCircuits(fakeClient->lastPost));
+	EXPECT_NEAR(expected, next->getExpectationValueZ(), 1e-12);
+
+	// On one qubit the subspace solver agrees with the tensor inverse
+	xacc::setOption("ibm-readout-mitigation-distance", "1");
+	EXPECT_NEAR(expected, next->getExpectationValueZ(), 1e-8);
+	RuntimeOptions::instance()->erase("ibm-readout-mitigation-distance");
+
+	RuntimeOptions::instance()->erase("ibm-correct-assignment-errors");
+	xacc::Finalize();
+}
+
+TEST(IBMAcceleratorTester,checkPhysicalReadoutCalibration) {
+        xacc::Initialize();
+        xacc::setOption("ibm-api-key", "hello");
+        xacc::setOption("ibm-api-url", "hello");
+        xacc::setOption("ibm-backend", "ibmqx5");
+	xacc::setOption("ibm-correct-assignment-errors", "");
+
+	auto fakeClient = std::make_shared<FakeRestClient>(fakeLogin, fakeBackends,
+			fakePostResultSim, fakeGetResultsSim);
+
+	IBMAccelerator acc(fakeClient);
+	acc.initialize();
+	auto buffer = acc.createBuffer("qubits", 4);
+
+	// Logical qubit 0 interacts with three others, so it is placed
+	// on a physical qubit with three couplers, not on qubit 0
+	auto f = std::make_shared<GateFunction>("star");
+	f->addInstruction(std::make_shared<CNOT>(0, 1));
+	f->addInstruction(std::make_shared<CNOT>(0, 2));
+	f->addInstruction(std::make_shared<CNOT>(0, 3));
+	f->addInstruction(std::make_shared<Measure>(0, 0));
+
+	std::shared_ptr<IR> ir = std::make_shared<GateIR>();
+	ir->addKernel(f);
+	for (auto t : acc.getIRTransformations()) {
+		ir = t->transform(ir);
+	}
+	auto compiled = ir->getKernels()[0];
+
+	int physical = -1;
+	std::set<int> active;
+	InstructionIterator it(compiled);
+	while (it.hasNext()) {
+		auto nextInst = it.next();
+		if (nextInst->isComposite()) {
+			continue;
+		}
+		auto bits = nextInst->bits();
+		active.insert(bits.begin(), bits.end());
+		if (nextInst->name() == "Measure") {
+			physical = bits[0];
+		}
+	}
+	EXPECT_NE(0, physical);
+	EXPECT_EQ(4, active.size());
+
+	// Only the measured physical qubit has readout errors
+	// on its own, the others flip together
+	auto bitStr = [](const std::set<int>& ones) {
+		std::string bits(16, '0');
+		for (auto q : ones) {
+			bits[15 - q] = '1';
+		}
+		return "\"" + bits + "\"";
+	};
+	auto others = active;
+	others.erase(physical);
+	fakeClient->setResults(R"({"backend":{"name":"ibmqx5"},"id":"fd386cfd16b707b6f5d8ece36d6f7c3b","qasms":[)"
+			"{\"qasm\":\"\",\"result\":{\"data\":{\"counts\":{" + bitStr({ }) + ":500,"
+			+ bitStr({ physical }) + ":524}}},\"status\":\"DONE\"},"
+			"{\"qasm\":\"\",\"result\":{\"data\":{\"counts\":{" + bitStr({ }) + ":624,"
+			+ bitStr({ physical }) + ":100," + bitStr(others) + ":300}}},\"status\":\"DONE\"},"
+			"{\"qasm\":\"\",\"result\":{\"data\":{\"counts\":{" + bitStr(active) + ":824,"
+			+ bitStr(others) + ":200}}},\"status\":\"DONE\"}"
+			R"(],"shots":1024,"status":"COMPLETED"})");
+
+	acc.execute(buffer, compiled);
+
+	auto p01 = 100.0 / 1024.0;
+	auto p10 = 200.0 / 1024.0;
+	auto p0 = 500.0 / 1024.0;
+	auto p1 = 524.0 / 1024.0;
+	auto expected = ((1.0 - p10 + p01) * p0 - (1.0 - p01 + p10) * p1)
+			/ (1.0 - p01 - p10);
+	EXPECT_NEAR(expected, buffer->getExpectationValueZ(), 1e-12);
+
+	RuntimeOptions::instance()->erase("ibm-correct-assignment-errors");
+	RuntimeOptions::instance()->erase("ibm-backend");
+	xacc::Finalize();
+}
+
+/**
+ * Stand-in for the IBM server that only accepts gzip encoded
+ * job submissions and answers with gzip encoded documents.
+ */
+class FakeCompressingServer : public FakeRestClient {
+public:
+
+	std::string lastInflatedPost;
+	int nCompressedResponses = 0;
+
+	FakeCompressingServer(const std::string& login,
+			const std::string& initBackends, const std::string& post,
+			const std::string& results) :
+			FakeRestClient(login, initBackends, post, results) {
+	}
+
+	virtual const std::string post(const std::string& remoteUrl,
+			const std::string& path, const std::string& postStr,
+			std::map<std::string, std::string> headers = std::map<std::string,
+					std::string> { }) {
+		auto response = FakeRestClient::post(remoteUrl, path, postStr, headers);
+		if (path == "/api/users/loginWithToken") {
+			EXPECT_EQ(0, headers.count("Content-Encoding"));
+			EXPECT_FALSE(IBMCompressedClient::isCompressed(postStr));
+			EXPECT_TRUE(boost::contains(postStr, "apiToken"));
+			return response;
+		}
+
+		EXPECT_EQ("gzip", headers["Content-Encoding"]);
+		std::vector<char> inflated;
+		auto size = IBMCompressedClient::decompress(postStr, inflated);
+		lastInflatedPost = std::string(inflated.data(), size);
+		return encode(response, headers);
+	}
+
+	virtual const std::string get(const std::string& remoteUrl,
+			const std::string& path,
+			std::map<std::string, std::string> headers = std::map<std::string,
+					std::string> { }) {
+		return encode(FakeRestClient::get(remoteUrl, path, headers), headers);
+	}
+
+	std::string encode(const std::string& response,
+			std::map<std::string, std::string>& headers) {
+		if (boost::contains(headers["Accept-Encoding"], "gzip")) {
+			nCompressedResponses++;
+			return IBMCompressedClient::compress(response);
+		}
+		return response;
+	}
+};
+
+TEST(IBMAcceleratorTester,checkCompressedPayloads) {
+        xacc::Initialize();
+        xacc::setOption("ibm-api-key", "hello");
+        xacc::setOption("ibm-api-url", "hello");
+        xacc::setOption("ibm-compress-payloads", "");
+        xacc::setOption("ibm-compression-threshold", "0");
+
+	auto server = std::make_shared<FakeCompressingServer>(fakeLogin,
+			fakeBackends, fakePostResultSim, fakeGetResultsSim);
+
+	IBMAccelerator acc(server);
+	acc.initialize();
+	auto buffer = acc.createBuffer("qubits", 3);
+
+	auto f = std::make_shared<GateFunction>("foo");
+	f->addInstruction(std::make_shared<X>(0));
+	f->addInstruction(std::make_shared<Measure>(0, 0));
+	f->addInstruction(std::make_shared<Measure>(1, 1));
+	f->addInstruction(std::make_shared<Measure>(2, 2));
+
+	acc.execute(buffer, f);
+
+	EXPECT_TRUE(boost::contains(server->lastInflatedPost, "\"qasms\""));
+	EXPECT_TRUE(server->nCompressedResponses > 0);
+
+	// Results were inflated and decoded, 1 0 1 and 1 1 0 have
+	// even parity, 1 0 0 and 1 1 1 odd.
+	EXPECT_NEAR((267.0 + 241.0 - 263.0 - 253.0) / 1024.0,
+			buffer->getExpectationValueZ(), 1e-12);
+
+	RuntimeOptions::instance()->erase("ibm-compress-payloads");
+	RuntimeOptions::instance()->erase("ibm-compression-threshold");
+	xacc::Finalize();
+}
+
 int main(int argc, char** argv) {
    ::testing::InitGoogleTest(&argc, argv);
    return RUN_ALL_TESTS();
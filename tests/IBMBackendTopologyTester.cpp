@@ -0,0 +1,85 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#include <gtest/gtest.h>
+#include "IBMBackendTopology.hpp"
+
+using namespace xacc;
+using namespace xacc::quantum;
+
+TEST(IBMBackendTopologyTester,checkCouplingMap) {
+
+	// 1 -> 0 -> 2 <- 3, and 4 on its own
+	IBMBackendTopology topology(
+			std::vector<std::pair<int,int>> {{1,0},{0,2},{3,2}}, 5);
+
+	EXPECT_EQ(5, topology.size());
+	EXPECT_FALSE(topology.isComplete());
+
+	EXPECT_TRUE(topology.isCoupled(1, 0));
+	EXPECT_FALSE(topology.isCoupled(0, 1));
+	EXPECT_TRUE(topology.isAdjacent(0, 1));
+	EXPECT_FALSE(topology.isCoupled(7, 0));
+
+	EXPECT_EQ(2, topology.neighbors(0).count());
+	EXPECT_TRUE(topology.neighbors(2)[3]);
+
+	EXPECT_EQ(0, topology.distance(1, 1));
+	EXPECT_EQ(3, topology.distance(1, 3));
+	EXPECT_EQ(3, topology.distance(3, 1));
+	EXPECT_TRUE(topology.distance(4, 0) > 5);
+
+	// Every call gets its own graph, changing
+	// one leaves the topology as it was
+	auto graph = topology.getGraph();
+	EXPECT_NE(graph, topology.getGraph());
+	EXPECT_EQ(5, graph->order());
+	EXPECT_EQ(3, graph->size());
+	graph->addEdge(0, 4);
+	EXPECT_EQ(3, topology.getGraph()->size());
+}
+
+TEST(IBMBackendTopologyTester,checkCompleteGraph) {
+
+	IBMBackendTopology topology(std::vector<std::pair<int,int>> { }, 24);
+
+	EXPECT_EQ(24, topology.size());
+	EXPECT_TRUE(topology.isComplete());
+	EXPECT_TRUE(topology.isCoupled(3, 17));
+	EXPECT_FALSE(topology.isCoupled(3, 3));
+	EXPECT_EQ(1, topology.distance(0, 23));
+	EXPECT_EQ(23, topology.neighbors(5).count());
+	EXPECT_EQ(24 * 23 / 2, topology.getGraph()->size());
+}
+
+int main(int argc, char** argv) {
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
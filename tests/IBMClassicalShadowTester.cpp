@@ -0,0 +1,114 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#include <gtest/gtest.h>
+#include "IBMClassicalShadow.hpp"
+
+using namespace xacc;
+using namespace xacc::quantum;
+
+TEST(IBMClassicalShadowTester,checkPauliEstimates) {
+
+	// Snapshots of the Bell state (|00> + |11>) / sqrt(2), measured
+	// in every pair of bases with every outcome it can give
+	IBMClassicalShadow shadow(2);
+	for (std::string bases : { "xx", "xy", "xz", "yx", "yy", "yz", "zx", "zy", "zz" }) {
+		for (int s = 0; s < 4; s++) {
+			boost::dynamic_bitset<> outcome(2);
+			outcome[0] = s & 1;
+			outcome[1] = s >> 1;
+			bool correlated = outcome[0] == outcome[1];
+			if (bases[0] != bases[1]) {
+				shadow.addSnapshots(bases, outcome);
+			} else if (bases == "yy" ? !correlated : correlated) {
+				shadow.addSnapshots(bases, outcome, 2);
+			}
+		}
+	}
+	EXPECT_EQ(9 * 4, shadow.size());
+
+	// One group is the plain mean over all snapshots
+	EXPECT_NEAR(1.0, shadow.expectation("Z0 Z1", 1), 1e-12);
+	EXPECT_NEAR(1.0, shadow.expectation("X0X1", 1), 1e-12);
+	EXPECT_NEAR(-1.0, shadow.expectation("Y0 Y1", 1), 1e-12);
+	EXPECT_NEAR(0.0, shadow.expectation("Z0", 1), 1e-12);
+	EXPECT_NEAR(0.0, shadow.expectation("X0 Z1", 1), 1e-12);
+	EXPECT_NEAR(1.0, shadow.expectation(""), 1e-12);
+
+	auto values = shadow.expectations({ "Z0 Z1", "Z1" }, 1);
+	EXPECT_EQ(2, values.size());
+	EXPECT_NEAR(0.0, values[1], 1e-12);
+}
+
+TEST(IBMClassicalShadowTester,checkDefaultGroups) {
+
+	// The Bell state again, as one circuit per basis of 200
+	// shots, each circuit's snapshots added in one block
+	IBMClassicalShadow shadow(2);
+	for (std::string bases : { "xx", "xy", "xz", "yx", "yy", "yz", "zx", "zy", "zz" }) {
+		for (int s = 0; s < 4; s++) {
+			boost::dynamic_bitset<> outcome(2);
+			outcome[0] = s & 1;
+			outcome[1] = s >> 1;
+			bool correlated = outcome[0] == outcome[1];
+			if (bases[0] != bases[1]) {
+				shadow.addSnapshots(bases, outcome, 50);
+			} else if (bases == "yy" ? !correlated : correlated) {
+				shadow.addSnapshots(bases, outcome, 100);
+			}
+		}
+	}
+	EXPECT_EQ(9 * 200, shadow.size());
+
+	// Every one of the 10 groups sees every basis
+	EXPECT_NEAR(1.0, shadow.expectation("Z0 Z1"), 1e-12);
+	EXPECT_NEAR(1.0, shadow.expectation("X0 X1"), 1e-12);
+	EXPECT_NEAR(-1.0, shadow.expectation("Y0 Y1"), 1e-12);
+	EXPECT_NEAR(0.0, shadow.expectation("Z0"), 1e-12);
+}
+
+TEST(IBMClassicalShadowTester,checkRandomBases) {
+	auto bases = IBMClassicalShadow::randomBases(3, 300, 0);
+	EXPECT_EQ(300, bases.size());
+	EXPECT_EQ(bases, IBMClassicalShadow::randomBases(3, 300, 0));
+
+	int nX = 0;
+	for (auto& b : bases) {
+		EXPECT_EQ(3, b.size());
+		EXPECT_EQ(std::string::npos, b.find_first_not_of("xyz"));
+		nX += std::count(b.begin(), b.end(), 'x');
+	}
+	EXPECT_TRUE(nX > 200 && nX < 400);
+}
+
+int main(int argc, char** argv) {
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -0,0 +1,148 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#include <gtest/gtest.h>
+#include "IBMGateCancellation.hpp"
+#include "IBMIRTransformation.hpp"
+#include "GateIR.hpp"
+#include "CNOT.hpp"
+#include "Hadamard.hpp"
+#include "Measure.hpp"
+#include "Rx.hpp"
+#include "Rz.hpp"
+#include "X.hpp"
+#include "XACC.hpp"
+
+using namespace xacc;
+using namespace xacc::quantum;
+
+std::vector<std::string> names(std::shared_ptr<Function> f) {
+	std::vector<std::string> result;
+	for (auto inst : f->getInstructions()) {
+		result.push_back(inst->name());
+	}
+	return result;
+}
+
+TEST(IBMGateCancellationTester,checkReversedCNOTs) {
+
+	// Only 0 -> 1 is coupled, so both CNOTs are reversed
+	std::vector<std::pair<int,int>> couplers {{0,1}};
+	IBMIRTransformation direction(couplers);
+	IBMGateCancellation cancellation;
+
+	auto f = std::make_shared<GateFunction>("foo");
+	f->addInstruction(std::make_shared<X>(1));
+	f->addInstruction(std::make_shared<CNOT>(1, 0));
+	f->addInstruction(std::make_shared<CNOT>(1, 0));
+	f->addInstruction(std::make_shared<Measure>(0, 0));
+
+	auto ir = std::make_shared<GateIR>();
+	ir->addKernel(f);
+
+	auto optimized = cancellation.transform(direction.transform(ir))->getKernels()[0];
+
+	// The two CNOTs and their Hadamards all cancel
+	EXPECT_EQ(10, cancellation.getNumberOfRemovedGates());
+	EXPECT_EQ(std::vector<std::string>({"X", "Measure"}), names(optimized));
+}
+
+TEST(IBMGateCancellationTester,checkCommutation) {
+
+	IBMGateCancellation cancellation;
+
+	auto f = std::make_shared<GateFunction>("foo");
+	f->addInstruction(std::make_shared<Rz>(0, 0.25));
+	f->addInstruction(std::make_shared<CNOT>(0, 1));
+	f->addInstruction(std::make_shared<Rz>(0, 0.5));
+	f->addInstruction(std::make_shared<X>(1));
+	f->addInstruction(std::make_shared<CNOT>(0, 1));
+	f->addInstruction(std::make_shared<Hadamard>(1));
+	f->addInstruction(std::make_shared<CNOT>(0, 1));
+
+	auto ir = std::make_shared<GateIR>();
+	ir->addKernel(f);
+
+	auto optimized = cancellation.transform(ir)->getKernels()[0];
+
+	// The Rz's merge through the control, the X commutes
+	// through the target so the first two CNOTs cancel,
+	// and the H blocks the last one
+	EXPECT_EQ(std::vector<std::string>({"Rz", "X", "H", "CNOT"}), names(optimized));
+	EXPECT_NEAR(0.75, boost::get<double>(optimized->getInstruction(0)->getParameter(0)), 1e-12);
+	EXPECT_EQ(3, cancellation.getNumberOfRemovedGates());
+}
+
+TEST(IBMGateCancellationTester,checkInverseRotations) {
+
+	IBMGateCancellation cancellation;
+
+	auto f = std::make_shared<GateFunction>("foo");
+	f->addInstruction(std::make_shared<Rx>(0, 0.5));
+	f->addInstruction(std::make_shared<Rx>(0, -0.5));
+	f->addInstruction(std::make_shared<Measure>(0, 0));
+
+	auto ir = std::make_shared<GateIR>();
+	ir->addKernel(f);
+
+	auto optimized = cancellation.transform(ir)->getKernels()[0];
+	EXPECT_EQ(std::vector<std::string>({"Measure"}), names(optimized));
+}
+
+TEST(IBMGateCancellationTester,checkUnchangedKernelsKeepComposites) {
+
+	IBMGateCancellation cancellation;
+
+	auto init = std::make_shared<GateFunction>("init");
+	init->addInstruction(std::make_shared<Hadamard>(0));
+	init->addInstruction(std::make_shared<CNOT>(0, 1));
+
+	auto f = std::make_shared<GateFunction>("foo");
+	f->addInstruction(init);
+	f->addInstruction(std::make_shared<Rx>(1, 0.5));
+	f->addInstruction(std::make_shared<Measure>(1, 0));
+
+	auto ir = std::make_shared<GateIR>();
+	ir->addKernel(f);
+
+	// Nothing cancels, so the kernel and its composite are kept as is
+	auto optimized = cancellation.transform(ir)->getKernels()[0];
+	EXPECT_EQ(0, cancellation.getNumberOfRemovedGates());
+	EXPECT_EQ(f, optimized);
+	EXPECT_EQ(init, optimized->getInstruction(0));
+}
+
+int main(int argc, char** argv) {
+   xacc::Initialize();
+   ::testing::InitGoogleTest(&argc, argv);
+   auto ret = RUN_ALL_TESTS();
+   xacc::Finalize();
+   return ret;
+}
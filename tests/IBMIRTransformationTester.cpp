@@ -183,6 +183,54 @@ TEST(IBMIRTransformationTester,checkCreation) {
 	EXPECT_TRUE(expected == ss.str());
 }
 
+TEST(IBMIRTransformationTester,checkSharedChildrenAcrossKernels) {
+
+	std::vector<std::pair<int,int>> couplers {{0,1}};
+
+	IBMIRTransformation t(couplers);
+
+	// A shared state preparation with one reversed CNOT
+	auto init = std::make_shared<GateFunction>("init");
+	init->addInstruction(std::make_shared<Hadamard>(1));
+	init->addInstruction(std::make_shared<CNOT>(1, 0));
+
+	auto ir = std::make_shared<GateIR>();
+	for (int i = 0; i < 8; i++) {
+		auto f = std::make_shared<GateFunction>("term" + std::to_string(i));
+		f->addInstruction(init);
+		f->addInstruction(std::make_shared<CNOT>(0, 1));
+		f->addInstruction(std::make_shared<Measure>(i % 2, 0));
+		ir->addKernel(f);
+	}
+
+	auto newir = t.transform(ir);
+
+	// The input IR is left untouched
+	EXPECT_EQ(2, init->nInstructions());
+
+	auto kernels = newir->getKernels();
+	EXPECT_EQ(8, kernels.size());
+	for (int i = 0; i < kernels.size(); i++) {
+		EXPECT_EQ("term" + std::to_string(i), kernels[i]->name());
+		EXPECT_EQ(3, kernels[i]->nInstructions());
+
+		auto newInit = std::dynamic_pointer_cast<Function>(
+				kernels[i]->getInstruction(0));
+		EXPECT_EQ(6, newInit->nInstructions());
+
+		auto cnot = newInit->getInstruction(3);
+		EXPECT_EQ("CNOT", cnot->name());
+		EXPECT_EQ(std::vector<int>({0, 1}), cnot->bits());
+
+		// The supported CNOT is kept as is
+		EXPECT_EQ(std::vector<int>({0, 1}), kernels[i]->getInstruction(1)->bits());
+
+		// The shared child is rewritten once and stays shared
+		EXPECT_EQ(kernels[0]->getInstruction(0), kernels[i]->getInstruction(0));
+		EXPECT_NE(init, newInit);
+	}
+}
+
 int main(int argc, char** argv) {
    xacc::Initialize();
    ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,119 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#include <gtest/gtest.h>
+#include "IBMInstructionScheduler.hpp"
+#include "IBMPassInstrumentation.hpp"
+#include "GateIR.hpp"
+#include "CNOT.hpp"
+#include "Hadamard.hpp"
+#include "Measure.hpp"
+#include "Rz.hpp"
+#include "X.hpp"
+#include "XACC.hpp"
+
+using namespace xacc;
+using namespace xacc::quantum;
+
+TEST(IBMInstructionSchedulerTester,checkCommutingReorder) {
+
+	auto context = std::make_shared<IBMCompilationContext>();
+	auto scheduler = std::make_shared<IBMInstructionScheduler>();
+	IBMPassInstrumentation instrumented(scheduler, context);
+
+	// The Rz on the CNOT control can move to the first layer
+	auto f = std::make_shared<GateFunction>("foo");
+	f->addInstruction(std::make_shared<Hadamard>(1));
+	f->addInstruction(std::make_shared<CNOT>(0, 1));
+	f->addInstruction(std::make_shared<Rz>(0, 0.5));
+	f->addInstruction(std::make_shared<Hadamard>(0));
+
+	auto ir = std::make_shared<GateIR>();
+	ir->addKernel(f);
+
+	auto scheduled = instrumented.transform(ir)->getKernels()[0];
+
+	std::vector<std::string> names;
+	for (auto inst : scheduled->getInstructions()) {
+		names.push_back(inst->name());
+	}
+	EXPECT_EQ(std::vector<std::string>({"H", "Rz", "CNOT", "H"}), names);
+
+	auto stats = context->getPassStatistics(scheduled);
+	EXPECT_EQ(1, stats.size());
+	EXPECT_EQ("ibm-instruction-scheduler", stats[0].pass);
+	EXPECT_EQ(4, stats[0].before.depth);
+	EXPECT_EQ(3, stats[0].after.depth);
+	EXPECT_EQ(4, stats[0].after.nGates);
+	EXPECT_EQ(1, stats[0].after.nTwoQubitGates);
+}
+
+TEST(IBMInstructionSchedulerTester,checkPolicies) {
+
+	std::vector<std::shared_ptr<Instruction>> instructions {
+			std::make_shared<X>(0), std::make_shared<Hadamard>(1),
+			std::make_shared<CNOT>(1, 2) };
+
+	EXPECT_EQ(std::vector<int>({0, 0, 1}),
+			IBMInstructionScheduler::schedule(instructions,
+					IBMInstructionScheduler::Policy::ASAP));
+	EXPECT_EQ(std::vector<int>({1, 0, 1}),
+			IBMInstructionScheduler::schedule(instructions,
+					IBMInstructionScheduler::Policy::ALAP));
+}
+
+TEST(IBMInstructionSchedulerTester,checkMeasurementOrder) {
+
+	// Measurements on different qubits keep their order,
+	// but may share a layer
+	std::vector<std::shared_ptr<Instruction>> instructions {
+			std::make_shared<X>(1), std::make_shared<Measure>(1, 0),
+			std::make_shared<Measure>(0, 1) };
+
+	EXPECT_EQ(std::vector<int>({0, 1, 1}),
+			IBMInstructionScheduler::schedule(instructions,
+					IBMInstructionScheduler::Policy::ASAP));
+
+	std::vector<std::shared_ptr<Instruction>> parallel {
+			std::make_shared<Measure>(0, 0), std::make_shared<Measure>(1, 1),
+			std::make_shared<Measure>(2, 2) };
+
+	EXPECT_EQ(std::vector<int>({0, 0, 0}),
+			IBMInstructionScheduler::schedule(parallel,
+					IBMInstructionScheduler::Policy::ASAP));
+}
+
+int main(int argc, char** argv) {
+   xacc::Initialize();
+   ::testing::InitGoogleTest(&argc, argv);
+   auto ret = RUN_ALL_TESTS();
+   xacc::Finalize();
+   return ret;
+}
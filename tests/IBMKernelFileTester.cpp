@@ -0,0 +1,150 @@
+/***********************************************************************************
+ * Copyright (c) 2016, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#include <gtest/gtest.h>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <cstring>
+#include "IBMKernelFile.hpp"
+#include "GateIR.hpp"
+#include "GateFunction.hpp"
+#include "CNOT.hpp"
+#include "Hadamard.hpp"
+#include "Measure.hpp"
+#include "Rz.hpp"
+#include "XACC.hpp"
+
+using namespace xacc;
+using namespace xacc::quantum;
+
+TEST(IBMKernelFileTester,checkSaveLoad) {
+
+	auto init = std::make_shared<GateFunction>("init");
+	init->addInstruction(std::make_shared<Hadamard>(1));
+	init->addInstruction(std::make_shared<CNOT>(1, 0));
+	init->addInstruction(std::make_shared<Rz>(0, 3.1415));
+
+	auto f = std::make_shared<GateFunction>("foo");
+	f->addInstruction(init);
+	f->addInstruction(std::make_shared<Measure>(0, 0));
+
+	auto g = std::make_shared<GateFunction>("bar");
+	g->addInstruction(init);
+	g->addInstruction(std::make_shared<Hadamard>(1));
+	g->addInstruction(std::make_shared<Measure>(1, 0));
+
+	auto src = std::string("__qpu__ foo(qbit qreg) {}");
+	auto hash = IBMKernelFile::hash(src);
+
+	auto path = (boost::filesystem::temp_directory_path()
+			/ boost::filesystem::unique_path()).string();
+	IBMKernelFile file(path);
+	file.save(hash, std::vector<std::shared_ptr<Function>> { f, g });
+
+	IBMKernelFile loaded(path);
+	EXPECT_FALSE(loaded.load(IBMKernelFile::hash(src + " ")));
+	EXPECT_TRUE(loaded.load(hash));
+
+	auto kernels = loaded.getKernels();
+	EXPECT_EQ(2, kernels.size());
+
+	// The shared state preparation is shared again
+	EXPECT_TRUE(kernels[0]->getInstruction(0) == kernels[1]->getInstruction(0));
+
+	EXPECT_EQ(std::vector<int> { 0 }, loaded.getMeasuredQubits(0));
+	EXPECT_EQ(std::vector<int> { 1 }, loaded.getMeasuredQubits(1));
+
+	auto ir = std::make_shared<GateIR>();
+	ir->addKernel(f);
+	ir->addKernel(g);
+	auto loadedIr = std::make_shared<GateIR>();
+	loadedIr->addKernel(kernels[0]);
+	loadedIr->addKernel(kernels[1]);
+
+	std::stringstream ss, ss2;
+	ir->persist(ss);
+	loadedIr->persist(ss2);
+	EXPECT_EQ(ss.str(), ss2.str());
+
+	boost::filesystem::remove(path);
+}
+
+TEST(IBMKernelFileTester,checkMalformedFiles) {
+
+	auto f = std::make_shared<GateFunction>("foo");
+	f->addInstruction(std::make_shared<Hadamard>(0));
+	f->addInstruction(std::make_shared<Measure>(0, 0));
+
+	auto hash = IBMKernelFile::hash("src");
+	auto path = (boost::filesystem::temp_directory_path()
+			/ boost::filesystem::unique_path()).string();
+	IBMKernelFile(path).save(hash, std::vector<std::shared_ptr<Function>> { f });
+
+	std::ifstream in(path, std::ios::binary);
+	std::string good((std::istreambuf_iterator<char>(in)),
+			std::istreambuf_iterator<char>());
+	in.close();
+
+	// Overwrite the 32 bit field at the given offset, past the 40 byte
+	// header and the 12 byte kernel record come 32 byte instruction records
+	auto loadsWith = [&](const std::size_t offset, const std::uint32_t value) {
+		auto bad = good;
+		std::memcpy(&bad[offset], &value, sizeof(value));
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out.write(bad.data(), bad.size());
+		out.close();
+		return IBMKernelFile(path).load(hash);
+	};
+
+	EXPECT_TRUE(loadsWith(40, 0));
+
+	// Kernel record index, first measured qubit
+	EXPECT_FALSE(loadsWith(40, 1000));
+	EXPECT_FALSE(loadsWith(44, 1000));
+
+	// Name offset, first parameter and number of children of the kernel
+	EXPECT_FALSE(loadsWith(52, 1000));
+	EXPECT_FALSE(loadsWith(52 + 16, 1000));
+	EXPECT_FALSE(loadsWith(52 + 24, 1000));
+
+	// Its name length, nBits and flags, turned into a
+	// reference to itself
+	EXPECT_FALSE(loadsWith(52 + 4, 3 | (8u << 24)));
+
+	boost::filesystem::remove(path);
+}
+
+int main(int argc, char** argv) {
+   xacc::Initialize();
+   ::testing::InitGoogleTest(&argc, argv);
+   auto ret = RUN_ALL_TESTS();
+   xacc::Finalize();
+   return ret;
+}
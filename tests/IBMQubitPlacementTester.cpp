@@ -0,0 +1,166 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#include <gtest/gtest.h>
+#include "IBMQubitPlacement.hpp"
+#include "GateIR.hpp"
+#include "X.hpp"
+#include "CNOT.hpp"
+#include "Measure.hpp"
+#include "XACC.hpp"
+
+using namespace xacc;
+using namespace xacc::quantum;
+
+TEST(IBMQubitPlacementTester,checkEmbeddablePath) {
+
+	// 0 - 1 - 2 - 3 - 4
+	std::vector<std::pair<int,int>> couplers {{0,1},{1,2},{2,3},{3,4}};
+	auto context = std::make_shared<IBMCompilationContext>();
+	IBMQubitPlacement placement(couplers, context);
+
+	// Interactions form the path 0 - 3 - 1 - 4 - 2
+	auto f = std::make_shared<GateFunction>("foo");
+	f->addInstruction(std::make_shared<X>(0));
+	f->addInstruction(std::make_shared<CNOT>(0, 3));
+	f->addInstruction(std::make_shared<CNOT>(3, 1));
+	f->addInstruction(std::make_shared<CNOT>(1, 4));
+	f->addInstruction(std::make_shared<CNOT>(4, 2));
+	f->addInstruction(std::make_shared<Measure>(2, 0));
+
+	auto ir = std::make_shared<GateIR>();
+	ir->addKernel(f);
+
+	auto placed = placement.transform(ir)->getKernels()[0];
+	EXPECT_EQ(6, placed->nInstructions());
+
+	// Every CNOT now acts on coupled qubits, no routing needed
+	for (auto inst : placed->getInstructions()) {
+		if (inst->bits().size() == 2) {
+			EXPECT_EQ(1, std::abs(inst->bits()[0] - inst->bits()[1]));
+		}
+	}
+
+	auto layout = context->getLayout(placed);
+	EXPECT_EQ(5, layout.size());
+	EXPECT_EQ(std::vector<int>({2}), context->getMeasuredQubits(placed));
+	EXPECT_EQ(layout[2], placed->getInstruction(5)->bits()[0]);
+}
+
+TEST(IBMQubitPlacementTester,checkAnnealedTriangle) {
+
+	// 0 - 1 - 2 - 3, a triangle cannot be embedded
+	std::vector<std::pair<int,int>> couplers {{0,1},{1,2},{2,3}};
+	auto context = std::make_shared<IBMCompilationContext>();
+	IBMQubitPlacement placement(couplers, context);
+
+	auto f = std::make_shared<GateFunction>("foo");
+	f->addInstruction(std::make_shared<CNOT>(0, 2));
+	f->addInstruction(std::make_shared<CNOT>(2, 3));
+	f->addInstruction(std::make_shared<CNOT>(3, 0));
+
+	auto ir = std::make_shared<GateIR>();
+	ir->addKernel(f);
+	auto placed = placement.transform(ir)->getKernels()[0];
+
+	// The layout is a permutation of the physical qubits
+	auto layout = context->getLayout(placed);
+	std::set<int> physical(layout.begin(), layout.end());
+	EXPECT_EQ(4, layout.size());
+	EXPECT_EQ(4, physical.size());
+
+	// The best layout puts the triangle on three consecutive qubits
+	std::vector<int> triangle {layout[0], layout[2], layout[3]};
+	std::sort(triangle.begin(), triangle.end());
+	EXPECT_EQ(2, triangle[2] - triangle[0]);
+}
+
+TEST(IBMQubitPlacementTester,checkKernelsSharingAName) {
+
+	// 0 - 1 - 2 - 3 - 4
+	std::vector<std::pair<int,int>> couplers {{0,1},{1,2},{2,3},{3,4}};
+	auto context = std::make_shared<IBMCompilationContext>();
+	IBMQubitPlacement placement(couplers, context);
+
+	auto f = std::make_shared<GateFunction>("foo");
+	f->addInstruction(std::make_shared<CNOT>(0, 3));
+	f->addInstruction(std::make_shared<Measure>(3, 0));
+
+	auto g = std::make_shared<GateFunction>("foo");
+	g->addInstruction(std::make_shared<X>(1));
+	g->addInstruction(std::make_shared<Measure>(0, 0));
+	g->addInstruction(std::make_shared<Measure>(1, 1));
+
+	// Each kernel keeps its own records, also across transformations
+	auto ir = std::make_shared<GateIR>();
+	ir->addKernel(f);
+	auto placedF = placement.transform(ir)->getKernels()[0];
+
+	ir = std::make_shared<GateIR>();
+	ir->addKernel(g);
+	auto placedG = placement.transform(ir)->getKernels()[0];
+
+	// g has no two qubit gate, so it is placed on the identity
+	// and kept as it is, without picking up the records of f
+	EXPECT_EQ(std::vector<int>({3}), context->getMeasuredQubits(placedF));
+	EXPECT_EQ(g, placedG);
+	EXPECT_TRUE(context->getMeasuredQubits(placedG).empty());
+	EXPECT_TRUE(context->getMeasuredQubits(f).empty());
+}
+
+TEST(IBMQubitPlacementTester,checkDirectedEmbedding) {
+
+	IBMBackendTopology topology(std::vector<std::pair<int,int>> {{1,0},{1,2},{3,2}});
+
+	auto embedding = IBMQubitPlacement::findEmbedding(std::set<int> {0, 1},
+			std::set<std::pair<int,int>> {{0,1}}, topology, true);
+	EXPECT_EQ(2, embedding.size());
+	EXPECT_TRUE(topology.isCoupled(embedding[0], embedding[1]));
+
+	// With 1 unavailable only 3 -> 2 is left
+	embedding = IBMQubitPlacement::findEmbedding(std::set<int> {0, 1},
+			std::set<std::pair<int,int>> {{0,1}}, topology, true,
+			std::set<int> {1});
+	EXPECT_EQ(3, embedding[0]);
+	EXPECT_EQ(2, embedding[1]);
+
+	// A star needs a degree three qubit
+	embedding = IBMQubitPlacement::findEmbedding(std::set<int> {0, 1, 2, 3},
+			std::set<std::pair<int,int>> {{0,1},{0,2},{0,3}}, topology, false);
+	EXPECT_TRUE(embedding.empty());
+}
+
+int main(int argc, char** argv) {
+   xacc::Initialize();
+   ::testing::InitGoogleTest(&argc, argv);
+   auto ret = RUN_ALL_TESTS();
+   xacc::Finalize();
+   return ret;
+}
@@ -0,0 +1,131 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#include <gtest/gtest.h>
+#include "IBMQubitRouter.hpp"
+#include "GateIR.hpp"
+#include "X.hpp"
+#include "CNOT.hpp"
+#include "Measure.hpp"
+#include "XACC.hpp"
+
+using namespace xacc;
+using namespace xacc::quantum;
+
+/**
+ * Run a kernel made of X, CNOT and Measure gates on a
+ * classical bit register, and return the measured bits
+ * in measurement order.
+ */
+std::vector<int> runClassically(std::shared_ptr<Function> kernel,
+		const int nQubits) {
+	std::vector<int> state(nQubits, 0), measured;
+	for (auto inst : kernel->getInstructions()) {
+		auto bits = inst->bits();
+		if (inst->name() == "X") {
+			state[bits[0]] ^= 1;
+		} else if (inst->name() == "CNOT") {
+			state[bits[1]] ^= state[bits[0]];
+		} else if (inst->name() == "Measure") {
+			measured.push_back(state[bits[0]]);
+		}
+	}
+	return measured;
+}
+
+TEST(IBMQubitRouterTester,checkLinearChain) {
+
+	// 0 - 1 - 2 - 3 - 4
+	std::vector<std::pair<int,int>> couplers {{0,1},{1,2},{2,3},{3,4}};
+	auto context = std::make_shared<IBMCompilationContext>();
+	IBMQubitRouter router(couplers, context);
+
+	auto f = std::make_shared<GateFunction>("foo");
+	f->addInstruction(std::make_shared<X>(0));
+	f->addInstruction(std::make_shared<CNOT>(0, 4));
+	f->addInstruction(std::make_shared<X>(2));
+	f->addInstruction(std::make_shared<CNOT>(2, 0));
+	f->addInstruction(std::make_shared<Measure>(0, 0));
+	f->addInstruction(std::make_shared<Measure>(2, 1));
+	f->addInstruction(std::make_shared<Measure>(4, 2));
+
+	auto ir = std::make_shared<GateIR>();
+	ir->addKernel(f);
+
+	auto routed = router.transform(ir)->getKernels()[0];
+
+	EXPECT_TRUE(router.getNumberOfSwaps() > 0);
+
+	// Every CNOT now acts on coupled qubits
+	for (auto inst : routed->getInstructions()) {
+		if (inst->bits().size() == 2) {
+			EXPECT_EQ(1, std::abs(inst->bits()[0] - inst->bits()[1]));
+		}
+	}
+
+	// Measurements still read the logical qubits 0, 2 and 4
+	EXPECT_EQ(std::vector<int>({0, 2, 4}), context->getMeasuredQubits(routed));
+	EXPECT_EQ(runClassically(f, 5), runClassically(routed, 5));
+	EXPECT_EQ(5, context->getLayout(routed).size());
+}
+
+TEST(IBMQubitRouterTester,checkCoupledKernel) {
+
+	std::vector<std::pair<int,int>> couplers {{0,1},{1,2}};
+	auto context = std::make_shared<IBMCompilationContext>();
+	IBMQubitRouter router(couplers, context);
+
+	// Every gate is already on a coupler, the
+	// kernel and its composites are kept as they are
+	auto prep = std::make_shared<GateFunction>("prep");
+	prep->addInstruction(std::make_shared<X>(0));
+	prep->addInstruction(std::make_shared<CNOT>(0, 1));
+
+	auto f = std::make_shared<GateFunction>("foo");
+	f->addInstruction(prep);
+	f->addInstruction(std::make_shared<CNOT>(1, 2));
+	f->addInstruction(std::make_shared<Measure>(2, 0));
+
+	auto ir = std::make_shared<GateIR>();
+	ir->addKernel(f);
+	auto routed = router.transform(ir)->getKernels()[0];
+
+	EXPECT_EQ(0, router.getNumberOfSwaps());
+	EXPECT_EQ(f, routed);
+	EXPECT_EQ(prep, routed->getInstruction(0));
+}
+
+int main(int argc, char** argv) {
+   xacc::Initialize();
+   ::testing::InitGoogleTest(&argc, argv);
+   auto ret = RUN_ALL_TESTS();
+   xacc::Finalize();
+   return ret;
+}
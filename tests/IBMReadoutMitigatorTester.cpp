@@ -0,0 +1,143 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#include <gtest/gtest.h>
+#include "IBMReadoutMitigator.hpp"
+
+using namespace xacc::quantum;
+
+namespace {
+
+boost::dynamic_bitset<> outcome(const std::string& bits) {
+	return boost::dynamic_bitset<>(bits);
+}
+
+}
+
+TEST(IBMReadoutMitigatorTester,checkMatchesTensorInverse) {
+	// Independent errors, p01 = 0.1, 0.2, 0.25 and p10 = 0.05 on every qubit
+	auto calibration = std::make_shared<IBMReadoutCalibration>(
+			std::set<int> { 0, 1, 2 });
+	double p01[] = { 0.1, 0.2, 0.25 };
+	for (int i = 0; i < 8; i++) {
+		double zeros = 1000.0, ones = 8000.0;
+		boost::dynamic_bitset<> flips(3, i);
+		for (int q = 0; q < 3; q++) {
+			zeros *= flips[q] ? p01[q] : 1.0 - p01[q];
+			ones *= flips[q] ? 0.05 : 0.95;
+		}
+		calibration->addShots(0, flips, std::lround(zeros));
+		calibration->addShots(1, ~flips, std::lround(ones));
+	}
+
+	std::map<std::string, int> counts { { "000", 310 }, { "001", 120 },
+			{ "010", 95 }, { "011", 80 }, { "100", 60 }, { "101", 140 },
+			{ "110", 75 }, { "111", 144 } };
+	std::vector<int> qubits { 0, 1, 2 };
+
+	IBMReadoutMitigator mitigator(calibration, 3);
+	auto dense = calibration->correct(counts, qubits);
+	auto quasi = mitigator.quasiProbabilities(counts, qubits);
+	for (int i = 0; i < 8; i++) {
+		auto bits = boost::dynamic_bitset<>(3, i);
+		std::string bitStr;
+		boost::to_string(bits, bitStr);
+		EXPECT_NEAR(dense[i], quasi[bitStr], 1e-8);
+	}
+	EXPECT_NEAR(calibration->expectationZ(counts, qubits),
+			mitigator.expectationZ(counts, qubits), 1e-8);
+	EXPECT_LT(mitigator.getResidual(), 1e-8);
+}
+
+TEST(IBMReadoutMitigatorTester,checkNearestNeighbors) {
+	// The same independent errors, but only outcomes within distance 2
+	// of each other are coupled, so the 8 outcomes are more than the
+	// 7 outcomes in each Hamming ball and rows are looked up by flips
+	auto calibration = std::make_shared<IBMReadoutCalibration>(
+			std::set<int> { 0, 1, 2 });
+	double p01[] = { 0.1, 0.2, 0.25 };
+	for (int i = 0; i < 8; i++) {
+		double zeros = 1000.0, ones = 8000.0;
+		boost::dynamic_bitset<> flips(3, i);
+		for (int q = 0; q < 3; q++) {
+			zeros *= flips[q] ? p01[q] : 1.0 - p01[q];
+			ones *= flips[q] ? 0.05 : 0.95;
+		}
+		calibration->addShots(0, flips, std::lround(zeros));
+		calibration->addShots(1, ~flips, std::lround(ones));
+	}
+
+	std::map<std::string, int> counts { { "000", 310 }, { "001", 120 },
+			{ "010", 95 }, { "011", 80 }, { "100", 60 }, { "101", 140 },
+			{ "110", 75 }, { "111", 144 } };
+	std::vector<int> qubits { 0, 1, 2 };
+
+	// Dropping the three qubit flips only moves the result slightly
+	IBMReadoutMitigator mitigator(calibration, 2);
+	auto dense = calibration->correct(counts, qubits);
+	auto quasi = mitigator.quasiProbabilities(counts, qubits);
+	double sum = 0.0;
+	for (int i = 0; i < 8; i++) {
+		auto bits = boost::dynamic_bitset<>(3, i);
+		std::string bitStr;
+		boost::to_string(bits, bitStr);
+		EXPECT_NEAR(dense[i], quasi[bitStr], 5e-3);
+		sum += quasi[bitStr];
+	}
+	EXPECT_NEAR(1.0, sum, 1e-8);
+	EXPECT_LT(mitigator.getResidual(), 1e-8);
+}
+
+TEST(IBMReadoutMitigatorTester,checkCorrelatedErrors) {
+	// Qubits 0 and 1 flip together in a tenth of the shots
+	auto calibration = std::make_shared<IBMReadoutCalibration>(
+			std::set<int> { 0, 1 });
+	calibration->addShots(0, outcome("00"), 900);
+	calibration->addShots(0, outcome("11"), 100);
+	calibration->addShots(1, outcome("11"), 1000);
+
+	// Half the shots prepare 00 and half 10
+	std::map<std::string, int> counts { { "00", 450 }, { "11", 100 },
+			{ "10", 450 } };
+	IBMReadoutMitigator mitigator(calibration);
+	auto quasi = mitigator.quasiProbabilities(counts, std::vector<int> { 0, 1 });
+	EXPECT_NEAR(0.5, quasi["00"], 1e-8);
+	EXPECT_NEAR(0.0, quasi["11"], 1e-8);
+	EXPECT_NEAR(0.5, quasi["10"], 1e-8);
+
+	// Only qubit 1 is measured
+	auto z1 = mitigator.expectationZ(counts, std::vector<int> { 1 });
+	EXPECT_NEAR(0.0, z1, 1e-8);
+}
+
+int main(int argc, char** argv) {
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -0,0 +1,101 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#include <gtest/gtest.h>
+#include "IBMResultCache.hpp"
+
+using namespace xacc;
+using namespace xacc::quantum;
+
+namespace {
+boost::filesystem::path makeCacheDirectory() {
+	return boost::filesystem::temp_directory_path()
+			/ boost::filesystem::unique_path("ibm-result-cache-%%%%-%%%%");
+}
+}
+
+TEST(IBMResultCacheTester,checkHitsAndMisses) {
+	auto dir = makeCacheDirectory();
+	IBMResultCache cache(dir.string());
+
+	std::string value;
+	EXPECT_FALSE(cache.get("qasm a", value));
+	cache.put("qasm a", "{\"0\":1024}");
+	EXPECT_TRUE(cache.get("qasm a", value));
+	EXPECT_EQ("{\"0\":1024}", value);
+	EXPECT_FALSE(cache.get("qasm b", value));
+
+	// Another process sharing the directory sees the entry
+	IBMResultCache other(dir.string());
+	EXPECT_TRUE(other.get("qasm a", value));
+
+	EXPECT_EQ(1, cache.getHits());
+	EXPECT_EQ(2, cache.getMisses());
+	EXPECT_NEAR(1.0 / 3.0, cache.getHitRate(), 1e-12);
+	EXPECT_EQ(16, IBMResultCache::hash("qasm a").size());
+	EXPECT_NE(IBMResultCache::hash("qasm a"), IBMResultCache::hash("qasm b"));
+
+	boost::filesystem::remove_all(dir);
+}
+
+TEST(IBMResultCacheTester,checkEviction) {
+	auto dir = makeCacheDirectory();
+
+	// Room for about two entries
+	IBMResultCache cache(dir.string(), 64);
+	std::string value(20, '1');
+	cache.put("a", value);
+	boost::filesystem::last_write_time(
+			dir / (IBMResultCache::hash("a") + ".result"), std::time(nullptr) - 100);
+	cache.put("b", value);
+	boost::filesystem::last_write_time(
+			dir / (IBMResultCache::hash("b") + ".result"), std::time(nullptr) - 50);
+	cache.put("c", value);
+
+	// The least recently used entry is gone
+	std::string cached;
+	EXPECT_FALSE(cache.get("a", cached));
+	EXPECT_TRUE(cache.get("b", cached));
+	EXPECT_TRUE(cache.get("c", cached));
+
+	// Entries older than the maximum age are misses
+	IBMResultCache aged(dir.string(), 1024, 10);
+	boost::filesystem::last_write_time(
+			dir / (IBMResultCache::hash("c") + ".result"), std::time(nullptr) - 60);
+	EXPECT_FALSE(aged.get("c", cached));
+	EXPECT_TRUE(aged.get("b", cached));
+
+	boost::filesystem::remove_all(dir);
+}
+
+int main(int argc, char** argv) {
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
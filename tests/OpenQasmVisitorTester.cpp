@@ -29,8 +29,10 @@
  *
  **********************************************************************************/
 #include <memory>
+#include <complex>
 #include <gtest/gtest.h>
 #include "OpenQasmVisitor.hpp"
+#include "OpenQasmCompactor.hpp"
 #include "InstructionIterator.hpp"
 
 using namespace xacc;
@@ -105,6 +107,229 @@ if (c1 == 1) x q[2];
 //	EXPECT_TRUE()
 }
 
+/**
+ * Return, for each qubit, the ordered list of statements
+ * acting on it. Broadcasts are expanded and measurement
+ * targets are resolved to their bit of the result string,
+ * cregs being laid out in declaration order, so two programs
+ * with equal sequences are equivalent. Entry -1 holds the
+ * total number of classical bits declared.
+ */
+std::map<int, std::vector<std::string>> perQubitStatements(
+		const std::string& qasm, const int nQubits) {
+	std::map<int, std::vector<std::string>> sequences;
+	std::map<std::string, int> cregOffsets;
+	int nClassicalBits = 0;
+	std::vector<std::string> lines;
+	boost::split(lines, qasm, boost::is_any_of("\n"));
+	for (auto l : lines) {
+		if (boost::starts_with(l, "creg ")) {
+			auto open = l.find('[');
+			cregOffsets[l.substr(5, open - 5)] = nClassicalBits;
+			nClassicalBits += std::stoi(l.substr(open + 1));
+			continue;
+		}
+		if (l.empty() || boost::starts_with(l, "include")
+				|| boost::starts_with(l, "qreg") || boost::starts_with(l, "id ")) {
+			continue;
+		}
+
+		// measure q[i] -> c[j]; or measure q -> c;
+		auto arrow = l.find(" -> ");
+		if (arrow != std::string::npos) {
+			auto target = l.substr(arrow + 4, l.size() - arrow - 5);
+			auto open = target.find('[');
+			auto offset = cregOffsets[target.substr(0, open)];
+			if (open == std::string::npos) {
+				for (int i = 0; i < nQubits; i++) {
+					sequences[i].push_back("measure q[" + std::to_string(i)
+							+ "] -> bit " + std::to_string(offset + i) + ";");
+				}
+			} else {
+				auto bit = offset + std::stoi(target.substr(open + 1));
+				auto qubit = std::stoi(l.substr(l.find("q[") + 2));
+				sequences[qubit].push_back("measure q[" + std::to_string(qubit)
+						+ "] -> bit " + std::to_string(bit) + ";");
+			}
+			continue;
+		}
+
+		if (boost::ends_with(l, " q;")) {
+			auto op = l.substr(0, l.size() - 3);
+			for (int i = 0; i < nQubits; i++) {
+				sequences[i].push_back(op + " q[" + std::to_string(i) + "];");
+			}
+			continue;
+		}
+
+		for (int i = 0; i < nQubits; i++) {
+			if (boost::contains(l, "q[" + std::to_string(i) + "]")) {
+				sequences[i].push_back(l);
+			}
+		}
+	}
+	sequences[-1].push_back(std::to_string(nClassicalBits) + " classical bits");
+	return sequences;
+}
+
+TEST(OpenQasmVisitorTester,checkCompactOpenQasm) {
+
+	auto f = std::make_shared<GateFunction>("foo");
+	for (int i = 0; i < 4; i++) {
+		f->addInstruction(std::make_shared<Hadamard>(i));
+	}
+	f->addInstruction(std::make_shared<Identity>(2));
+	f->addInstruction(std::make_shared<CNOT>(0, 1));
+	f->addInstruction(std::make_shared<X>(3));
+	for (int i = 0; i < 4; i++) {
+		f->addInstruction(std::make_shared<Measure>(i, i));
+	}
+
+	auto visitor = std::make_shared<OpenQasmVisitor>(4);
+	InstructionIterator it(f);
+	while (it.hasNext()) {
+		auto nextInst = it.next();
+		if (nextInst->isEnabled())
+			nextInst->accept(visitor);
+	}
+
+	auto qasm = visitor->getOpenQasmString();
+	OpenQasmCompactor compactor(4);
+	auto compacted = compactor.compact(qasm);
+
+	const std::string expected = R"expected(
+include \"qelib1.inc\";
+qreg q[4];
+creg c[4];
+h q;
+cx q[0], q[1];
+x q[3];
+measure q -> c;
+)expected";
+
+	EXPECT_EQ(expected, compacted);
+	EXPECT_TRUE(compacted.size() < qasm.size());
+	auto sequences = perQubitStatements(qasm, 4);
+	EXPECT_TRUE(sequences == perQubitStatements(compacted, 4));
+	EXPECT_EQ("measure q[2] -> bit 2;", sequences[2].back());
+	EXPECT_EQ(std::vector<std::string>({"4 classical bits"}), sequences[-1]);
+
+	// Measuring a qubit twice keeps both results
+	f->addInstruction(std::make_shared<X>(0));
+	f->addInstruction(std::make_shared<Measure>(0, 4));
+	auto twice = std::make_shared<OpenQasmVisitor>(4);
+	InstructionIterator it2(f);
+	while (it2.hasNext()) {
+		auto nextInst = it2.next();
+		if (nextInst->isEnabled())
+			nextInst->accept(twice);
+	}
+	auto twiceQasm = twice->getOpenQasmString();
+	EXPECT_EQ(twiceQasm, compactor.compact(twiceQasm));
+}
+
+typedef std::vector<std::complex<double>> Matrix2;
+
+/**
+ * Return the product a * b of two row-major 2x2 matrices.
+ */
+Matrix2 multiply(const Matrix2& a, const Matrix2& b) {
+	return Matrix2 { a[0] * b[0] + a[1] * b[2], a[0] * b[1] + a[1] * b[3],
+			a[2] * b[0] + a[3] * b[2], a[2] * b[1] + a[3] * b[3] };
+}
+
+/**
+ * Return the unitary of an OpenQasm u3, u2 or u1
+ * statement, ie 'u3(theta, phi, lambda) q[0];'.
+ */
+Matrix2 unitaryOf(const std::string& statement) {
+	auto open = statement.find("(");
+	std::vector<std::string> args;
+	boost::split(args,
+			statement.substr(open + 1, statement.find(")") - open - 1),
+			boost::is_any_of(","));
+	std::vector<double> angles;
+	for (auto& a : args) {
+		angles.push_back(std::stod(a));
+	}
+	double theta = 0.0, phi = 0.0, lambda = angles.back();
+	if (angles.size() == 3) {
+		theta = angles[0];
+		phi = angles[1];
+	} else if (angles.size() == 2) {
+		theta = std::acos(-1.0) / 2.0;
+		phi = angles[0];
+	}
+	std::complex<double> i(0.0, 1.0);
+	return Matrix2 { std::cos(theta / 2.0),
+			-std::exp(i * lambda) * std::sin(theta / 2.0),
+			std::exp(i * phi) * std::sin(theta / 2.0),
+			std::exp(i * (phi + lambda)) * std::cos(theta / 2.0) };
+}
+
+TEST(OpenQasmVisitorTester,checkGateFusion) {
+
+	auto f = std::make_shared<GateFunction>("foo");
+
+	// Rx Ry Rx on qubit 0 fuses into one u3
+	f->addInstruction(std::make_shared<Rx>(0, 0.3));
+	f->addInstruction(std::make_shared<Ry>(0, 0.2));
+	f->addInstruction(std::make_shared<Rx>(0, -0.1));
+
+	// H H on qubit 1 is the identity
+	f->addInstruction(std::make_shared<Hadamard>(1));
+	f->addInstruction(std::make_shared<Hadamard>(1));
+	f->addInstruction(std::make_shared<CNOT>(0, 1));
+
+	// Rz Rz on qubit 2 fuses into one u1
+	f->addInstruction(std::make_shared<Rz>(2, 0.4));
+	f->addInstruction(std::make_shared<Rz>(2, 0.1));
+
+	// Variable rotations are not fused, a lone gate is kept as is
+	auto rz = std::make_shared<Rz>(3, 0.0);
+	InstructionParameter theta(std::string("theta"));
+	rz->setParameter(0, theta);
+	f->addInstruction(rz);
+	f->addInstruction(std::make_shared<Hadamard>(3));
+
+	auto visitor = std::make_shared<OpenQasmVisitor>(4);
+	visitor->enableGateFusion();
+	InstructionIterator it(f);
+	while (it.hasNext()) {
+		auto nextInst = it.next();
+		if (nextInst->isEnabled())
+			nextInst->accept(visitor);
+	}
+
+	auto sequences = perQubitStatements(visitor->getOpenQasmString(), 4);
+
+	EXPECT_EQ(2, sequences[0].size());
+	EXPECT_TRUE(boost::starts_with(sequences[0][0], "u3("));
+	EXPECT_EQ("cx q[0], q[1];", sequences[0][1]);
+
+	// The u3 is Rx(-0.1) Ry(0.2) Rx(0.3) up to a global phase
+	auto rxMatrix = [](const double t) {
+		std::complex<double> i(0.0, 1.0);
+		return Matrix2 { std::cos(t / 2.0), -i * std::sin(t / 2.0),
+				-i * std::sin(t / 2.0), std::cos(t / 2.0) };
+	};
+	Matrix2 ryMatrix { std::cos(0.1), -std::sin(0.1), std::sin(0.1), std::cos(0.1) };
+	auto expected = multiply(rxMatrix(-0.1), multiply(ryMatrix, rxMatrix(0.3)));
+	auto fused = unitaryOf(sequences[0][0]);
+	auto overlap = std::conj(expected[0]) * fused[0]
+			+ std::conj(expected[1]) * fused[1]
+			+ std::conj(expected[2]) * fused[2]
+			+ std::conj(expected[3]) * fused[3];
+	EXPECT_NEAR(2.0, std::abs(overlap), 1e-6);
+
+	EXPECT_EQ(std::vector<std::string>({"cx q[0], q[1];"}), sequences[1]);
+
+	EXPECT_EQ(1, sequences[2].size());
+	EXPECT_TRUE(boost::starts_with(sequences[2][0], "u1("));
+	EXPECT_NEAR(0.5, std::stod(sequences[2][0].substr(3)), 1e-12);
+
+	EXPECT_EQ(std::vector<std::string>({"u1(theta) q[3];", "h q[3];"}), sequences[3]);
+}
 
 int main(int argc, char** argv) {
    ::testing::InitGoogleTest(&argc, argv);
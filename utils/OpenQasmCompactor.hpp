@@ -0,0 +1,184 @@
+/***********************************************************************************
+ * Copyright (c) 2017, UT-Battelle
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the xacc nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Contributors:
+ *   Initial API and implementation - Alex McCaskey
+ *
+ **********************************************************************************/
+#ifndef QUANTUM_GATE_ACCELERATORS_OPENQASMCOMPACTOR_HPP_
+#define QUANTUM_GATE_ACCELERATORS_OPENQASMCOMPACTOR_HPP_
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <boost/algorithm/string.hpp>
+
+namespace xacc {
+namespace quantum {
+
+/**
+ * The OpenQasmCompactor rewrites the OpenQasm produced by the
+ * OpenQasmVisitor into a smaller, equivalent program. It
+ *
+ *   - drops id gates,
+ *   - merges the per-measurement creg declarations into a single
+ *     creg c[nQubits], where qubit i is always measured into c[i],
+ *   - collapses a layer of identical single qubit statements that
+ *     covers every qubit into a register broadcast, ie h q; or
+ *     measure q -> c;
+ *
+ * Conditional statements compare whole classical registers, and
+ * a qubit measured twice would overwrite its first result in c,
+ * so programs containing either are returned unchanged.
+ */
+class OpenQasmCompactor {
+
+protected:
+
+	int _nQubits;
+
+	/**
+	 * Split a single qubit statement, like 'h q[2];' or
+	 * 'measure q[2] -> c[2];', into its operation and qubit.
+	 * Returns false for any other statement.
+	 */
+	bool splitSingleQubitStatement(const std::string& line, std::string& op,
+			int& qubit) {
+		auto first = line.find("q[");
+		if (first == std::string::npos || first == 0
+				|| line.find("q[", first + 1) != std::string::npos) {
+			return false;
+		}
+		auto close = line.find("]", first);
+		if (close == std::string::npos) {
+			return false;
+		}
+		auto rest = line.substr(close + 1);
+		if (rest != ";" && !boost::starts_with(rest, " -> ")) {
+			return false;
+		}
+		op = line.substr(0, first - 1);
+		qubit = std::stoi(line.substr(first + 2, close - first - 2));
+		return true;
+	}
+
+	/**
+	 * Write out a run of single qubit statements sharing
+	 * the same operation, as a broadcast if it covers
+	 * every qubit.
+	 */
+	void flush(const std::string& op, std::vector<int>& run,
+			std::string& result) {
+		if (run.size() == _nQubits && _nQubits > 1) {
+			result += op == "measure" ? "measure q -> c;\n" : op + " q;\n";
+		} else {
+			for (auto q : run) {
+				auto qStr = std::to_string(q);
+				result += op + " q[" + qStr + "]"
+						+ (op == "measure" ? " -> c[" + qStr + "]" : "")
+						+ ";\n";
+			}
+		}
+		run.clear();
+	}
+
+public:
+
+	OpenQasmCompactor(const int nQubits) : _nQubits(nQubits) {
+	}
+
+	/**
+	 * Return the compacted form of the given OpenQasm program.
+	 */
+	std::string compact(const std::string& qasm) {
+		std::vector<std::string> lines;
+		boost::split(lines, qasm, boost::is_any_of("\n"));
+
+		std::vector<int> measured;
+		for (auto& l : lines) {
+			if (boost::starts_with(l, "if (")) {
+				return qasm;
+			}
+			std::string op;
+			int qubit;
+			if (splitSingleQubitStatement(l, op, qubit) && op == "measure") {
+				if (std::find(measured.begin(), measured.end(), qubit)
+						!= measured.end()) {
+					return qasm;
+				}
+				measured.push_back(qubit);
+			}
+		}
+
+		bool hasMeasurements = boost::contains(qasm, "measure ");
+
+		std::string result, runOp;
+		std::vector<int> run;
+		for (int i = 0; i < lines.size(); i++) {
+			auto& l = lines[i];
+			if (i == lines.size() - 1 && l.empty()) {
+				break;
+			}
+
+			std::string op;
+			int qubit;
+			if (boost::starts_with(l, "creg ")) {
+				continue;
+			} else if (boost::starts_with(l, "qreg ")) {
+				flush(runOp, run, result);
+				result += l + "\n";
+				if (hasMeasurements) {
+					result += "creg c[" + std::to_string(_nQubits) + "];\n";
+				}
+				continue;
+			} else if (!splitSingleQubitStatement(l, op, qubit)) {
+				flush(runOp, run, result);
+				result += l + "\n";
+				continue;
+			} else if (op == "id") {
+				continue;
+			}
+
+			if (op != runOp
+					|| std::find(run.begin(), run.end(), qubit) != run.end()) {
+				flush(runOp, run, result);
+			}
+			runOp = op;
+			run.push_back(qubit);
+			if (run.size() == _nQubits) {
+				flush(runOp, run, result);
+			}
+		}
+		flush(runOp, run, result);
+
+		return result;
+	}
+};
+
+}
+}
+
+#endif
@@ -32,6 +32,9 @@
 #define QUANTUM_GATE_ACCELERATORS_RIGETTI_OpenQasmVISITOR_HPP_
 
 #include <memory>
+#include <array>
+#include <cmath>
+#include <complex>
 #include "AllGateVisitor.hpp"
 #include <boost/math/constants/constants.hpp>
 
@@ -68,6 +71,149 @@ protected:
 	int numAddresses = 0;
 
 	int _nQubits;
+
+	/**
+	 * Optional map from IR qubit index to the
+	 * index written in the OpenQasm qreg.
+	 */
+	std::vector<int> _qubitMap;
+
+	/**
+	 * Return the OpenQasm qreg index for the given IR qubit.
+	 */
+	int qubit(const int idx) {
+		return _qubitMap.empty() ? idx : _qubitMap[idx];
+	}
+
+	/**
+	 * Row-major 2x2 unitary of a single qubit gate
+	 */
+	using SU2 = std::array<std::complex<double>, 4>;
+
+	/**
+	 * A run of single qubit gates waiting to be fused, with
+	 * the OpenQasm of its first gate in case it is alone.
+	 */
+	struct PendingRun {
+		SU2 unitary;
+		std::string firstQasm;
+		int nGates;
+	};
+
+	bool fuseGates = false;
+
+	double fusionTolerance = 0.0;
+
+	std::map<int, PendingRun> pendingRuns;
+
+	static SU2 multiply(const SU2& a, const SU2& b) {
+		return SU2 { a[0] * b[0] + a[1] * b[2], a[0] * b[1] + a[1] * b[3],
+				a[2] * b[0] + a[3] * b[2], a[2] * b[1] + a[3] * b[3] };
+	}
+
+	static SU2 rotation(const char axis, const double angle) {
+		std::complex<double> c(std::cos(angle / 2.0), 0.0), i(0.0, 1.0);
+		auto s = std::sin(angle / 2.0);
+		if (axis == 'x') {
+			return SU2 { c, -i * s, -i * s, c };
+		} else if (axis == 'y') {
+			return SU2 { c, -s, s, c };
+		}
+		return SU2 { std::exp(-i * angle / 2.0), 0.0, 0.0, std::exp(i * angle / 2.0) };
+	}
+
+	/**
+	 * Emit the given single qubit gate, or fold it into the
+	 * pending run on its qubit if gate fusion is enabled.
+	 */
+	void singleQubitGate(const int idx, const std::string& qasm,
+			const SU2& unitary) {
+		if (!fuseGates) {
+			OpenQasmStr += qasm;
+			return;
+		}
+		auto run = pendingRuns.find(idx);
+		if (run == pendingRuns.end()) {
+			pendingRuns.insert(std::make_pair(idx, PendingRun { unitary, qasm, 1 }));
+		} else {
+			run->second.unitary = multiply(unitary, run->second.unitary);
+			run->second.nGates++;
+		}
+	}
+
+	static double wrapAngle(double angle) {
+		angle = std::remainder(angle, 2.0 * pi);
+		return angle <= -pi ? angle + 2.0 * pi : angle;
+	}
+
+	/**
+	 * Emit the pending run on the given qubit as the cheapest
+	 * of nothing, u1, u2 or u3, using U = Rz(phi) Ry(theta) Rz(lambda)
+	 * up to a global phase.
+	 */
+	void flush(const int idx) {
+		auto run = pendingRuns.find(idx);
+		if (run == pendingRuns.end()) {
+			return;
+		}
+		auto u = run->second.unitary;
+		auto nGates = run->second.nGates;
+		auto firstQasm = run->second.firstQasm;
+		pendingRuns.erase(run);
+
+		if (nGates == 1) {
+			OpenQasmStr += firstQasm;
+			return;
+		}
+
+		auto cosine = std::abs(u[0]), sine = std::abs(u[2]);
+		auto theta = 2.0 * std::atan2(sine, cosine);
+		double phi = 0.0, lambda = 0.0;
+		if (sine < 1e-12) {
+			lambda = std::arg(u[3]) - std::arg(u[0]);
+		} else if (cosine < 1e-12) {
+			phi = std::arg(u[2]) - std::arg(-u[1]);
+		} else {
+			phi = std::arg(u[2]) - std::arg(u[0]);
+			lambda = std::arg(-u[1]) - std::arg(u[0]);
+		}
+
+		auto q = std::to_string(qubit(idx));
+		auto str = [](double angle) {
+			return boost::lexical_cast<std::string>(angle);
+		};
+		if (std::fabs(theta) <= fusionTolerance) {
+			auto total = wrapAngle(phi + lambda);
+			if (std::fabs(total) > fusionTolerance) {
+				OpenQasmStr += "u1(" + str(total) + ") q[" + q + "];\n";
+			}
+		} else if (std::fabs(theta - pi / 2.0) <= fusionTolerance) {
+			OpenQasmStr += "u2(" + str(wrapAngle(phi)) + ", " + str(wrapAngle(lambda))
+					+ ") q[" + q + "];\n";
+		} else {
+			OpenQasmStr += "u3(" + str(theta) + ", " + str(wrapAngle(phi)) + ", "
+					+ str(wrapAngle(lambda)) + ") q[" + q + "];\n";
+		}
+	}
+
+	void flushAll() {
+		while (!pendingRuns.empty()) {
+			flush(pendingRuns.begin()->first);
+		}
+	}
+
+	/**
+	 * Return true if the given rotation has a numeric angle
+	 * that can be fused, and not a variable name.
+	 */
+	static bool isFusable(Instruction& rotation) {
+		return rotation.getParameter(0).which() <= 2;
+	}
+
+	static double angle(Instruction& rotation) {
+		return boost::lexical_cast<double>(rotation.getParameter(0));
+	}
+
 public:
 
 	virtual const std::string name() const {
@@ -81,7 +227,9 @@ public:
 	OpenQasmVisitor() : OpenQasmVisitor(16) {
 	}
 
-	OpenQasmVisitor(const int nQubits, bool skipPreamble = false) : _nQubits(nQubits) {
+	OpenQasmVisitor(const int nQubits, bool skipPreamble = false,
+			std::vector<int> qubitMap = std::vector<int> { }) :
+			_nQubits(nQubits), _qubitMap(qubitMap) {
 		// Create a qubit registry
 		if (!skipPreamble) {
 			OpenQasmStr += "\ninclude \\\"qelib1.inc\\\";\nqreg q[" + std::to_string(nQubits) + "];\n";
@@ -97,12 +245,15 @@ public:
 	 */
 	void visit(Hadamard& h) {
 		std::stringstream ss;
-		ss << "h q[" << h.bits()[0] << "];\n";
-		OpenQasmStr += ss.str();
+		ss << "h q[" << qubit(h.bits()[0]) << "];\n";
+		auto r = 1.0 / std::sqrt(2.0);
+		singleQubitGate(h.bits()[0], ss.str(), SU2 { r, r, r, -r });
 	}
 
 	void visit(Identity& i) {
-		OpenQasmStr += "id q[" + std::to_string(i.bits()[0]) + "];\n";
+		singleQubitGate(i.bits()[0],
+				"id q[" + std::to_string(qubit(i.bits()[0])) + "];\n",
+				SU2 { 1.0, 0.0, 0.0, 1.0 });
 	}
 
 	void visit(CZ& cz) {
@@ -114,7 +265,9 @@ public:
 	 */
 	void visit(CNOT& cn) {
 		std::stringstream ss;
-		ss << "cx q[" << cn.bits()[0] << "], q[" << cn.bits()[1] << "];\n";
+		flush(cn.bits()[0]);
+		flush(cn.bits()[1]);
+		ss << "cx q[" << qubit(cn.bits()[0]) << "], q[" << qubit(cn.bits()[1]) << "];\n";
 		OpenQasmStr += ss.str();
 	}
 	/**
@@ -122,8 +275,8 @@ public:
 	 */
 	void visit(X& x) {
 		std::stringstream ss;
-		ss << "x q[" << x.bits()[0] << "];\n";
-		OpenQasmStr += ss.str();
+		ss << "x q[" << qubit(x.bits()[0]) << "];\n";
+		singleQubitGate(x.bits()[0], ss.str(), SU2 { 0.0, 1.0, 1.0, 0.0 });
 	}
 
 	/**
@@ -131,8 +284,9 @@ public:
 	 */
 	void visit(Y& y) {
 		std::stringstream ss;
-		ss << "y q[" << y.bits()[0] << "];\n";
-		OpenQasmStr += ss.str();
+		ss << "y q[" << qubit(y.bits()[0]) << "];\n";
+		std::complex<double> i(0.0, 1.0);
+		singleQubitGate(y.bits()[0], ss.str(), SU2 { 0.0, -i, i, 0.0 });
 	}
 
 	/**
@@ -140,8 +294,8 @@ public:
 	 */
 	void visit(Z& z) {
 		std::stringstream ss;
-		ss << "z q[" << z.bits()[0] << "];\n";
-		OpenQasmStr += ss.str();
+		ss << "z q[" << qubit(z.bits()[0]) << "];\n";
+		singleQubitGate(z.bits()[0], ss.str(), SU2 { 1.0, 0.0, 0.0, -1.0 });
 	}
 
 	int classicalBitCounter = 0;
@@ -150,8 +304,9 @@ public:
 	 */
 	void visit(Measure& m) {
 		std::stringstream ss;
+		flush(m.bits()[0]);
 		ss << "creg c" << classicalBitCounter << "[1];\n";
-		ss << "measure q[" << m.bits()[0] << "] -> c" << classicalBitCounter << "[0];\n";
+		ss << "measure q[" << qubit(m.bits()[0]) << "] -> c" << classicalBitCounter << "[0];\n";
 		OpenQasmStr += ss.str();
 		qubitToClassicalBitIndex.insert(std::make_pair(m.bits()[0], classicalBitCounter));
 		classicalBitCounter++;
@@ -162,7 +317,8 @@ public:
 	 */
 	void visit(ConditionalFunction& c) {
 		std::stringstream ss;
-		auto visitor = std::make_shared<OpenQasmVisitor>(_nQubits, true);
+		flushAll();
+		auto visitor = std::make_shared<OpenQasmVisitor>(_nQubits, true, _qubitMap);
 		auto classicalBitIdx = qubitToClassicalBitIndex[c.getConditionalQubit()];
 
 		ss << "if (c" << classicalBitIdx << " == 1) ";
@@ -181,22 +337,37 @@ public:
 	void visit(Rx& rx) {
 		std::stringstream ss;
 		auto angleStr = boost::lexical_cast<std::string>(rx.getParameter(0));
-		ss << "u3(" << angleStr << ", " << (-pi/2.0) << ", " << (pi/2.0) << ") q[" << rx.bits()[0] << "];\n";
-		OpenQasmStr += ss.str();
+		ss << "u3(" << angleStr << ", " << (-pi/2.0) << ", " << (pi/2.0) << ") q[" << qubit(rx.bits()[0]) << "];\n";
+		if (isFusable(rx)) {
+			singleQubitGate(rx.bits()[0], ss.str(), rotation('x', angle(rx)));
+		} else {
+			flush(rx.bits()[0]);
+			OpenQasmStr += ss.str();
+		}
 	}
 
 	void visit(Ry& ry) {
 		std::stringstream ss;
 		auto angleStr = boost::lexical_cast<std::string>(ry.getParameter(0));
-		ss << "u3(" << angleStr << ", 0, 0) q[" << ry.bits()[0] << "];\n";
-		OpenQasmStr += ss.str();
+		ss << "u3(" << angleStr << ", 0, 0) q[" << qubit(ry.bits()[0]) << "];\n";
+		if (isFusable(ry)) {
+			singleQubitGate(ry.bits()[0], ss.str(), rotation('y', angle(ry)));
+		} else {
+			flush(ry.bits()[0]);
+			OpenQasmStr += ss.str();
+		}
 	}
 
 	void visit(Rz& rz) {
 		std::stringstream ss;
 		auto angleStr = boost::lexical_cast<std::string>(rz.getParameter(0));
-		ss << "u1(" << angleStr << ") q[" << rz.bits()[0] << "];\n";
-		OpenQasmStr += ss.str();
+		ss << "u1(" << angleStr << ") q[" << qubit(rz.bits()[0]) << "];\n";
+		if (isFusable(rz)) {
+			singleQubitGate(rz.bits()[0], ss.str(), rotation('z', angle(rz)));
+		} else {
+			flush(rz.bits()[0]);
+			OpenQasmStr += ss.str();
+		}
 	}
 
 	void visit(CPhase& cp) {
@@ -213,9 +384,30 @@ public:
 	 * Return the OpenQasm string
 	 */
 	std::string getOpenQasmString() {
+		flushAll();
 		return OpenQasmStr;
 	}
 
+	/**
+	 * Append an OpenQasm snippet that was lowered
+	 * by another visitor (created with skipPreamble)
+	 * to the string this visitor is constructing.
+	 */
+	void appendOpenQasm(const std::string& snippet) {
+		flushAll();
+		OpenQasmStr += snippet;
+	}
+
+	/**
+	 * Fuse each run of single qubit gates into one u1, u2 or u3,
+	 * or nothing. Rotations within the given tolerance of
+	 * u1 or u2, or of the identity, are emitted as such.
+	 */
+	void enableGateFusion(const double tolerance = 1e-10) {
+		fuseGates = true;
+		fusionTolerance = tolerance;
+	}
+
 	/**
 	 * Return the classical measurement indices
 	 * as a json int array represented as a string.